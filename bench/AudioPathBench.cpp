@@ -0,0 +1,253 @@
+// The capture hot paths between the ASIO driver buffers and the host's output buffers, in ns per
+// sample, for every instruction set this machine runs:
+//  - every AsioConverters format
+//  - the callback's capture step: a driver buffer converted straight into a ring plane, in two pieces
+//    when it straddles the end of the ring, plain and through the fused input chain (gain, DC blocker
+//    and metering in the same pass)
+//  - RingBufferFloat::read, and the planar read behind AsioInterface::getAudioDataStereo
+//    (PlanarReadPath) for a stereo pair and for a mono input on both sides, and the stereo pair into
+//    double-precision host buffers
+// Block sizes run from 16 to 4096 frames. "wrapped" rows start half a block before the end of the ring;
+// "mirrored" rows use the double-mapped ring, where that block is contiguous.
+
+#include "Processor/Asio/AsioConverters.h"
+#include "Processor/Asio/CpuFeatures.h"
+#include "Processor/Asio/DspKernels.h"
+#include "Processor/Asio/PlanarReadPath.h"
+#include "Processor/Asio/RingBufferFloat.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace Newkon;
+
+namespace
+{
+  constexpr uint32_t kBlocks[] = {16, 64, 256, 1024, 4096};
+  constexpr int kBlockCount = sizeof(kBlocks) / sizeof(kBlocks[0]);
+  constexpr uint32_t kRingFrames = 16384; // several times the largest block, as in the plugin
+  constexpr double kSamplesPerPass = 4e6;
+  constexpr int kPasses = 5;
+
+  volatile float g_sink = 0.0f; // keeps results observable
+
+  const char *const kFormatNames[] = {
+      "Float32LSB", "Float64LSB", "Int16LSB", "Int24LSB", "Int32LSB", "Int32LSB16", "Int32LSB18", "Int32LSB20", "Int32LSB24",
+      "Float32MSB", "Float64MSB", "Int16MSB", "Int24MSB", "Int32MSB", "Int32MSB16", "Int32MSB18", "Int32MSB20", "Int32MSB24"};
+  static_assert(sizeof(kFormatNames) / sizeof(kFormatNames[0]) == static_cast<size_t>(AsioConverters::SampleFormat::kCount),
+                "one name per SampleFormat");
+
+  // Best of several passes of `run`, each processing `samples` samples per call
+  template <typename Run>
+  double nsPerSample(Run &&run, uint32_t samples)
+  {
+    const int calls = static_cast<int>(kSamplesPerPass / samples) + 1;
+    for (int c = 0; c < calls / 10 + 1; c++)
+      run();
+    double best = 1e30;
+    for (int p = 0; p < kPasses; p++)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      for (int c = 0; c < calls; c++)
+        run();
+      const double took = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      const double ns = took * 1e9 / (static_cast<double>(calls) * samples);
+      if (ns < best)
+        best = ns;
+    }
+    return best;
+  }
+
+  void printHeader(const char *title)
+  {
+    std::printf("\n%-40s", title);
+    for (uint32_t block : kBlocks)
+      std::printf(" %7u", block);
+    std::printf("   (ns/sample by block size)\n");
+  }
+
+  void printRow(const char *label, const char *isa, const double *values)
+  {
+    char name[64];
+    std::snprintf(name, sizeof(name), "%s %s", label, isa);
+    std::printf("  %-38s", name);
+    for (int b = 0; b < kBlockCount; b++)
+      std::printf(" %7.3f", values[b]);
+    std::printf("\n");
+  }
+
+  std::vector<uint8_t> driverBuffer(AsioConverters::SampleFormat format, uint32_t frames)
+  {
+    std::vector<uint8_t> bytes(static_cast<size_t>(frames) * AsioConverters::bytesPerSample(format));
+    for (uint8_t &b : bytes)
+      b = static_cast<uint8_t>(std::rand());
+    // Random float bit patterns include NaNs and denormals, which some CPUs convert slowly: use real samples
+    if (format == AsioConverters::SampleFormat::kFloat32LSB || format == AsioConverters::SampleFormat::kFloat64LSB)
+      for (uint32_t i = 0; i < frames; i++)
+      {
+        const double v = std::rand() / static_cast<double>(RAND_MAX) - 0.5;
+        if (format == AsioConverters::SampleFormat::kFloat32LSB)
+          reinterpret_cast<float *>(bytes.data())[i] = static_cast<float>(v);
+        else
+          reinterpret_cast<double *>(bytes.data())[i] = v;
+      }
+    return bytes;
+  }
+
+  void benchConverters(int widest)
+  {
+    printHeader("AsioConverters");
+    const uint32_t maxBlock = kBlocks[kBlockCount - 1];
+    std::vector<float> out(maxBlock);
+    for (int f = 0; f < static_cast<int>(AsioConverters::SampleFormat::kCount); f++)
+    {
+      const auto format = static_cast<AsioConverters::SampleFormat>(f);
+      const std::vector<uint8_t> in = driverBuffer(format, maxBlock);
+      for (int isa = 0; isa <= widest; isa++)
+      {
+        const AsioConverters::BlockConverter convert = AsioConverters::select(format, static_cast<CpuFeatures::Isa>(isa));
+        double values[kBlockCount];
+        for (int b = 0; b < kBlockCount; b++)
+          values[b] = nsPerSample([&]
+                                  { convert(in.data(), out.data(), kBlocks[b]); g_sink = out[0]; },
+                                  kBlocks[b]);
+        printRow(kFormatNames[f], CpuFeatures::isaName(static_cast<CpuFeatures::Isa>(isa)), values);
+      }
+    }
+  }
+
+  void benchCapture(int widest)
+  {
+    // As the ASIO callback: convert the driver buffer into the plane at the write head, in two calls
+    // when the block wraps (one in the mirrored ring)
+    printHeader("Callback capture into the ring");
+    const AsioConverters::SampleFormat formats[] = {AsioConverters::SampleFormat::kInt32LSB, AsioConverters::SampleFormat::kInt24LSB,
+                                                    AsioConverters::SampleFormat::kFloat32LSB};
+    RingBufferFloat plainRing(kRingFrames);
+    RingBufferFloat mirroredRing(kRingFrames, 1, RingBufferFloat::Layout::kMirrored);
+    for (AsioConverters::SampleFormat format : formats)
+    {
+      const std::vector<uint8_t> in = driverBuffer(format, kBlocks[kBlockCount - 1]);
+      const int bytes = AsioConverters::bytesPerSample(format);
+      for (int isa = 0; isa <= widest; isa++)
+      {
+        const AsioConverters::BlockConverter convert = AsioConverters::select(format, static_cast<CpuFeatures::Isa>(isa));
+        // contiguous, wrapped, wrapped in the mirrored ring
+        for (int variant = 0; variant < 3; variant++)
+        {
+          if (variant == 2 && !mirroredRing.mirrored())
+            continue;
+          RingBufferFloat &ring = variant == 2 ? mirroredRing : plainRing;
+          const bool wrapped = variant > 0;
+          double values[kBlockCount];
+          for (int b = 0; b < kBlockCount; b++)
+          {
+            const uint32_t block = kBlocks[b];
+            const uint32_t wpos = wrapped ? ring.capacity() - block / 2 : 0;
+            const uint32_t first = ring.contiguous(wpos) < block ? ring.contiguous(wpos) : block;
+            float *plane = ring.data();
+            values[b] = nsPerSample([&]
+                                    {
+                                      convert(in.data(), plane + wpos, first);
+                                      if (first < block)
+                                        convert(in.data() + static_cast<size_t>(first) * bytes, plane, block - first);
+                                      g_sink = plane[wpos]; },
+                                    block);
+          }
+          char label[48];
+          const char *const variants[] = {"contiguous", "wrapped", "wrapped mirrored"};
+          std::snprintf(label, sizeof(label), "%s %s", kFormatNames[static_cast<int>(format)], variants[variant]);
+          printRow(label, CpuFeatures::isaName(static_cast<CpuFeatures::Isa>(isa)), values);
+        }
+
+        const AsioConverters::ChainConverter chain = AsioConverters::selectChain(format, static_cast<CpuFeatures::Isa>(isa));
+        AsioConverters::InputChain state;
+        state.gain = 0.5f;
+        state.dcBlock = true;
+        double values[kBlockCount];
+        for (int b = 0; b < kBlockCount; b++)
+          values[b] = nsPerSample([&]
+                                  { state.peak = 0.0f; state.sumSquares = 0.0; chain(in.data(), plainRing.data(), kBlocks[b], state); g_sink = state.peak; },
+                                  kBlocks[b]);
+        char label[48];
+        std::snprintf(label, sizeof(label), "%s fused chain", kFormatNames[static_cast<int>(format)]);
+        printRow(label, CpuFeatures::isaName(static_cast<CpuFeatures::Isa>(isa)), values);
+      }
+    }
+  }
+
+  void benchReads(int widest, RingBufferFloat::Layout layout)
+  {
+    RingBufferFloat ring(kRingFrames, 2, layout);
+    if (layout == RingBufferFloat::Layout::kMirrored && !ring.mirrored())
+      return;
+    printHeader(ring.mirrored() ? "Ring reads, mirrored ring" : "Ring reads");
+    const uint32_t maxBlock = kBlocks[kBlockCount - 1];
+    for (uint32_t ch = 0; ch < 2; ch++)
+      for (uint32_t i = 0; i < ring.capacity(); i++)
+        ring.data(ch)[i] = static_cast<float>(i & 1023) / 1024.0f;
+    // Half the ring readable from either start position, so no block underruns
+    ring.advanceWrite(ring.capacity() / 2);
+
+    std::vector<float> left(maxBlock), right(maxBlock);
+    float *outputs[2] = {left.data(), right.data()};
+    std::vector<double> left64(maxBlock), right64(maxBlock);
+    double *outputs64[2] = {left64.data(), right64.data()};
+    const int stereo[2] = {0, 1};
+    const int mono[2] = {0, 0};
+
+    for (int isa = 0; isa <= widest; isa++)
+    {
+      const DspKernels::Table &kernels = DspKernels::forIsa(static_cast<CpuFeatures::Isa>(isa));
+      ring.setKernels(kernels);
+      const char *isaName = CpuFeatures::isaName(static_cast<CpuFeatures::Isa>(isa));
+      for (int wrapped = 0; wrapped < 2; wrapped++)
+      {
+        double read[kBlockCount], planarStereo[kBlockCount], planarMono[kBlockCount], planarStereo64[kBlockCount];
+        for (int b = 0; b < kBlockCount; b++)
+        {
+          const uint32_t block = kBlocks[b];
+          const uint32_t start = wrapped ? ring.capacity() - block / 2 : 0;
+          read[b] = nsPerSample([&]
+                                { ring.setReadPos(start); ring.read(left.data(), block); g_sink = left[0]; },
+                                block);
+          // Per output sample, as the host sees it
+          planarStereo[b] = nsPerSample([&]
+                                        { ring.setReadPos(start); PlanarReadPath::read(ring, kernels, stereo, outputs, 2, static_cast<int>(block)); g_sink = right[0]; },
+                                        2 * block);
+          planarMono[b] = nsPerSample([&]
+                                      { ring.setReadPos(start); PlanarReadPath::read(ring, kernels, mono, outputs, 2, static_cast<int>(block)); g_sink = right[0]; },
+                                      2 * block);
+          planarStereo64[b] = nsPerSample([&]
+                                          { ring.setReadPos(start); PlanarReadPath::read(ring, kernels, stereo, outputs64, 2, static_cast<int>(block)); g_sink = static_cast<float>(right64[0]); },
+                                          2 * block);
+        }
+        const char *where = wrapped ? "wrapped" : "contiguous";
+        char label[48];
+        std::snprintf(label, sizeof(label), "read %s", where);
+        printRow(label, isaName, read);
+        std::snprintf(label, sizeof(label), "stereo pair %s", where);
+        printRow(label, isaName, planarStereo);
+        std::snprintf(label, sizeof(label), "mono to both %s", where);
+        printRow(label, isaName, planarMono);
+        std::snprintf(label, sizeof(label), "stereo pair 64-bit %s", where);
+        printRow(label, isaName, planarStereo64);
+      }
+    }
+  }
+}
+
+int main()
+{
+  const int widest = static_cast<int>(CpuFeatures::detectIsa());
+  std::printf("Widest instruction set on this machine: %s\n", CpuFeatures::isaName(CpuFeatures::detectIsa()));
+  benchConverters(widest);
+  benchCapture(widest);
+  benchReads(widest, RingBufferFloat::Layout::kPlain);
+  benchReads(widest, RingBufferFloat::Layout::kMirrored);
+  std::printf("\n(sink %g)\n", static_cast<double>(g_sink));
+  return 0;
+}
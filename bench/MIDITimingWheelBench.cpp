@@ -0,0 +1,151 @@
+// Insert/drain cost of the scheduler's timing wheel against the std::priority_queue
+// min-heap it replaced, at 10k queued events.
+
+#include "Processor/HardwareSynthesizer/MIDITimingWheel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+using namespace Newkon;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+  constexpr int kEvents = 10000;
+  constexpr int kRuns = 51;
+
+  // The entry type MIDIScheduler used before the timing wheel
+  struct Scheduled
+  {
+    Clock::time_point when;
+    uint32_t msg;
+    bool operator>(const Scheduled &other) const { return when > other.when; }
+  };
+
+  struct Timing
+  {
+    double insertNs;
+    double drainNs;
+    int reordered; // same-timestamp events that left out of insertion order
+  };
+
+  double nsPerEvent(Clock::duration d)
+  {
+    return std::chrono::duration<double, std::nano>(d).count() / kEvents;
+  }
+
+  // Events spread over two seconds on a 1/48000 s grid, with chords (shared timestamps)
+  std::vector<Clock::time_point> makeWorkload(Clock::time_point origin, uint32_t seed)
+  {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> frame(0, 96000);
+    std::vector<Clock::time_point> times;
+    times.reserve(kEvents);
+    while (static_cast<int>(times.size()) < kEvents)
+    {
+      const auto t = origin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(frame(rng) / 48000.0));
+      const int chord = 1 + static_cast<int>(rng() % 6);
+      for (int i = 0; i < chord && static_cast<int>(times.size()) < kEvents; i++)
+        times.push_back(t);
+    }
+    return times;
+  }
+
+  Timing runHeap(const std::vector<Clock::time_point> &times, Clock::time_point origin)
+  {
+    std::vector<Scheduled> storage;
+    storage.reserve(kEvents);
+    std::priority_queue<Scheduled, std::vector<Scheduled>, std::greater<Scheduled>> heap(std::greater<Scheduled>(), std::move(storage));
+
+    const auto t0 = Clock::now();
+    for (int i = 0; i < kEvents; i++)
+      heap.push(Scheduled{times[i], static_cast<uint32_t>(i)});
+    const auto t1 = Clock::now();
+
+    // Drain as the scheduler does: the clock advances 1 ms per wake-up
+    int reordered = 0;
+    Scheduled last{origin, 0};
+    for (auto now = origin; !heap.empty(); now += std::chrono::milliseconds(1))
+    {
+      while (!heap.empty() && heap.top().when <= now)
+      {
+        const Scheduled s = heap.top();
+        heap.pop();
+        if (s.when == last.when && s.msg < last.msg)
+          reordered++;
+        last = s;
+      }
+    }
+    const auto t2 = Clock::now();
+    return Timing{nsPerEvent(t1 - t0), nsPerEvent(t2 - t1), reordered};
+  }
+
+  Timing runWheel(MIDITimingWheel &wheel, const std::vector<Clock::time_point> &times, Clock::time_point origin)
+  {
+    wheel.reset(origin);
+
+    const auto t0 = Clock::now();
+    for (int i = 0; i < kEvents; i++)
+      wheel.insert(times[i], static_cast<uint32_t>(i));
+    const auto t1 = Clock::now();
+
+    int reordered = 0;
+    MIDITimingWheel::Entry last{origin, 0, 0};
+    MIDITimingWheel::Entry e;
+    for (auto now = origin; !wheel.empty(); now += std::chrono::milliseconds(1))
+    {
+      while (wheel.popDue(now, e))
+      {
+        if (e.when == last.when && e.msg < last.msg)
+          reordered++;
+        last = e;
+      }
+    }
+    const auto t2 = Clock::now();
+    return Timing{nsPerEvent(t1 - t0), nsPerEvent(t2 - t1), reordered};
+  }
+
+  double median(std::vector<double> v)
+  {
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+  }
+
+  void report(const char *name, const std::vector<Timing> &runs)
+  {
+    std::vector<double> ins, drn;
+    int reordered = 0;
+    for (const auto &r : runs)
+    {
+      ins.push_back(r.insertNs);
+      drn.push_back(r.drainNs);
+      reordered += r.reordered;
+    }
+    std::printf("%-16s insert %8.1f ns/event   drain %8.1f ns/event   reordered %d\n",
+                name, median(ins), median(drn), reordered);
+  }
+}
+
+int main()
+{
+  MIDITimingWheel wheel(kEvents);
+  std::vector<Timing> heapRuns, wheelRuns;
+  for (int run = 0; run < kRuns; run++)
+  {
+    const auto origin = Clock::now();
+    const auto times = makeWorkload(origin, static_cast<uint32_t>(run + 1));
+    heapRuns.push_back(runHeap(times, origin));
+    wheelRuns.push_back(runWheel(wheel, times, origin));
+  }
+
+  std::printf("%d queued events, median of %d runs\n", kEvents, kRuns);
+  report("priority_queue", heapRuns);
+  report("timing wheel", wheelRuns);
+  return 0;
+}
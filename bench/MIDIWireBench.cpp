@@ -0,0 +1,137 @@
+// Chord-onset skew on a 31,250 baud DIN port, predicted by MIDIWireEncoder's wire model,
+// before (FIFO, full status bytes) and after (priority ordering + running status).
+// Workload: a 12-note chord every beat, released on the next beat, with four CC automation
+// lanes landing on the same instants and delivered by the host ahead of the notes.
+// Also checks that prioritize() keeps notes behind pedal and channel mode messages; exits with
+// status 1 if it does not.
+
+#include "Processor/HardwareSynthesizer/MIDIWireEncoder.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using namespace Newkon;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+  constexpr int kBeats = 1000;
+  constexpr int kChordNotes = 12;
+  constexpr int kCcLanes = 4;
+  constexpr std::chrono::milliseconds kBeat{500};
+
+  uint32_t shortMsg(uint32_t status, uint32_t data1, uint32_t data2)
+  {
+    return status | (data1 << 8) | (data2 << 16);
+  }
+
+  // Events of one beat in host order (automation first, then releases, then the new chord)
+  std::vector<uint32_t> beatEvents(int beat)
+  {
+    std::vector<uint32_t> msgs;
+    for (int lane = 0; lane < kCcLanes; lane++)
+      msgs.push_back(shortMsg(0xB0, 1 + lane, static_cast<uint32_t>((beat * 7 + lane * 13) & 0x7F)));
+    const uint32_t root = 36 + static_cast<uint32_t>(beat % 12);
+    const uint32_t prevRoot = 36 + static_cast<uint32_t>((beat + 11) % 12);
+    if (beat > 0)
+      for (int n = 0; n < kChordNotes; n++)
+        msgs.push_back(shortMsg(0x80, prevRoot + 2 * n, 64));
+    for (int n = 0; n < kChordNotes; n++)
+      msgs.push_back(shortMsg(0x90, root + 2 * n, 100));
+    return msgs;
+  }
+
+  struct Result
+  {
+    MIDIWireEncoder::Stats stats;
+    double meanLastNoteLateUs; // last note-on of a chord: predicted arrival minus scheduled time
+  };
+
+  Result run(bool optimized)
+  {
+    MIDIWireEncoder encoder;
+    MIDIWireEncoder::Options options;
+    options.runningStatus = optimized;
+    options.noteOffAsZeroVelocity = optimized;
+    encoder.setOptions(options);
+
+    const auto origin = Clock::now();
+    double lateSumUs = 0.0;
+    uint64_t seq = 0;
+    MIDITimingWheel::Entry batch[MIDIWireEncoder::kMaxBatch];
+    for (int beat = 0; beat < kBeats; beat++)
+    {
+      const auto when = origin + beat * kBeat;
+      const auto msgs = beatEvents(beat);
+      uint32_t count = 0;
+      for (uint32_t msg : msgs)
+        batch[count++] = MIDITimingWheel::Entry{when, seq++, msg};
+      if (optimized)
+        MIDIWireEncoder::prioritize(batch, count);
+
+      Clock::time_point lastNoteOn = when;
+      for (uint32_t i = 0; i < count; i++)
+      {
+        const auto encoded = encoder.encode(batch[i].msg, batch[i].when, when);
+        if ((batch[i].msg & 0xF0) == 0x90)
+          lastNoteOn = encoded.wireEnd;
+      }
+      lateSumUs += std::chrono::duration<double, std::micro>(lastNoteOn - when).count();
+    }
+    // A later instant closes the final chord
+    encoder.encode(shortMsg(0xB0, 7, 0), origin + kBeats * kBeat, origin + kBeats * kBeat);
+    return Result{encoder.stats(), lateSumUs / kBeats};
+  }
+
+  // prioritize() must not move a note across a message that changes its meaning: `msgs` share one
+  // instant, the note is last and must stay behind `barrier`
+  bool keepsBehind(const char *name, uint32_t barrier, uint32_t note)
+  {
+    const auto when = Clock::now();
+    const uint32_t msgs[] = {shortMsg(0xB0, 1, 10), shortMsg(0xB0, 7, 100), barrier, note};
+    MIDITimingWheel::Entry batch[4];
+    for (uint32_t i = 0; i < 4; i++)
+      batch[i] = MIDITimingWheel::Entry{when, i, msgs[i]};
+    MIDIWireEncoder::prioritize(batch, 4);
+    uint32_t barrierAt = 0, noteAt = 0;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+      if (batch[i].msg == barrier)
+        barrierAt = i;
+      else if (batch[i].msg == note)
+        noteAt = i;
+    }
+    const bool kept = barrierAt < noteAt;
+    std::printf("  %-38s %s\n", name, kept ? "ok" : "FAILED");
+    return kept;
+  }
+
+  bool checkBarriers()
+  {
+    std::printf("barrier ordering\n");
+    bool ok = true;
+    ok &= keepsBehind("note-on after all sound off (CC 120)", shortMsg(0xB0, 120, 0), shortMsg(0x90, 60, 100));
+    ok &= keepsBehind("note-on after all notes off (CC 123)", shortMsg(0xB0, 123, 0), shortMsg(0x90, 60, 100));
+    ok &= keepsBehind("note-off after sustain on (CC 64)", shortMsg(0xB0, 64, 127), shortMsg(0x80, 60, 64));
+    ok &= keepsBehind("note-off after sostenuto on (CC 66)", shortMsg(0xB0, 66, 127), shortMsg(0x80, 60, 64));
+    ok &= keepsBehind("note-on after soft pedal on (CC 67)", shortMsg(0xB0, 67, 127), shortMsg(0x90, 60, 100));
+    return ok;
+  }
+
+  void report(const char *name, const Result &r)
+  {
+    std::printf("%-28s %6.2f bytes/msg   chord skew mean %7.1f us  max %7.1f us   last note-on late %7.1f us\n",
+                name, static_cast<double>(r.stats.bytes) / static_cast<double>(r.stats.messages),
+                r.stats.meanChordSkewUs, r.stats.maxChordSkewUs, r.meanLastNoteLateUs);
+  }
+}
+
+int main()
+{
+  std::printf("%d beats of a %d-note chord + %d CC lanes, DIN wire model\n", kBeats, kChordNotes, kCcLanes);
+  report("fifo, full status", run(false));
+  report("priority + running status", run(true));
+  return checkBarriers() ? 0 : 1;
+}
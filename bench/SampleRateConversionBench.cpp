@@ -0,0 +1,130 @@
+// Device-to-host sample-rate conversion in the ASIO callback (PolyphaseResampler). For common rate
+// pairs and small device buffers it reports, per kernel, the cost per input frame and the share of the
+// buffer period spent converting, the error on a 1 kHz tone against the ideal delayed sine and, when
+// downsampling, how much of a tone above the output Nyquist folds back.
+
+#include "Processor/Asio/PolyphaseResampler.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using namespace Newkon;
+
+namespace
+{
+  constexpr double kPi = 3.14159265358979323846;
+
+  struct RatePair
+  {
+    uint32_t input;
+    uint32_t output;
+  };
+
+  // Converts `seconds` of a sine at `frequency` in blocks of `block` frames; returns the output
+  std::vector<float> convertTone(PolyphaseResampler &src, const RatePair &pair, double frequency, double seconds, uint32_t block)
+  {
+    const uint32_t frames = static_cast<uint32_t>(seconds * pair.input);
+    std::vector<float> in(block);
+    std::vector<float> out;
+    std::vector<float> chunk(src.maxOutputFrames(block));
+    src.reset();
+    for (uint32_t pos = 0; pos + block <= frames; pos += block)
+    {
+      for (uint32_t i = 0; i < block; i++)
+        in[i] = static_cast<float>(0.5 * std::sin(2.0 * kPi * frequency * (pos + i) / pair.input));
+      const uint32_t produced = src.process(in.data(), block, chunk.data());
+      out.insert(out.end(), chunk.begin(), chunk.begin() + produced);
+    }
+    return out;
+  }
+
+  double toneSnrDb(PolyphaseResampler &src, const RatePair &pair)
+  {
+    const double frequency = 1000.0;
+    const std::vector<float> out = convertTone(src, pair, frequency, 1.0, 64);
+    const double delay = src.delayInputFrames() / pair.input;
+    double signal = 0.0, noise = 0.0;
+    for (size_t m = 1024; m < out.size(); m++)
+    {
+      const double ideal = 0.5 * std::sin(2.0 * kPi * frequency * (static_cast<double>(m) / pair.output - delay));
+      signal += ideal * ideal;
+      noise += (out[m] - ideal) * (out[m] - ideal);
+    }
+    return 10.0 * std::log10(signal / (noise > 0.0 ? noise : 1e-30));
+  }
+
+  double aliasDb(PolyphaseResampler &src, const RatePair &pair)
+  {
+    // Downsampling: a tone 5% above the output Nyquist must not come through
+    const std::vector<float> out = convertTone(src, pair, 0.5 * pair.output * 1.05, 1.0, 64);
+    double power = 0.0;
+    size_t count = 0;
+    for (size_t m = 1024; m < out.size(); m++, count++)
+      power += static_cast<double>(out[m]) * out[m];
+    const double rms = std::sqrt(power / (count ? count : 1));
+    return 20.0 * std::log10((rms > 0.0 ? rms : 1e-12) / (0.5 / std::sqrt(2.0)));
+  }
+
+  void timeKernel(PolyphaseResampler &src, const RatePair &pair, uint32_t block)
+  {
+    const int callbacks = static_cast<int>(20.0 * pair.input / block);
+    std::vector<float> in(block);
+    std::vector<float> out(src.maxOutputFrames(block));
+    for (uint32_t i = 0; i < block; i++)
+      in[i] = static_cast<float>(std::sin(0.01 * i));
+    src.reset();
+
+    double worst = 0.0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < callbacks; c++)
+    {
+      const auto t0 = std::chrono::steady_clock::now();
+      src.process(in.data(), block, out.data());
+      const double took = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+      if (took > worst)
+        worst = took;
+    }
+    const double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double period = static_cast<double>(block) / pair.input;
+    std::printf("  %-7s  buffer %4u: %6.2f ns/frame, %5.2f%% of the period on average, %5.2f%% worst\n",
+                CpuFeatures::isaName(src.kernel()), block, total * 1e9 / (static_cast<double>(callbacks) * block),
+                100.0 * total / callbacks / period, 100.0 * worst / period);
+  }
+}
+
+int main()
+{
+  const RatePair pairs[] = {{48000, 44100}, {44100, 48000}, {96000, 44100}, {44100, 96000}, {48000, 88200}};
+  const uint32_t blocks[] = {32, 64, 128, 256};
+  // Every kernel this machine runs, from the baseline up
+  const int widest = static_cast<int>(CpuFeatures::detectIsa());
+
+  for (const RatePair &pair : pairs)
+  {
+    PolyphaseResampler src;
+    const auto designStart = std::chrono::steady_clock::now();
+    if (!src.configure(pair.input, pair.output, 256))
+    {
+      std::printf("%u -> %u Hz: not supported\n", pair.input, pair.output);
+      continue;
+    }
+    const double design = std::chrono::duration<double>(std::chrono::steady_clock::now() - designStart).count();
+    std::printf("%u -> %u Hz: %u/%u, %u taps per phase, delay %.1f input frames, bank designed in %.1f ms\n",
+                pair.input, pair.output, src.interpolation(), src.decimation(), src.tapsPerPhase(),
+                src.delayInputFrames(), design * 1e3);
+    for (int k = 0; k <= widest; k++)
+    {
+      src.setKernel(static_cast<CpuFeatures::Isa>(k));
+      for (uint32_t block : blocks)
+        timeKernel(src, pair, block);
+      std::printf("  %-7s  1 kHz tone SNR %.1f dB", CpuFeatures::isaName(src.kernel()), toneSnrDb(src, pair));
+      if (pair.input > pair.output)
+        std::printf(", alias above Nyquist %.1f dB", aliasDb(src, pair));
+      std::printf("\n");
+    }
+  }
+  return 0;
+}
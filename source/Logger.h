@@ -3,6 +3,8 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <cstdlib>
+#include <filesystem>
 
 namespace Newkon
 {
@@ -45,8 +47,18 @@ namespace Newkon
       instance.close();
     }
 
+    // HARDWARE_SYNTH_LOG_PATH if set, otherwise hardware-synth-log.txt in the temp directory
+    static std::string defaultPath()
+    {
+      if (const char *env = std::getenv("HARDWARE_SYNTH_LOG_PATH"))
+        return env;
+      std::error_code ec;
+      const auto dir = std::filesystem::temp_directory_path(ec);
+      return ec ? std::string("hardware-synth-log.txt") : (dir / "hardware-synth-log.txt").string();
+    }
+
   private:
-    Logger(bool debug = true) : std::ofstream(debug ? "C:\\Users\\jusde\\dev\\hardware-synth\\logs.txt" : "", debug ? std::ios::app : std::ios::out) {}
+    Logger(bool debug = true) : std::ofstream(debug ? defaultPath() : "", debug ? std::ios::app : std::ios::out) {}
   };
 #endif
 } // namespace Newkon
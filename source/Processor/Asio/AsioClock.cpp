@@ -0,0 +1,72 @@
+#include "AsioClock.h"
+#include <cmath>
+
+namespace Newkon
+{
+  void AsioClock::publish(int64_t samplePosition, int32_t bufferFrames, double sampleRate, std::chrono::steady_clock::time_point time)
+  {
+    const uint32_t seq = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(seq + 1, std::memory_order_relaxed); // odd: update in progress
+    std::atomic_thread_fence(std::memory_order_release);
+    samplePosition_.store(samplePosition, std::memory_order_relaxed);
+    timeNs_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count(), std::memory_order_relaxed);
+    sampleRate_.store(sampleRate, std::memory_order_relaxed);
+    bufferFrames_.store(bufferFrames, std::memory_order_relaxed);
+    valid_.store(sampleRate > 0.0, std::memory_order_relaxed);
+    sequence_.store(seq + 2, std::memory_order_release);
+  }
+
+  void AsioClock::invalidate()
+  {
+    const uint32_t seq = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    valid_.store(false, std::memory_order_relaxed);
+    sequence_.store(seq + 2, std::memory_order_release);
+  }
+
+  bool AsioClock::snapshot(Anchor &anchor) const
+  {
+    for (;;)
+    {
+      const uint32_t before = sequence_.load(std::memory_order_acquire);
+      if (before & 1u)
+        continue; // writer in progress, its critical section is a handful of stores
+      const bool valid = valid_.load(std::memory_order_relaxed);
+      anchor.samplePosition = samplePosition_.load(std::memory_order_relaxed);
+      anchor.time = std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::nanoseconds(timeNs_.load(std::memory_order_relaxed))));
+      anchor.sampleRate = sampleRate_.load(std::memory_order_relaxed);
+      anchor.bufferFrames = bufferFrames_.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == before)
+        return valid;
+    }
+  }
+
+  bool AsioClock::frameAt(std::chrono::steady_clock::time_point time, int64_t &frame) const
+  {
+    Anchor a;
+    if (!snapshot(a))
+      return false;
+    const double elapsed = std::chrono::duration<double>(time - a.time).count();
+    frame = a.samplePosition + static_cast<int64_t>(std::llround(elapsed * a.sampleRate));
+    return true;
+  }
+
+  bool AsioClock::timeAtFrame(int64_t frame, std::chrono::steady_clock::time_point &time) const
+  {
+    Anchor a;
+    if (!snapshot(a))
+      return false;
+    const double seconds = static_cast<double>(frame - a.samplePosition) / a.sampleRate;
+    time = a.time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    return true;
+  }
+
+  double AsioClock::sampleRate() const
+  {
+    Anchor a;
+    return snapshot(a) ? a.sampleRate : 0.0;
+  }
+}
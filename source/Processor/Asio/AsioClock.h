@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+
+namespace Newkon
+{
+  // Maps the ASIO device's sample clock to steady_clock time.
+  // The ASIO callback publishes one anchor per buffer switch (device sample position <-> callback time);
+  // any other thread converts between device frames and time points against the latest anchor.
+  // Publishing is wait-free, reading retries only while a publish is in progress (sequence lock with a
+  // single writer), so readers never hold up the callback.
+  class AsioClock
+  {
+  public:
+    struct Anchor
+    {
+      int64_t samplePosition = 0;                   // device frame captured at `time`
+      std::chrono::steady_clock::time_point time{}; // when the buffer switch delivered that frame
+      double sampleRate = 0.0;
+      int32_t bufferFrames = 0;
+    };
+
+    AsioClock() = default;
+
+    // Writer side (ASIO callback thread).
+    void publish(int64_t samplePosition, int32_t bufferFrames, double sampleRate, std::chrono::steady_clock::time_point time);
+    void invalidate();
+
+    // Reader side. Return false while no valid anchor has been published.
+    bool snapshot(Anchor &anchor) const;
+    bool frameAt(std::chrono::steady_clock::time_point time, int64_t &frame) const;
+    bool timeAtFrame(int64_t frame, std::chrono::steady_clock::time_point &time) const;
+    double sampleRate() const;
+
+  private:
+    std::atomic<uint32_t> sequence_{0};
+    std::atomic<bool> valid_{false};
+    std::atomic<int64_t> samplePosition_{0};
+    std::atomic<int64_t> timeNs_{0};
+    std::atomic<double> sampleRate_{0.0};
+    std::atomic<int32_t> bufferFrames_{0};
+  };
+}
@@ -1,59 +1,247 @@
 #include "AsioConverters.h"
+#include "AsioConvertersKernels.h"
+#include <cmath>
+#include <cstring>
 
 namespace Newkon
 {
   namespace AsioConverters
   {
-    float convFloat32(const void *src, long index)
+    namespace detail
     {
-      const float *pf = static_cast<const float *>(src);
-      return pf[index];
-    }
+      namespace
+      {
+        inline uint16_t swap(uint16_t v) { return static_cast<uint16_t>((v << 8) | (v >> 8)); }
+        inline uint32_t swap(uint32_t v) { return (v >> 24) | ((v >> 8) & 0xFF00u) | ((v << 8) & 0xFF0000u) | (v << 24); }
+        inline uint64_t swap(uint64_t v) { return (static_cast<uint64_t>(swap(static_cast<uint32_t>(v))) << 32) | swap(static_cast<uint32_t>(v >> 32)); }
 
-    float convInt32(const void *src, long index)
-    {
-      const int32_t *pi = static_cast<const int32_t *>(src);
-      return static_cast<float>(pi[index]) * (1.0f / 2147483648.0f);
-    }
+        template <typename T>
+        inline T load(const uint8_t *p, bool msb)
+        {
+          T v;
+          std::memcpy(&v, p, sizeof(T));
+          return msb ? swap(v) : v;
+        }
 
-    float convInt32LSB24(const void *src, long index)
-    {
-      const int32_t *pi = static_cast<const int32_t *>(src);
-      return static_cast<float>(pi[index]) * (1.0f / 8388608.0f);
+        template <typename T>
+        inline void store(uint8_t *p, T v, bool msb)
+        {
+          if (msb)
+            v = swap(v);
+          std::memcpy(p, &v, sizeof(T));
+        }
+      }
+
+      void float32Scalar(const uint8_t *src, float *dst, long count, bool msb)
+      {
+        if (!msb)
+        {
+          if (count > 0)
+            std::memcpy(dst, src, sizeof(float) * count);
+          return;
+        }
+        for (long i = 0; i < count; i++)
+        {
+          const uint32_t bits = load<uint32_t>(src + i * 4, true);
+          std::memcpy(dst + i, &bits, sizeof(float));
+        }
+      }
+
+      void float64Scalar(const uint8_t *src, float *dst, long count, bool msb)
+      {
+        for (long i = 0; i < count; i++)
+        {
+          const uint64_t bits = load<uint64_t>(src + i * 8, msb);
+          double d;
+          std::memcpy(&d, &bits, sizeof(double));
+          dst[i] = static_cast<float>(d);
+        }
+      }
+
+      void int16Scalar(const uint8_t *src, float *dst, long count, bool msb)
+      {
+        for (long i = 0; i < count; i++)
+          dst[i] = static_cast<int16_t>(load<uint16_t>(src + i * 2, msb)) * (1.0f / 32768.0f);
+      }
+
+      void int24Scalar(const uint8_t *src, float *dst, long count, bool msb)
+      {
+        const int lo = msb ? 2 : 0, hi = msb ? 0 : 2;
+        for (long i = 0; i < count; i++)
+        {
+          const uint8_t *p = src + i * 3;
+          // Build the sample in the top three bytes so the arithmetic shift sign-extends it
+          const int32_t s = static_cast<int32_t>((static_cast<uint32_t>(p[lo]) << 8) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[hi]) << 24)) >> 8;
+          dst[i] = static_cast<float>(s) * (1.0f / 8388608.0f);
+        }
+      }
+
+      void int32Scalar(const uint8_t *src, float *dst, long count, float scale, bool msb)
+      {
+        for (long i = 0; i < count; i++)
+          dst[i] = static_cast<float>(static_cast<int32_t>(load<uint32_t>(src + i * 4, msb))) * scale;
+      }
+
+      void chainScalar(float *samples, long count, InputChain &chain)
+      {
+        float x1 = chain.dcX1, y1 = chain.dcY1, peak = chain.peak;
+        double sum = 0.0;
+        for (long i = 0; i < count; i++)
+        {
+          float y = samples[i] * chain.gain;
+          if (chain.dcBlock)
+          {
+            const float x = y;
+            y = x - x1 + chain.dcPole * y1;
+            x1 = x;
+            y1 = y;
+          }
+          samples[i] = y;
+          peak = std::fabs(y) > peak ? std::fabs(y) : peak;
+          sum += static_cast<double>(y) * y;
+        }
+        chain.dcX1 = x1;
+        chain.dcY1 = y1;
+        chain.peak = peak;
+        chain.sumSquares += sum;
+      }
     }
 
-    float convInt32LSB20(const void *src, long index)
+    namespace
     {
-      const int32_t *pi = static_cast<const int32_t *>(src);
-      return static_cast<float>(pi[index]) * (1.0f / 524288.0f);
+      // Signed integer with `bits` significant bits, clamped to its range
+      inline int32_t quantize(float x, int bits)
+      {
+        const double fullScale = static_cast<double>(1ll << (bits - 1));
+        const double v = std::nearbyint(static_cast<double>(x) * fullScale);
+        if (v >= fullScale)
+          return static_cast<int32_t>(fullScale - 1.0);
+        if (v < -fullScale)
+          return static_cast<int32_t>(-fullScale);
+        return static_cast<int32_t>(v);
+      }
+
+      template <bool Msb>
+      void writeFloat32(const float *src, void *dst, long count)
+      {
+        uint8_t *pd = static_cast<uint8_t *>(dst);
+        for (long i = 0; i < count; i++)
+        {
+          uint32_t bits;
+          std::memcpy(&bits, src + i, sizeof(bits));
+          detail::store(pd + i * 4, bits, Msb);
+        }
+      }
+
+      template <bool Msb>
+      void writeFloat64(const float *src, void *dst, long count)
+      {
+        uint8_t *pd = static_cast<uint8_t *>(dst);
+        for (long i = 0; i < count; i++)
+        {
+          const double d = src[i];
+          uint64_t bits;
+          std::memcpy(&bits, &d, sizeof(bits));
+          detail::store(pd + i * 8, bits, Msb);
+        }
+      }
+
+      template <bool Msb>
+      void writeInt16(const float *src, void *dst, long count)
+      {
+        uint8_t *pd = static_cast<uint8_t *>(dst);
+        for (long i = 0; i < count; i++)
+          detail::store(pd + i * 2, static_cast<uint16_t>(quantize(src[i], 16)), Msb);
+      }
+
+      template <bool Msb>
+      void writeInt24(const float *src, void *dst, long count)
+      {
+        const int lo = Msb ? 2 : 0, hi = Msb ? 0 : 2;
+        uint8_t *pd = static_cast<uint8_t *>(dst);
+        for (long i = 0; i < count; i++)
+        {
+          const uint32_t s = static_cast<uint32_t>(quantize(src[i], 24));
+          uint8_t *p = pd + i * 3;
+          p[lo] = static_cast<uint8_t>(s);
+          p[1] = static_cast<uint8_t>(s >> 8);
+          p[hi] = static_cast<uint8_t>(s >> 16);
+        }
+      }
+
+      template <int Bits, bool Msb>
+      void writeInt32(const float *src, void *dst, long count)
+      {
+        uint8_t *pd = static_cast<uint8_t *>(dst);
+        for (long i = 0; i < count; i++)
+          detail::store(pd + i * 4, static_cast<uint32_t>(quantize(src[i], Bits)), Msb);
+      }
     }
 
-    float convInt32LSB18(const void *src, long index)
+    int bytesPerSample(SampleFormat format)
     {
-      const int32_t *pi = static_cast<const int32_t *>(src);
-      return static_cast<float>(pi[index]) * (1.0f / 262144.0f);
+      switch (format)
+      {
+      case SampleFormat::kInt16LSB:
+      case SampleFormat::kInt16MSB:
+        return 2;
+      case SampleFormat::kInt24LSB:
+      case SampleFormat::kInt24MSB:
+        return 3;
+      case SampleFormat::kFloat64LSB:
+      case SampleFormat::kFloat64MSB:
+        return 8;
+      default:
+        return 4;
+      }
     }
 
-    float convInt32LSB16(const void *src, long index)
+    BlockConverter select(SampleFormat format, CpuFeatures::Isa isa)
     {
-      const int32_t *pi = static_cast<const int32_t *>(src);
-      return static_cast<float>(pi[index]) * (1.0f / 32768.0f);
+      const int index = static_cast<int>(format);
+      if (index < 0 || index >= static_cast<int>(SampleFormat::kCount))
+        return nullptr;
+      switch (isa)
+      {
+      case CpuFeatures::Isa::kAVX512:
+        return detail::avx512Kernels().convert[index];
+      case CpuFeatures::Isa::kAVX2:
+        return detail::avx2Kernels().convert[index];
+      default:
+        return detail::sse2Kernels().convert[index];
+      }
     }
 
-    float convInt24(const void *src, long index)
+    ChainConverter selectChain(SampleFormat format, CpuFeatures::Isa isa)
     {
-      const unsigned char *p = static_cast<const unsigned char *>(src);
-      const int32_t o = index * 3;
-      int32_t s = (int32_t)((int32_t)p[o + 0] | ((int32_t)p[o + 1] << 8) | ((int32_t)p[o + 2] << 16));
-      if (s & 0x00800000)
-        s |= 0xFF000000;
-      return (float)s * (1.0f / 8388608.0f);
+      const int index = static_cast<int>(format);
+      if (index < 0 || index >= static_cast<int>(SampleFormat::kCount))
+        return nullptr;
+      switch (isa)
+      {
+      case CpuFeatures::Isa::kAVX512:
+        return detail::avx512Kernels().chain[index];
+      case CpuFeatures::Isa::kAVX2:
+        return detail::avx2Kernels().chain[index];
+      default:
+        return detail::sse2Kernels().chain[index];
+      }
     }
 
-    float convInt16(const void *src, long index)
+    BlockWriter selectWriter(SampleFormat format)
     {
-      const int16_t *ps = static_cast<const int16_t *>(src);
-      return ps[index] * (1.0f / 32768.0f);
+      // Same order as SampleFormat
+      static const BlockWriter writers[] = {
+          writeFloat32<false>, writeFloat64<false>, writeInt16<false>, writeInt24<false>,
+          writeInt32<32, false>, writeInt32<16, false>, writeInt32<18, false>, writeInt32<20, false>, writeInt32<24, false>,
+          writeFloat32<true>, writeFloat64<true>, writeInt16<true>, writeInt24<true>,
+          writeInt32<32, true>, writeInt32<16, true>, writeInt32<18, true>, writeInt32<20, true>, writeInt32<24, true>,
+      };
+      static_assert(sizeof(writers) / sizeof(writers[0]) == static_cast<size_t>(SampleFormat::kCount), "one writer per SampleFormat");
+      const int index = static_cast<int>(format);
+      if (index < 0 || index >= static_cast<int>(SampleFormat::kCount))
+        return nullptr;
+      return writers[index];
     }
   }
 }
@@ -1,18 +1,74 @@
 #pragma once
 
+#include "CpuFeatures.h"
 #include <cstdint>
 
 namespace Newkon
 {
+  // Block converters from ASIO driver buffers to float. Every sample format has an SSE2, an AVX2 and an
+  // AVX-512 kernel, each in its own translation unit built for that instruction set; select() hands out
+  // the one for the widest set the CPU and OS support (CpuFeatures), once per stream start.
+  // Chain converters run an input stage (gain, DC blocker, metering) in the same pass as the
+  // conversion. Writers go the other way, for the insert outputs.
   namespace AsioConverters
   {
-    float convFloat32(const void *src, long index);
-    float convInt32(const void *src, long index);
-    float convInt32LSB24(const void *src, long index);
-    float convInt32LSB20(const void *src, long index);
-    float convInt32LSB18(const void *src, long index);
-    float convInt32LSB16(const void *src, long index);
-    float convInt24(const void *src, long index);
-    float convInt16(const void *src, long index);
+    // Driver sample formats we capture and write: the ASIO ASIOST* types
+    enum class SampleFormat : int
+    {
+      kFloat32LSB,
+      kFloat64LSB,
+      kInt16LSB,
+      kInt24LSB, // packed, 3 bytes per sample
+      kInt32LSB,
+      kInt32LSB16, // 32-bit container, 16/18/20/24 significant bits, LSB aligned
+      kInt32LSB18,
+      kInt32LSB20,
+      kInt32LSB24,
+      // Big-endian: byte-swapped on the way in, otherwise as above
+      kFloat32MSB,
+      kFloat64MSB,
+      kInt16MSB,
+      kInt24MSB,
+      kInt32MSB,
+      kInt32MSB16,
+      kInt32MSB18,
+      kInt32MSB20,
+      kInt32MSB24,
+      kCount
+    };
+
+    // Converts `count` samples at `src` to float in [-1, 1)
+    typedef void (*BlockConverter)(const void *src, float *dst, long count);
+
+    int bytesPerSample(SampleFormat format);
+
+    // Kernel for `format` on `isa`; pass CpuFeatures::detectIsa() for the fastest one this machine runs
+    BlockConverter select(SampleFormat format, CpuFeatures::Isa isa);
+
+    // Per-channel input stage of the chain converters: y = DC-block(gain * x), then the peak and sum of
+    // squares of y. The filter state carries across calls, so a block split in two (ring wrap) runs as one.
+    struct InputChain
+    {
+      float gain = 1.0f;
+      bool dcBlock = false;
+      float dcPole = 0.9993f; // R in y[n] = x[n] - x[n-1] + R y[n-1]
+      float dcX1 = 0.0f;      // last input and output of the filter
+      float dcY1 = 0.0f;
+      // Accumulated by every call; the caller resets them per metering period
+      float peak = 0.0f;
+      double sumSquares = 0.0;
+    };
+
+    // Converts `count` samples at `src` to float and runs them through `chain`
+    typedef void (*ChainConverter)(const void *src, float *dst, long count, InputChain &chain);
+
+    ChainConverter selectChain(SampleFormat format, CpuFeatures::Isa isa);
+
+    // Converts `count` float samples to the driver format at `dst`. Integer formats are rounded to
+    // nearest and clamped to full scale; float formats keep values past it.
+    typedef void (*BlockWriter)(const float *src, void *dst, long count);
+
+    // Writer for `format`. Plain C++: an insert drives a couple of outputs, not every captured channel.
+    BlockWriter selectWriter(SampleFormat format);
   }
 }
@@ -0,0 +1,231 @@
+// AVX2 converter kernels. Built with AVX2 code generation; only reached through select() after
+// detectIsa() has confirmed the CPU and OS support it.
+
+#include "AsioConvertersKernels.h"
+#include <immintrin.h>
+
+namespace Newkon
+{
+  namespace AsioConverters
+  {
+    namespace detail
+    {
+      namespace
+      {
+        // Byte reversal within each 2/4/8-byte element, per 128-bit lane
+        inline __m128i swap16(__m128i v) { return _mm_shuffle_epi8(v, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)); }
+
+        inline __m256i swap32(__m256i v)
+        {
+          return _mm256_shuffle_epi8(v, _mm256_setr_epi8(
+                                            3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                            3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+        }
+
+        inline __m256i swap64(__m256i v)
+        {
+          return _mm256_shuffle_epi8(v, _mm256_setr_epi8(
+                                            7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                            7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8));
+        }
+
+        inline __m256i load(const uint8_t *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+
+        // One per format: load8() reads eight samples as floats in [-1, 1), tail() finishes a block in
+        // plain C++, and kSlack counts the samples past the eight that a load touches
+        template <bool Msb>
+        struct Float32
+        {
+          static constexpr int kBytes = 4, kSlack = 0;
+          static __m256 load8(const uint8_t *p)
+          {
+            __m256i v = load(p);
+            if constexpr (Msb)
+              v = swap32(v);
+            return _mm256_castsi256_ps(v);
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { float32Scalar(p, dst, count, Msb); }
+        };
+
+        template <bool Msb>
+        struct Float64
+        {
+          static constexpr int kBytes = 8, kSlack = 0;
+          static __m256 load8(const uint8_t *p)
+          {
+            __m256i a = load(p), b = load(p + 32);
+            if constexpr (Msb)
+            {
+              a = swap64(a);
+              b = swap64(b);
+            }
+            const __m128 lo = _mm256_cvtpd_ps(_mm256_castsi256_pd(a));
+            const __m128 hi = _mm256_cvtpd_ps(_mm256_castsi256_pd(b));
+            return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { float64Scalar(p, dst, count, Msb); }
+        };
+
+        template <bool Msb>
+        struct Int16
+        {
+          static constexpr int kBytes = 2, kSlack = 0;
+          static __m256 load8(const uint8_t *p)
+          {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            if constexpr (Msb)
+              v = swap16(v);
+            return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v)), _mm256_set1_ps(1.0f / 32768.0f));
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { int16Scalar(p, dst, count, Msb); }
+        };
+
+        template <bool Msb>
+        struct Int24
+        {
+          // The upper lane's 16-byte load runs 4 bytes past the 8 samples
+          static constexpr int kBytes = 3, kSlack = 2;
+          static __m256 load8(const uint8_t *p)
+          {
+            // Each 128-bit lane takes four packed samples (12 bytes); the shuffle moves sample k's bytes
+            // into the top three bytes of dword k (reversing them for big-endian), and the arithmetic
+            // shift sign-extends it
+            const __m256i unpack = Msb ? _mm256_setr_epi8(
+                                             -1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9,
+                                             -1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9)
+                                       : _mm256_setr_epi8(
+                                             -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                             -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+            const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 12));
+            const __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            const __m256i s = _mm256_srai_epi32(_mm256_shuffle_epi8(v, unpack), 8);
+            return _mm256_mul_ps(_mm256_cvtepi32_ps(s), _mm256_set1_ps(1.0f / 8388608.0f));
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { int24Scalar(p, dst, count, Msb); }
+        };
+
+        template <int Bits, bool Msb>
+        struct Int32
+        {
+          static constexpr int kBytes = 4, kSlack = 0;
+          static __m256 load8(const uint8_t *p)
+          {
+            __m256i v = load(p);
+            if constexpr (Msb)
+              v = swap32(v);
+            return _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(scaleForBits(Bits)));
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { int32Scalar(p, dst, count, scaleForBits(Bits), Msb); }
+        };
+
+        template <typename Format>
+        void convert(const void *src, float *dst, long count)
+        {
+          const uint8_t *ps = static_cast<const uint8_t *>(src);
+          long i = 0;
+          for (; i + 16 + Format::kSlack <= count; i += 16)
+          {
+            _mm256_storeu_ps(dst + i, Format::load8(ps + i * Format::kBytes));
+            _mm256_storeu_ps(dst + i + 8, Format::load8(ps + (i + 8) * Format::kBytes));
+          }
+          for (; i + 8 + Format::kSlack <= count; i += 8)
+            _mm256_storeu_ps(dst + i, Format::load8(ps + i * Format::kBytes));
+          Format::tail(ps + i * Format::kBytes, dst + i, count - i);
+        }
+
+        // Lanes moved up by one, two or four across the 128-bit halves, zeros shifted in
+        inline __m256 shiftUp1(__m256 v)
+        {
+          return _mm256_blend_ps(_mm256_permutevar8x32_ps(v, _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6)), _mm256_setzero_ps(), 0x01);
+        }
+        inline __m256 shiftUp2(__m256 v)
+        {
+          return _mm256_blend_ps(_mm256_permutevar8x32_ps(v, _mm256_setr_epi32(0, 0, 0, 1, 2, 3, 4, 5)), _mm256_setzero_ps(), 0x03);
+        }
+        inline __m256 shiftUp4(__m256 v) { return _mm256_permute2f128_ps(v, v, 0x08); }
+        inline __m256 broadcastLast(__m256 v) { return _mm256_permutevar8x32_ps(v, _mm256_set1_epi32(7)); }
+
+        template <typename Format, bool DcBlock>
+        void chainLoop(const uint8_t *ps, float *dst, long count, InputChain &chain)
+        {
+          // The DC blocker as in the SSE2 kernel, eight lanes and three scan steps at a time
+          const float r = chain.dcPole;
+          float powers[8];
+          powers[0] = r;
+          for (int k = 1; k < 8; k++)
+            powers[k] = powers[k - 1] * r;
+          const __m256 gain = _mm256_set1_ps(chain.gain);
+          const __m256 r1 = _mm256_set1_ps(powers[0]), r2 = _mm256_set1_ps(powers[1]), r4 = _mm256_set1_ps(powers[3]);
+          const __m256 carryPowers = _mm256_loadu_ps(powers);
+          const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+          __m256 x1 = _mm256_set1_ps(chain.dcX1), y1 = _mm256_set1_ps(chain.dcY1);
+          __m256 peak = _mm256_setzero_ps(), sum = _mm256_setzero_ps();
+          long i = 0;
+          for (; i + 8 + Format::kSlack <= count; i += 8)
+          {
+            const __m256 x = _mm256_mul_ps(Format::load8(ps + i * Format::kBytes), gain);
+            __m256 y = x;
+            if constexpr (DcBlock)
+            {
+              y = _mm256_sub_ps(x, _mm256_blend_ps(shiftUp1(x), x1, 0x01));
+              y = _mm256_fmadd_ps(r1, shiftUp1(y), y);
+              y = _mm256_fmadd_ps(r2, shiftUp2(y), y);
+              y = _mm256_fmadd_ps(r4, shiftUp4(y), y);
+              y = _mm256_fmadd_ps(carryPowers, y1, y);
+              x1 = broadcastLast(x);
+              y1 = broadcastLast(y);
+            }
+            _mm256_storeu_ps(dst + i, y);
+            peak = _mm256_max_ps(peak, _mm256_and_ps(y, absMask));
+            sum = _mm256_fmadd_ps(y, y, sum);
+          }
+
+          float lanes[8];
+          _mm256_storeu_ps(lanes, peak);
+          for (float lane : lanes)
+            chain.peak = lane > chain.peak ? lane : chain.peak;
+          _mm256_storeu_ps(lanes, sum);
+          double total = 0.0;
+          for (float lane : lanes)
+            total += lane;
+          chain.sumSquares += total;
+          chain.dcX1 = _mm256_cvtss_f32(x1);
+          chain.dcY1 = _mm256_cvtss_f32(y1);
+
+          Format::tail(ps + i * Format::kBytes, dst + i, count - i);
+          chainScalar(dst + i, count - i, chain);
+        }
+
+        template <typename Format>
+        void convertChain(const void *src, float *dst, long count, InputChain &chain)
+        {
+          const uint8_t *ps = static_cast<const uint8_t *>(src);
+          if (chain.dcBlock)
+            chainLoop<Format, true>(ps, dst, count, chain);
+          else
+            chainLoop<Format, false>(ps, dst, count, chain);
+        }
+      }
+
+      const KernelTable &avx2Kernels()
+      {
+        // Same order as SampleFormat
+        static const KernelTable table = {
+            {
+                convert<Float32<false>>, convert<Float64<false>>, convert<Int16<false>>, convert<Int24<false>>,
+                convert<Int32<32, false>>, convert<Int32<16, false>>, convert<Int32<18, false>>, convert<Int32<20, false>>, convert<Int32<24, false>>,
+                convert<Float32<true>>, convert<Float64<true>>, convert<Int16<true>>, convert<Int24<true>>,
+                convert<Int32<32, true>>, convert<Int32<16, true>>, convert<Int32<18, true>>, convert<Int32<20, true>>, convert<Int32<24, true>>,
+            },
+            {
+                convertChain<Float32<false>>, convertChain<Float64<false>>, convertChain<Int16<false>>, convertChain<Int24<false>>,
+                convertChain<Int32<32, false>>, convertChain<Int32<16, false>>, convertChain<Int32<18, false>>, convertChain<Int32<20, false>>, convertChain<Int32<24, false>>,
+                convertChain<Float32<true>>, convertChain<Float64<true>>, convertChain<Int16<true>>, convertChain<Int24<true>>,
+                convertChain<Int32<32, true>>, convertChain<Int32<16, true>>, convertChain<Int32<18, true>>, convertChain<Int32<20, true>>, convertChain<Int32<24, true>>,
+            }};
+        return table;
+      }
+    }
+  }
+}
@@ -0,0 +1,214 @@
+// AVX-512 (F + BW) converter kernels. Built with AVX-512 code generation; only reached through select()
+// after detectIsa() has confirmed the CPU and OS support it.
+
+#include "AsioConvertersKernels.h"
+#include <immintrin.h>
+
+namespace Newkon
+{
+  namespace AsioConverters
+  {
+    namespace detail
+    {
+      namespace
+      {
+        // Byte reversal within each 2/4/8-byte element, per 128-bit lane
+        inline __m256i swap16(__m256i v)
+        {
+          return _mm256_shuffle_epi8(v, _mm256_broadcastsi128_si256(_mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)));
+        }
+
+        inline __m512i swap32(__m512i v)
+        {
+          return _mm512_shuffle_epi8(v, _mm512_broadcast_i32x4(_mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)));
+        }
+
+        inline __m512i swap64(__m512i v)
+        {
+          return _mm512_shuffle_epi8(v, _mm512_broadcast_i32x4(_mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8)));
+        }
+
+        // One per format: load16() reads sixteen samples as floats in [-1, 1), tail() finishes a block
+        // in plain C++, and kSlack counts the samples past the sixteen that a load touches
+        template <bool Msb>
+        struct Float32
+        {
+          static constexpr int kBytes = 4, kSlack = 0;
+          static __m512 load16(const uint8_t *p)
+          {
+            __m512i v = _mm512_loadu_si512(p);
+            if constexpr (Msb)
+              v = swap32(v);
+            return _mm512_castsi512_ps(v);
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { float32Scalar(p, dst, count, Msb); }
+        };
+
+        template <bool Msb>
+        struct Float64
+        {
+          static constexpr int kBytes = 8, kSlack = 0;
+          static __m512 load16(const uint8_t *p)
+          {
+            __m512i a = _mm512_loadu_si512(p), b = _mm512_loadu_si512(p + 64);
+            if constexpr (Msb)
+            {
+              a = swap64(a);
+              b = swap64(b);
+            }
+            // Joined as doubles: inserting a 256-bit float half needs AVX512DQ
+            const __m256 lo = _mm512_cvtpd_ps(_mm512_castsi512_pd(a));
+            const __m256 hi = _mm512_cvtpd_ps(_mm512_castsi512_pd(b));
+            return _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_castps_pd(lo)), _mm256_castps_pd(hi), 1));
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { float64Scalar(p, dst, count, Msb); }
+        };
+
+        template <bool Msb>
+        struct Int16
+        {
+          static constexpr int kBytes = 2, kSlack = 0;
+          static __m512 load16(const uint8_t *p)
+          {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            if constexpr (Msb)
+              v = swap16(v);
+            return _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(v)), _mm512_set1_ps(1.0f / 32768.0f));
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { int16Scalar(p, dst, count, Msb); }
+        };
+
+        template <bool Msb>
+        struct Int24
+        {
+          // The top lane's 16-byte load runs 4 bytes past the 16 samples
+          static constexpr int kBytes = 3, kSlack = 2;
+          static __m512 load16(const uint8_t *p)
+          {
+            // As the AVX2 kernel with four lanes: each takes four packed samples, the in-lane shuffle moves
+            // sample k into the top three bytes of dword k and the arithmetic shift sign-extends it
+            const __m512i unpack = _mm512_broadcast_i32x4(Msb ? _mm_setr_epi8(-1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9)
+                                                              : _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11));
+            __m512i v = _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+            v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 12)), 1);
+            v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 24)), 2);
+            v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 36)), 3);
+            const __m512i s = _mm512_srai_epi32(_mm512_shuffle_epi8(v, unpack), 8);
+            return _mm512_mul_ps(_mm512_cvtepi32_ps(s), _mm512_set1_ps(1.0f / 8388608.0f));
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { int24Scalar(p, dst, count, Msb); }
+        };
+
+        template <int Bits, bool Msb>
+        struct Int32
+        {
+          static constexpr int kBytes = 4, kSlack = 0;
+          static __m512 load16(const uint8_t *p)
+          {
+            __m512i v = _mm512_loadu_si512(p);
+            if constexpr (Msb)
+              v = swap32(v);
+            return _mm512_mul_ps(_mm512_cvtepi32_ps(v), _mm512_set1_ps(scaleForBits(Bits)));
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { int32Scalar(p, dst, count, scaleForBits(Bits), Msb); }
+        };
+
+        template <typename Format>
+        void convert(const void *src, float *dst, long count)
+        {
+          const uint8_t *ps = static_cast<const uint8_t *>(src);
+          long i = 0;
+          for (; i + 16 + Format::kSlack <= count; i += 16)
+            _mm512_storeu_ps(dst + i, Format::load16(ps + i * Format::kBytes));
+          Format::tail(ps + i * Format::kBytes, dst + i, count - i);
+        }
+
+        // Lanes moved up by `Shift`, zeros shifted in
+        template <int Shift>
+        inline __m512 shiftUp(__m512 v)
+        {
+          const __m512i index = _mm512_sub_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(Shift));
+          return _mm512_maskz_permutexvar_ps(static_cast<__mmask16>(0xFFFF << Shift), index, v);
+        }
+        inline __m512 broadcastLast(__m512 v) { return _mm512_permutexvar_ps(_mm512_set1_epi32(15), v); }
+
+        template <typename Format, bool DcBlock>
+        void chainLoop(const uint8_t *ps, float *dst, long count, InputChain &chain)
+        {
+          // The DC blocker as in the SSE2 kernel, sixteen lanes and four scan steps at a time
+          const float r = chain.dcPole;
+          float powers[16];
+          powers[0] = r;
+          for (int k = 1; k < 16; k++)
+            powers[k] = powers[k - 1] * r;
+          const __m512 gain = _mm512_set1_ps(chain.gain);
+          const __m512 r1 = _mm512_set1_ps(powers[0]), r2 = _mm512_set1_ps(powers[1]);
+          const __m512 r4 = _mm512_set1_ps(powers[3]), r8 = _mm512_set1_ps(powers[7]);
+          const __m512 carryPowers = _mm512_loadu_ps(powers);
+          const __m512i previous = _mm512_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14);
+          __m512 x1 = _mm512_set1_ps(chain.dcX1), y1 = _mm512_set1_ps(chain.dcY1);
+          __m512 peak = _mm512_setzero_ps(), sum = _mm512_setzero_ps();
+          long i = 0;
+          for (; i + 16 + Format::kSlack <= count; i += 16)
+          {
+            const __m512 x = _mm512_mul_ps(Format::load16(ps + i * Format::kBytes), gain);
+            __m512 y = x;
+            if constexpr (DcBlock)
+            {
+              // Lane 0's previous input is the carried one
+              y = _mm512_sub_ps(x, _mm512_mask_permutexvar_ps(x1, 0xFFFE, previous, x));
+              y = _mm512_fmadd_ps(r1, shiftUp<1>(y), y);
+              y = _mm512_fmadd_ps(r2, shiftUp<2>(y), y);
+              y = _mm512_fmadd_ps(r4, shiftUp<4>(y), y);
+              y = _mm512_fmadd_ps(r8, shiftUp<8>(y), y);
+              y = _mm512_fmadd_ps(carryPowers, y1, y);
+              x1 = broadcastLast(x);
+              y1 = broadcastLast(y);
+            }
+            _mm512_storeu_ps(dst + i, y);
+            peak = _mm512_max_ps(peak, _mm512_abs_ps(y));
+            sum = _mm512_fmadd_ps(y, y, sum);
+          }
+
+          const float blockPeak = _mm512_reduce_max_ps(peak);
+          chain.peak = blockPeak > chain.peak ? blockPeak : chain.peak;
+          chain.sumSquares += _mm512_reduce_add_ps(sum);
+          chain.dcX1 = _mm512_cvtss_f32(x1);
+          chain.dcY1 = _mm512_cvtss_f32(y1);
+
+          Format::tail(ps + i * Format::kBytes, dst + i, count - i);
+          chainScalar(dst + i, count - i, chain);
+        }
+
+        template <typename Format>
+        void convertChain(const void *src, float *dst, long count, InputChain &chain)
+        {
+          const uint8_t *ps = static_cast<const uint8_t *>(src);
+          if (chain.dcBlock)
+            chainLoop<Format, true>(ps, dst, count, chain);
+          else
+            chainLoop<Format, false>(ps, dst, count, chain);
+        }
+      }
+
+      const KernelTable &avx512Kernels()
+      {
+        // Same order as SampleFormat
+        static const KernelTable table = {
+            {
+                convert<Float32<false>>, convert<Float64<false>>, convert<Int16<false>>, convert<Int24<false>>,
+                convert<Int32<32, false>>, convert<Int32<16, false>>, convert<Int32<18, false>>, convert<Int32<20, false>>, convert<Int32<24, false>>,
+                convert<Float32<true>>, convert<Float64<true>>, convert<Int16<true>>, convert<Int24<true>>,
+                convert<Int32<32, true>>, convert<Int32<16, true>>, convert<Int32<18, true>>, convert<Int32<20, true>>, convert<Int32<24, true>>,
+            },
+            {
+                convertChain<Float32<false>>, convertChain<Float64<false>>, convertChain<Int16<false>>, convertChain<Int24<false>>,
+                convertChain<Int32<32, false>>, convertChain<Int32<16, false>>, convertChain<Int32<18, false>>, convertChain<Int32<20, false>>, convertChain<Int32<24, false>>,
+                convertChain<Float32<true>>, convertChain<Float64<true>>, convertChain<Int16<true>>, convertChain<Int24<true>>,
+                convertChain<Int32<32, true>>, convertChain<Int32<16, true>>, convertChain<Int32<18, true>>, convertChain<Int32<20, true>>, convertChain<Int32<24, true>>,
+            }};
+        return table;
+      }
+    }
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+// Shared between the per-instruction-set converter translation units; not part of the public API.
+
+#include "AsioConverters.h"
+
+namespace Newkon
+{
+  namespace AsioConverters
+  {
+    namespace detail
+    {
+      // Full scale of a signed LSB-aligned integer with `bits` significant bits
+      constexpr float scaleForBits(int bits) { return 1.0f / static_cast<float>(1ull << (bits - 1)); }
+
+      struct KernelTable
+      {
+        BlockConverter convert[static_cast<int>(SampleFormat::kCount)];
+        ChainConverter chain[static_cast<int>(SampleFormat::kCount)];
+      };
+
+      // One table per instruction set, each defined in its own translation unit
+      const KernelTable &sse2Kernels();
+      const KernelTable &avx2Kernels();
+      const KernelTable &avx512Kernels();
+
+      // Plain C++ versions; the vector kernels finish their tails with these. `msb` reads big-endian samples.
+      void float32Scalar(const uint8_t *src, float *dst, long count, bool msb);
+      void float64Scalar(const uint8_t *src, float *dst, long count, bool msb);
+      void int16Scalar(const uint8_t *src, float *dst, long count, bool msb);
+      void int24Scalar(const uint8_t *src, float *dst, long count, bool msb);
+      void int32Scalar(const uint8_t *src, float *dst, long count, float scale, bool msb);
+
+      // The input stage over converted samples, in place; the chain kernels finish their tails with it
+      void chainScalar(float *samples, long count, InputChain &chain);
+    }
+  }
+}
@@ -0,0 +1,211 @@
+// SSE2 converter kernels: the x64 baseline, used when the CPU or OS lacks AVX2.
+
+#include "AsioConvertersKernels.h"
+#include <emmintrin.h>
+
+namespace Newkon
+{
+  namespace AsioConverters
+  {
+    namespace detail
+    {
+      namespace
+      {
+        // No byte shuffle before SSSE3: swap bytes within each word with shifts, then reorder the words
+        inline __m128i swap16(__m128i v) { return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)); }
+
+        inline __m128i swap32(__m128i v)
+        {
+          v = swap16(v);
+          return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        }
+
+        inline __m128i swap64(__m128i v)
+        {
+          v = swap16(v);
+          return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+        }
+
+        inline __m128i load(const uint8_t *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+
+        // One per format: load4() reads four samples as floats in [-1, 1), tail() finishes a block in
+        // plain C++, and kSlack counts the samples past the four that a load touches
+        template <bool Msb>
+        struct Float32
+        {
+          static constexpr int kBytes = 4, kSlack = 0;
+          static __m128 load4(const uint8_t *p)
+          {
+            __m128i v = load(p);
+            if constexpr (Msb)
+              v = swap32(v);
+            return _mm_castsi128_ps(v);
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { float32Scalar(p, dst, count, Msb); }
+        };
+
+        template <bool Msb>
+        struct Float64
+        {
+          static constexpr int kBytes = 8, kSlack = 0;
+          static __m128 load4(const uint8_t *p)
+          {
+            __m128i a = load(p), b = load(p + 16);
+            if constexpr (Msb)
+            {
+              a = swap64(a);
+              b = swap64(b);
+            }
+            return _mm_movelh_ps(_mm_cvtpd_ps(_mm_castsi128_pd(a)), _mm_cvtpd_ps(_mm_castsi128_pd(b)));
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { float64Scalar(p, dst, count, Msb); }
+        };
+
+        template <bool Msb>
+        struct Int16
+        {
+          static constexpr int kBytes = 2, kSlack = 0;
+          static __m128 load4(const uint8_t *p)
+          {
+            // No pmovsx before SSE4.1: put each sample in the high half of a dword and shift it down
+            __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+            if constexpr (Msb)
+              v = swap16(v);
+            const __m128i s = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            return _mm_mul_ps(_mm_cvtepi32_ps(s), _mm_set1_ps(1.0f / 32768.0f));
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { int16Scalar(p, dst, count, Msb); }
+        };
+
+        template <bool Msb>
+        inline int32_t load24High(const uint8_t *p)
+        {
+          const uint8_t lo = Msb ? p[2] : p[0], hi = Msb ? p[0] : p[2];
+          return static_cast<int32_t>((static_cast<uint32_t>(lo) << 8) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(hi) << 24));
+        }
+
+        template <bool Msb>
+        struct Int24
+        {
+          static constexpr int kBytes = 3, kSlack = 0;
+          static __m128 load4(const uint8_t *p)
+          {
+            // No byte shuffle in SSE2: gather the 3-byte samples into the top of each dword with scalar
+            // loads, then sign-extend and convert four at a time
+            const __m128i v = _mm_set_epi32(load24High<Msb>(p + 9), load24High<Msb>(p + 6), load24High<Msb>(p + 3), load24High<Msb>(p));
+            return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(v, 8)), _mm_set1_ps(1.0f / 8388608.0f));
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { int24Scalar(p, dst, count, Msb); }
+        };
+
+        template <int Bits, bool Msb>
+        struct Int32
+        {
+          static constexpr int kBytes = 4, kSlack = 0;
+          static __m128 load4(const uint8_t *p)
+          {
+            __m128i v = load(p);
+            if constexpr (Msb)
+              v = swap32(v);
+            return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(scaleForBits(Bits)));
+          }
+          static void tail(const uint8_t *p, float *dst, long count) { int32Scalar(p, dst, count, scaleForBits(Bits), Msb); }
+        };
+
+        template <typename Format>
+        void convert(const void *src, float *dst, long count)
+        {
+          const uint8_t *ps = static_cast<const uint8_t *>(src);
+          long i = 0;
+          for (; i + 8 + Format::kSlack <= count; i += 8)
+          {
+            _mm_storeu_ps(dst + i, Format::load4(ps + i * Format::kBytes));
+            _mm_storeu_ps(dst + i + 4, Format::load4(ps + (i + 4) * Format::kBytes));
+          }
+          for (; i + 4 + Format::kSlack <= count; i += 4)
+            _mm_storeu_ps(dst + i, Format::load4(ps + i * Format::kBytes));
+          Format::tail(ps + i * Format::kBytes, dst + i, count - i);
+        }
+
+        // Lanes moved up by one or two, zeros shifted in
+        inline __m128 shiftUp1(__m128 v) { return _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)); }
+        inline __m128 shiftUp2(__m128 v) { return _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)); }
+        inline __m128 broadcastLast(__m128 v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)); }
+
+        template <typename Format, bool DcBlock>
+        void chainLoop(const uint8_t *ps, float *dst, long count, InputChain &chain)
+        {
+          // The DC blocker's recursion y[n] = d[n] + R y[n-1] (d[n] = x[n] - x[n-1]) runs four lanes at a
+          // time as a prefix scan: lane k gathers R^(k-j) d[j] in two shift-and-add steps, then the
+          // previous vector's last output arrives scaled by R^(k+1)
+          const float r = chain.dcPole;
+          const __m128 gain = _mm_set1_ps(chain.gain);
+          const __m128 r1 = _mm_set1_ps(r), r2 = _mm_set1_ps(r * r);
+          const __m128 carryPowers = _mm_setr_ps(r, r * r, r * r * r, r * r * r * r);
+          const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+          __m128 x1 = _mm_set1_ps(chain.dcX1), y1 = _mm_set1_ps(chain.dcY1);
+          __m128 peak = _mm_setzero_ps(), sum = _mm_setzero_ps();
+          long i = 0;
+          for (; i + 4 + Format::kSlack <= count; i += 4)
+          {
+            const __m128 x = _mm_mul_ps(Format::load4(ps + i * Format::kBytes), gain);
+            __m128 y = x;
+            if constexpr (DcBlock)
+            {
+              y = _mm_sub_ps(x, _mm_move_ss(shiftUp1(x), x1));
+              y = _mm_add_ps(y, _mm_mul_ps(r1, shiftUp1(y)));
+              y = _mm_add_ps(y, _mm_mul_ps(r2, shiftUp2(y)));
+              y = _mm_add_ps(y, _mm_mul_ps(carryPowers, y1));
+              x1 = broadcastLast(x);
+              y1 = broadcastLast(y);
+            }
+            _mm_storeu_ps(dst + i, y);
+            peak = _mm_max_ps(peak, _mm_and_ps(y, absMask));
+            sum = _mm_add_ps(sum, _mm_mul_ps(y, y));
+          }
+
+          float lanes[4];
+          _mm_storeu_ps(lanes, peak);
+          for (float lane : lanes)
+            chain.peak = lane > chain.peak ? lane : chain.peak;
+          _mm_storeu_ps(lanes, sum);
+          chain.sumSquares += static_cast<double>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+          chain.dcX1 = _mm_cvtss_f32(x1);
+          chain.dcY1 = _mm_cvtss_f32(y1);
+
+          Format::tail(ps + i * Format::kBytes, dst + i, count - i);
+          chainScalar(dst + i, count - i, chain);
+        }
+
+        template <typename Format>
+        void convertChain(const void *src, float *dst, long count, InputChain &chain)
+        {
+          const uint8_t *ps = static_cast<const uint8_t *>(src);
+          if (chain.dcBlock)
+            chainLoop<Format, true>(ps, dst, count, chain);
+          else
+            chainLoop<Format, false>(ps, dst, count, chain);
+        }
+      }
+
+      const KernelTable &sse2Kernels()
+      {
+        // Same order as SampleFormat
+        static const KernelTable table = {
+            {
+                convert<Float32<false>>, convert<Float64<false>>, convert<Int16<false>>, convert<Int24<false>>,
+                convert<Int32<32, false>>, convert<Int32<16, false>>, convert<Int32<18, false>>, convert<Int32<20, false>>, convert<Int32<24, false>>,
+                convert<Float32<true>>, convert<Float64<true>>, convert<Int16<true>>, convert<Int24<true>>,
+                convert<Int32<32, true>>, convert<Int32<16, true>>, convert<Int32<18, true>>, convert<Int32<20, true>>, convert<Int32<24, true>>,
+            },
+            {
+                convertChain<Float32<false>>, convertChain<Float64<false>>, convertChain<Int16<false>>, convertChain<Int24<false>>,
+                convertChain<Int32<32, false>>, convertChain<Int32<16, false>>, convertChain<Int32<18, false>>, convertChain<Int32<20, false>>, convertChain<Int32<24, false>>,
+                convertChain<Float32<true>>, convertChain<Float64<true>>, convertChain<Int16<true>>, convertChain<Int24<true>>,
+                convertChain<Int32<32, true>>, convertChain<Int32<16, true>>, convertChain<Int32<18, true>>, convertChain<Int32<20, true>>, convertChain<Int32<24, true>>,
+            }};
+        return table;
+      }
+    }
+  }
+}
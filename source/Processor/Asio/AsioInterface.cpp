@@ -1,6 +1,8 @@
 #include "AsioInterface.h"
 #include "RingBufferFloat.h"
+#include "PlanarReadPath.h"
 #include "../../Logger.h"
+#include "../../TraceLogger.h"
 #include <windows.h>
 #include <string>
 #include <vector>
@@ -11,6 +13,9 @@
 #include <cstring>
 #include <cstdlib>
 #include <atomic>
+#include <chrono>
+#include <thread>
+#include <type_traits>
 #include <xmmintrin.h>
 #include <immintrin.h>
 #include "AsioConverters.h"
@@ -33,27 +38,32 @@ namespace Newkon
     ASIOBufferInfo *bufferInfos = nullptr;
     ASIOChannelInfo *channelInfos = nullptr;
     long inputChannels = 0;
+    long outputChannels = 0;
     long minSize = 0;
     long maxSize = 0;
     long preferredSize = 0;
     long granularity = 0;
     ASIOSampleRate sampleRate = 0.0;
-    volatile bool callbacksEnabled = false;
-    volatile int activeCallbackCount = 0;
+    // The callback counts itself in before checking the flag, so a pause that sees no callback
+    // counted has none still running
+    std::atomic<bool> callbacksEnabled{false};
+    std::atomic<int> activeCallbackCount{0};
     int selectedInputIndex = -1;
-    // converters (mono path uses index 0)
-    typedef float (*SampleConverter)(const void *src, long index);
-    SampleConverter convertSample[2] = {nullptr, nullptr};
-    enum SampleKind
-    {
-      kKindUnknown = 0,
-      kKindFloat32,
-      kKindInt16,
-      kKindInt32,
-      kKindInt32LSB24
-    };
-    SampleKind kind[2] = {kKindUnknown, kKindUnknown};
-    float scale[2] = {1.0f, 1.0f};
+    // Captured channels, one per ASIO buffer; block converters are picked per channel at stream start
+    // (null for formats we cannot read, which capture silence)
+    long captureChannels = 0;
+    std::vector<AsioConverters::BlockConverter> convertBlock;
+    std::vector<int> sampleBytes;
+    // Input chains: converters and per-channel stage state and meters, owned by the callback. Every
+    // channel is metered; gain and DC blocking apply only while the input stage is on
+    std::vector<AsioConverters::ChainConverter> chainBlock;
+    std::vector<AsioConverters::InputChain> chains;
+    // Insert outputs, after the captured channels in bufferInfos/channelInfos; null writers for formats
+    // we cannot write, which stay silent
+    long insertChannels = 0;
+    std::vector<AsioConverters::BlockWriter> writeBlock;
+    std::vector<int> outputSampleBytes;
+    bool postOutput = false; // the driver wants ASIOOutputReady() once the outputs are filled
   };
 
   AsioInterface *AsioInterface::s_current = nullptr;
@@ -85,15 +95,90 @@ namespace Newkon
     }
   }
 
+  static inline int64_t asioSamplesToInt64(const ASIOSamples &s)
+  {
+    return static_cast<int64_t>((static_cast<uint64_t>(s.hi) << 32) | static_cast<uint64_t>(s.lo));
+  }
+
+  // Converter format for an ASIO sample type; kCount for types we cannot convert
+  static AsioConverters::SampleFormat sampleFormatFor(ASIOSampleType type)
+  {
+    switch (type)
+    {
+    case ASIOSTFloat32LSB:
+      return AsioConverters::SampleFormat::kFloat32LSB;
+    case ASIOSTInt32LSB:
+      return AsioConverters::SampleFormat::kInt32LSB;
+    case ASIOSTInt32LSB24:
+      return AsioConverters::SampleFormat::kInt32LSB24;
+    case ASIOSTInt32LSB20:
+      return AsioConverters::SampleFormat::kInt32LSB20;
+    case ASIOSTInt32LSB18:
+      return AsioConverters::SampleFormat::kInt32LSB18;
+    case ASIOSTInt32LSB16:
+      return AsioConverters::SampleFormat::kInt32LSB16;
+    case ASIOSTInt24LSB:
+      return AsioConverters::SampleFormat::kInt24LSB;
+    case ASIOSTInt16LSB:
+      return AsioConverters::SampleFormat::kInt16LSB;
+    case ASIOSTFloat64LSB:
+      return AsioConverters::SampleFormat::kFloat64LSB;
+    case ASIOSTFloat32MSB:
+      return AsioConverters::SampleFormat::kFloat32MSB;
+    case ASIOSTFloat64MSB:
+      return AsioConverters::SampleFormat::kFloat64MSB;
+    case ASIOSTInt32MSB:
+      return AsioConverters::SampleFormat::kInt32MSB;
+    case ASIOSTInt32MSB24:
+      return AsioConverters::SampleFormat::kInt32MSB24;
+    case ASIOSTInt32MSB20:
+      return AsioConverters::SampleFormat::kInt32MSB20;
+    case ASIOSTInt32MSB18:
+      return AsioConverters::SampleFormat::kInt32MSB18;
+    case ASIOSTInt32MSB16:
+      return AsioConverters::SampleFormat::kInt32MSB16;
+    case ASIOSTInt24MSB:
+      return AsioConverters::SampleFormat::kInt24MSB;
+    case ASIOSTInt16MSB:
+      return AsioConverters::SampleFormat::kInt16MSB;
+    default:
+      return AsioConverters::SampleFormat::kCount;
+    }
+  }
+
+  // Converts `count` samples of captured channel `ch`, starting at sample `offset` of its driver
+  // buffer, to float, through the channel's input chain (metering, and the input stage when on).
+  static void convertInput(AsioState *st, long ch, const void *src, int offset, float *dst, int count)
+  {
+    if (count <= 0)
+      return;
+    const uint8_t *p = static_cast<const uint8_t *>(src) + static_cast<size_t>(offset) * st->sampleBytes[ch];
+    if (ch < static_cast<long>(st->chains.size()) && st->chainBlock[ch])
+      st->chainBlock[ch](p, dst, count, st->chains[ch]);
+    else if (const AsioConverters::BlockConverter convert = st->convertBlock[ch])
+      convert(p, dst, count);
+    else
+      std::memset(dst, 0, sizeof(float) * count);
+  }
+
   void AsioInterface::bufferSwitchThunk(long index, ASIOBool /*processNow*/)
   {
+    AsioInterface::processBufferSwitch(index, nullptr);
+  }
+
+  void AsioInterface::processBufferSwitch(long index, ASIOTime *timeInfo)
+  {
+    const auto callbackTime = std::chrono::steady_clock::now();
     AsioInterface *self = AsioInterface::s_current;
     if (!self || !self->state)
       return;
     AsioState *st = self->state;
+    ++st->activeCallbackCount;
     if (!st->callbacksEnabled)
+    {
+      --st->activeCallbackCount;
       return;
-    ++st->activeCallbackCount;
+    }
     if (!st->bufferInfos || !st->channelInfos || st->preferredSize <= 0)
     {
       --st->activeCallbackCount;
@@ -105,6 +190,30 @@ namespace Newkon
       return;
     }
 
+    // Anchor the device sample clock to this buffer switch. samplePosition is the first frame of the
+    // half just delivered, so the frame captured "now" is one buffer later.
+    int64_t samplePosition = 0;
+    bool havePosition = false;
+    {
+      if (timeInfo && (timeInfo->timeInfo.flags & kSamplePositionValid))
+      {
+        samplePosition = asioSamplesToInt64(timeInfo->timeInfo.samplePosition);
+        havePosition = true;
+      }
+      else
+      {
+        ASIOSamples pos;
+        ASIOTimeStamp stamp;
+        if (ASIOGetSamplePosition(&pos, &stamp) == ASE_OK)
+        {
+          samplePosition = asioSamplesToInt64(pos);
+          havePosition = true;
+        }
+      }
+      if (havePosition)
+        self->sampleClock.publish(samplePosition + st->preferredSize, static_cast<int32_t>(st->preferredSize), st->sampleRate, callbackTime);
+    }
+
     // Set FTZ/DAZ once on this thread to avoid denormal stalls
     static thread_local bool s_mxcsrInitialized = false;
     if (!s_mxcsrInitialized)
@@ -115,148 +224,90 @@ namespace Newkon
       s_mxcsrInitialized = true;
     }
 
-    // Always treat as mono source and write mono frames
-    const int channelsToUse = 1;
-    const int writeBlock = static_cast<int>(st->preferredSize);
+    InputStage stage;
+    if (self->inputStages.take(stage))
+      self->applyInputStage(stage);
+    const long channels = st->captureChannels;
+    for (long ch = 0; ch < channels; ch++)
+    {
+      st->chains[ch].peak = 0.0f;
+      st->chains[ch].sumSquares = 0.0;
+    }
 
+    // Planar capture: each channel's driver buffer is converted once, straight into its ring plane
+    // (or, when converting rates, into a scratch block that is resampled into the plane)
+    for (long ch = 0; ch < channels + st->insertChannels; ch++)
     {
-      // Mono: convert first input channel only via precomputed converter
-      const void *src0 = st->bufferInfos[0].buffers[index];
-      if (!src0)
+      if (!st->bufferInfos[ch].buffers[index])
       {
         --st->activeCallbackCount;
         return;
       }
+    }
 
-      uint32_t wpos = self->ringBuffer.getWritePos();
-      int framesToWrite = static_cast<int>(st->preferredSize);
-      const uint32_t cap = self->ringBuffer.capacity();
-      if (wpos < 0 || wpos >= cap)
-        wpos = 0;
-      if (framesToWrite > (int)cap)
-        framesToWrite = (int)cap;
-      int contFrames = (int)cap - (int)wpos;
-      if (contFrames < 0)
-        contFrames = 0;
-      int f1 = framesToWrite < contFrames ? framesToWrite : contFrames;
-      const int totalToWrite = framesToWrite;
+    const uint32_t cap = self->ringBuffer.capacity();
+    uint32_t wpos = self->ringBuffer.getWritePos();
+    if (wpos >= cap)
+      wpos = 0;
+    const uint32_t blockStart = wpos;
 
-      if (st->kind[0] == AsioState::kKindFloat32)
-      {
-        const float *pf = static_cast<const float *>(src0);
-        std::memcpy(self->ringBuffer.data() + wpos, pf, sizeof(float) * f1);
-        wpos += f1;
-        if (wpos == self->ringBuffer.capacity())
-          wpos = 0;
-        framesToWrite -= f1;
-        if (framesToWrite > 0)
-        {
-          std::memcpy(self->ringBuffer.data(), pf + f1, sizeof(float) * framesToWrite);
-          wpos = framesToWrite;
-        }
-      }
-      else if (st->kind[0] == AsioState::kKindInt16)
-      {
-        const int16_t *ps = static_cast<const int16_t *>(src0);
-        const float s = st->scale[0];
-        int i = 0;
-        int n = f1 & ~15; // 16 samples per iter
-        const __m256 scale = _mm256_set1_ps(s);
-        for (; i < n; i += 16)
-        {
-          __m128i v16a = _mm_loadu_si128((const __m128i *)(ps + i));
-          __m128i v16b = _mm_loadu_si128((const __m128i *)(ps + i + 8));
-          __m256i v32a = _mm256_cvtepi16_epi32(v16a);
-          __m256i v32b = _mm256_cvtepi16_epi32(v16b);
-          __m256 fa = _mm256_mul_ps(_mm256_cvtepi32_ps(v32a), scale);
-          __m256 fb = _mm256_mul_ps(_mm256_cvtepi32_ps(v32b), scale);
-          _mm256_storeu_ps(self->ringBuffer.data() + wpos + i, fa);
-          _mm256_storeu_ps(self->ringBuffer.data() + wpos + i + 8, fb);
-        }
-        for (; i < f1; i++)
-          self->ringBuffer.data()[wpos + i] = ps[i] * s;
-        wpos += f1;
-        if (wpos == self->ringBuffer.capacity())
-          wpos = 0;
-        framesToWrite -= f1;
-        if (framesToWrite > 0)
-        {
-          int j = 0;
-          int m = framesToWrite & ~15;
-          for (; j < m; j += 16)
-          {
-            __m128i v16a = _mm_loadu_si128((const __m128i *)(ps + f1 + j));
-            __m128i v16b = _mm_loadu_si128((const __m128i *)(ps + f1 + j + 8));
-            __m256i v32a = _mm256_cvtepi16_epi32(v16a);
-            __m256i v32b = _mm256_cvtepi16_epi32(v16b);
-            __m256 fa = _mm256_mul_ps(_mm256_cvtepi32_ps(v32a), scale);
-            __m256 fb = _mm256_mul_ps(_mm256_cvtepi32_ps(v32b), scale);
-            _mm256_storeu_ps(self->ringBuffer.data() + j, fa);
-            _mm256_storeu_ps(self->ringBuffer.data() + j + 8, fb);
-          }
-          for (; j < framesToWrite; j++)
-            self->ringBuffer.data()[j] = ps[f1 + j] * s;
-          wpos = framesToWrite;
-        }
-      }
-      else if (st->kind[0] == AsioState::kKindInt32 || st->kind[0] == AsioState::kKindInt32LSB24)
+    if (self->rateConverting)
+    {
+      // Device rate -> host rate. The taps keep the device-rate samples so their frame stamps stay exact.
+      const int frames = static_cast<int>(st->preferredSize);
+      float *deviceBlock = self->convertScratch.data();
+      uint32_t toWrite = 0;
+      for (long ch = 0; ch < channels; ch++)
       {
-        const int32_t *pi = static_cast<const int32_t *>(src0);
-        const float s = st->scale[0];
-        int i = 0;
-        int n = f1 & ~7; // 8 samples per iter
-        const __m256 scale = _mm256_set1_ps(s);
-        for (; i < n; i += 8)
-        {
-          __m256i v = _mm256_loadu_si256((const __m256i *)(pi + i));
-          __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale);
-          _mm256_storeu_ps(self->ringBuffer.data() + wpos + i, f);
-        }
-        for (; i < f1; i++)
-          self->ringBuffer.data()[wpos + i] = pi[i] * s;
-        wpos += f1;
-        if (wpos == self->ringBuffer.capacity())
-          wpos = 0;
-        framesToWrite -= f1;
-        if (framesToWrite > 0)
-        {
-          int j = 0;
-          int m = framesToWrite & ~7;
-          for (; j < m; j += 8)
-          {
-            __m256i v = _mm256_loadu_si256((const __m256i *)(pi + f1 + j));
-            __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale);
-            _mm256_storeu_ps(self->ringBuffer.data() + j, f);
-          }
-          for (; j < framesToWrite; j++)
-            self->ringBuffer.data()[j] = pi[f1 + j] * s;
-          wpos = framesToWrite;
-        }
+        convertInput(st, ch, st->bufferInfos[ch].buffers[index], 0, deviceBlock, frames);
+        const uint32_t produced = self->rateConverters[ch].process(deviceBlock, static_cast<uint32_t>(frames), self->convertOutput.data());
+        toWrite = produced < cap ? produced : cap;
+        self->ringBuffer.writeAt(static_cast<uint32_t>(ch), wpos, self->convertOutput.data(), toWrite);
+        if (havePosition)
+          self->feedTaps(ch, deviceBlock, static_cast<uint32_t>(frames), nullptr, 0, samplePosition);
       }
-      else
+      // Every converter holds the same state, so each plane received the same frame count
+      self->ringBuffer.advanceWrite(toWrite);
+    }
+    else
+    {
+      int framesToWrite = static_cast<int>(st->preferredSize);
+      if (framesToWrite > (int)cap)
+        framesToWrite = (int)cap;
+      // A mirrored ring takes the whole block in one piece
+      const int contFrames = static_cast<int>(self->ringBuffer.contiguous(wpos));
+      const int f1 = framesToWrite < contFrames ? framesToWrite : contFrames;
+      for (long ch = 0; ch < channels; ch++)
       {
-        for (int i = 0; i < f1; i++)
-          self->ringBuffer.data()[wpos + i] = st->convertSample[0] ? st->convertSample[0](src0, i) : 0.0f;
-        wpos += f1;
-        if (wpos == self->ringBuffer.capacity())
-          wpos = 0;
-        framesToWrite -= f1;
-        if (framesToWrite > 0)
-        {
-          for (int i = 0; i < framesToWrite; i++)
-            self->ringBuffer.data()[i] = st->convertSample[0] ? st->convertSample[0](src0, f1 + i) : 0.0f;
-          wpos = framesToWrite;
-        }
+        const void *src = st->bufferInfos[ch].buffers[index];
+        float *plane = self->ringBuffer.data(static_cast<uint32_t>(ch));
+        convertInput(st, ch, src, 0, plane + wpos, f1);
+        if (framesToWrite > f1)
+          convertInput(st, ch, src, f1, plane, framesToWrite - f1);
+        if (havePosition)
+          self->feedTaps(ch, plane + blockStart, (uint32_t)f1, plane, (uint32_t)(framesToWrite - f1), samplePosition);
       }
-      // Advance writer head by total written frames
-      self->ringBuffer.advanceWrite((uint32_t)totalToWrite);
+      // Advance writer head by total written frames, once all planes hold them
+      self->ringBuffer.advanceWrite((uint32_t)framesToWrite);
     }
+
+    // Levels from the input chains, which saw every frame of the block on its way into the ring
+    self->levelMeter.beginBlock();
+    for (long ch = 0; ch < channels; ch++)
+    {
+      const AsioConverters::InputChain &chain = st->chains[ch];
+      self->levelMeter.store(static_cast<int>(ch), chain.peak, static_cast<float>(std::sqrt(chain.sumSquares / st->preferredSize)));
+    }
+    self->levelMeter.endBlock();
+
+    if (st->insertChannels > 0)
+      self->drainSendRing(index, havePosition, samplePosition);
     --st->activeCallbackCount;
   }
 
-  ASIOTime *AsioInterface::bufferSwitchTimeInfoThunk(ASIOTime *timeInfo, long index, ASIOBool processNow)
+  ASIOTime *AsioInterface::bufferSwitchTimeInfoThunk(ASIOTime *timeInfo, long index, ASIOBool /*processNow*/)
   {
-    AsioInterface::bufferSwitchThunk(index, processNow);
+    AsioInterface::processBufferSwitch(index, timeInfo);
     return timeInfo;
   }
 
@@ -280,14 +331,15 @@ namespace Newkon
       return 1;
     case kAsioEngineVersion:
       return 2;
-    case kAsioResetRequest:
-      self->handlePendingReset();
+    case kAsioSupportsTimeInfo:
+      // Ask for bufferSwitchTimeInfo so the sample position arrives with each buffer switch
       return 1;
+    case kAsioResetRequest:
     case kAsioResyncRequest:
-      self->handlePendingReset();
-      return 1;
     case kAsioLatenciesChanged:
-      self->handlePendingReset();
+      // Only flagged here: the reset thread pauses the stream and reallocates outside the driver's callback
+      self->resetPending.store(true, std::memory_order_release);
+      self->resetWake.notify_one();
       return 1;
     default:
       return 0;
@@ -296,17 +348,12 @@ namespace Newkon
 
   void AsioInterface::handlePendingReset()
   {
-    if (!state)
+    std::lock_guard<std::recursive_mutex> lock(streamMutex);
+    if (!state || !isStreaming)
       return;
 
-    // Pause producer work and wait for any in-flight callback to finish
-    state->callbacksEnabled = false;
-    for (int spins = 0; spins < 10000; ++spins)
-    {
-      if (state->activeCallbackCount == 0)
-        break;
-      _mm_pause();
-    }
+    pauseStream();
+    sampleClock.invalidate();
 
     // Re-query buffer sizes and sample rate from driver
     long minS = state->minSize, maxS = state->maxSize, prefS = state->preferredSize, gran = state->granularity;
@@ -323,30 +370,81 @@ namespace Newkon
     if (ASIOGetSampleRate(&sr) == ASE_OK)
       state->sampleRate = sr;
 
-    // Recompute ring capacity based on new timing
-    const int minFrames100ms = (state->sampleRate > 0 ? static_cast<int>(state->sampleRate * 0.1) : state->preferredSize * 8);
-    const int minFrames = (minFrames100ms > (state->preferredSize * 8) ? minFrames100ms : (state->preferredSize * 8));
-    int pow2 = 1;
-    while (pow2 < minFrames)
-      pow2 <<= 1;
-    pow2 <<= 1; // extra headroom
-
-    ringBuffer.resize(static_cast<uint32_t>(pow2));
+    // Recompute the conversion and ring capacity based on new timing
+    configureRateConversion();
+    ringBuffer.resize(ringCapacityFrames(), static_cast<uint32_t>(state->captureChannels));
+    sendRing.resize(ringCapacityFrames(), static_cast<uint32_t>(state->insertChannels > 0 ? state->insertChannels : 1));
+    readAlignmentPending.store(true, std::memory_order_release);
+    sendAlignmentPending.store(true, std::memory_order_release);
+    updateInsertActive();
     Logger::getInstance() << "ASIO reset applied: preferred=" << state->preferredSize
                           << ", sr=" << state->sampleRate
                           << ", ringCapacity=" << ringBuffer.capacity() << std::endl;
 
-    // Resume producer
+    resumeStream();
+  }
+
+  void AsioInterface::runResets()
+  {
+    std::unique_lock<std::mutex> lock(resetMutex);
+    while (resetThreadRunning.load(std::memory_order_relaxed))
+    {
+      // The callback notifies without the mutex; the timeout picks up a request flagged just before the wait
+      resetWake.wait_for(lock, std::chrono::milliseconds(50), [this]
+                         { return resetPending.load(std::memory_order_acquire) || !resetThreadRunning.load(std::memory_order_relaxed); });
+      if (!resetPending.exchange(false, std::memory_order_acq_rel))
+        continue;
+      lock.unlock();
+      handlePendingReset();
+      lock.lock();
+    }
+  }
+
+  void AsioInterface::pauseStream()
+  {
+    // Callback first, so nothing writes the capture ring or drains the send ring from here on
+    state->callbacksEnabled = false;
+    while (state->activeCallbackCount != 0)
+      std::this_thread::yield();
+    // Then the host threads: one already holding a reference finishes its read or send
+    hostPaused.store(true, std::memory_order_seq_cst);
+    while (hostUsers.load(std::memory_order_seq_cst) != 0)
+      std::this_thread::yield();
+  }
+
+  void AsioInterface::resumeStream()
+  {
+    hostPaused.store(false, std::memory_order_release);
     state->callbacksEnabled = true;
   }
 
-  AsioInterface::AsioInterface() : currentInterfaceIndex(-1), currentInputIndex(-1), isStreaming(false), ringBuffer(1)
+  bool AsioInterface::enterHost()
+  {
+    // Counted in before the check, so a pause that sees no users has none left in the rings
+    hostUsers.fetch_add(1, std::memory_order_seq_cst);
+    if (!hostPaused.load(std::memory_order_seq_cst))
+      return true;
+    hostUsers.fetch_sub(1, std::memory_order_release);
+    return false;
+  }
+
+  AsioInterface::AsioInterface() : currentInterfaceIndex(-1), currentInputIndex(-1), isStreaming(false),
+                                   ringBuffer(1, 1, RingBufferFloat::Layout::kMirrored), driftResamplers(1),
+                                   driftScratch(VariableResampler::kMaxOutputFrames, 0.0f), sendRing(1, 1, RingBufferFloat::Layout::kMirrored)
   {
     state = new AsioState();
+    resetThreadRunning.store(true, std::memory_order_relaxed);
+    resetThread = std::thread(&AsioInterface::runResets, this);
   }
 
   AsioInterface::~AsioInterface()
   {
+    {
+      std::lock_guard<std::mutex> lock(resetMutex);
+      resetThreadRunning.store(false, std::memory_order_relaxed);
+    }
+    resetWake.notify_one();
+    resetThread.join();
     shutdown();
     delete state;
     state = nullptr;
@@ -430,8 +528,7 @@ namespace Newkon
       return false;
     }
 
-    long dummyOutputs = 0;
-    ASIOError chRc = ASIOGetChannels(&state->inputChannels, &dummyOutputs);
+    ASIOError chRc = ASIOGetChannels(&state->inputChannels, &state->outputChannels);
     if (chRc != ASE_OK)
     {
       Logger::getInstance() << "ASIOGetChannels failed: " << asioErrStr(chRc) << std::endl;
@@ -456,6 +553,7 @@ namespace Newkon
 
     Logger::getInstance() << "ASIO interface connected: " << asioDevices[deviceIndex].name
                           << ", inputs=" << state->inputChannels
+                          << ", outputs=" << state->outputChannels
                           << ", preferredBuffer=" << state->preferredSize
                           << ", sampleRate=" << state->sampleRate << std::endl;
 
@@ -492,6 +590,34 @@ namespace Newkon
     return inputs;
   }
 
+  std::vector<std::string> AsioInterface::getAsioOutputs(int deviceIndex)
+  {
+    std::vector<std::string> outputs;
+
+    if (deviceIndex < 0 || deviceIndex >= static_cast<int>(asioDevices.size()))
+      return outputs;
+
+    if (currentInterfaceIndex != deviceIndex)
+    {
+      if (!connectToInterface(deviceIndex))
+        return outputs;
+    }
+
+    outputs.reserve(static_cast<size_t>(state->outputChannels));
+    for (long i = 0; i < state->outputChannels; i++)
+    {
+      ASIOChannelInfo ci = {};
+      ci.channel = i;
+      ci.isInput = ASIOFalse;
+      if (ASIOGetChannelInfo(&ci) == ASE_OK && ci.name[0] != '\0')
+        outputs.emplace_back(ci.name);
+      else
+        outputs.emplace_back("Output " + std::to_string(i + 1));
+    }
+
+    return outputs;
+  }
+
   const std::vector<AsioInterfaceInfo> &AsioInterface::getAsioDevices()
   {
     return asioDevices;
@@ -522,6 +648,7 @@ namespace Newkon
 
   bool AsioInterface::startAudioStream()
   {
+    std::lock_guard<std::recursive_mutex> lock(streamMutex);
     if (currentInterfaceIndex < 0 || currentInputIndex < 0)
     {
       return false;
@@ -533,13 +660,23 @@ namespace Newkon
       stopAudioStream();
     }
 
-    long available2 = state->inputChannels - AsioInterface::currentInputIndex;
-    if (available2 < 0)
-      available2 = 0;
-    const int channelsToUse = static_cast<int>(available2 < 2 ? available2 : 2);
+    const std::vector<long> captureInputs = resolveChannelMap();
+    const int channelsToUse = static_cast<int>(captureInputs.size());
     if (channelsToUse <= 0)
       return false;
 
+    // Insert outputs that exist on this interface, in send order; their buffers follow the captured ones
+    std::vector<long> sendOutputs;
+    for (int output : insertOutputs)
+    {
+      if (output < 0 || output >= state->outputChannels || sendOutputs.size() >= static_cast<size_t>(kMaxOutputChannels))
+        continue;
+      if (std::find(sendOutputs.begin(), sendOutputs.end(), static_cast<long>(output)) == sendOutputs.end())
+        sendOutputs.push_back(output);
+    }
+    const int insertCount = static_cast<int>(sendOutputs.size());
+    const int buffersToCreate = channelsToUse + insertCount;
+
     state->callbacks.bufferSwitch = &AsioInterface::bufferSwitchThunk;
     state->callbacks.bufferSwitchTimeInfo = &AsioInterface::bufferSwitchTimeInfoThunk;
     state->callbacks.asioMessage = &AsioInterface::asioMessageThunk;
@@ -552,18 +689,18 @@ namespace Newkon
       state->bufferInfos = nullptr;
     }
 
-    state->bufferInfos = new ASIOBufferInfo[channelsToUse];
-    for (int i = 0; i < channelsToUse; i++)
+    state->bufferInfos = new ASIOBufferInfo[buffersToCreate];
+    for (int i = 0; i < buffersToCreate; i++)
     {
-      state->bufferInfos[i].isInput = ASIOTrue;
-      state->bufferInfos[i].channelNum = state->selectedInputIndex + i;
+      state->bufferInfos[i].isInput = i < channelsToUse ? ASIOTrue : ASIOFalse;
+      state->bufferInfos[i].channelNum = i < channelsToUse ? captureInputs[i] : sendOutputs[i - channelsToUse];
       state->bufferInfos[i].buffers[0] = state->bufferInfos[i].buffers[1] = nullptr;
     }
 
     {
       // set current instance for callbacks before creating buffers
       AsioInterface::s_current = this;
-      ASIOError cr = ASIOCreateBuffers(state->bufferInfos, channelsToUse, state->preferredSize, &state->callbacks);
+      ASIOError cr = ASIOCreateBuffers(state->bufferInfos, buffersToCreate, state->preferredSize, &state->callbacks);
       if (cr != ASE_OK)
       {
         Logger::getInstance() << "ASIOCreateBuffers failed: " << asioErrStr(cr) << std::endl;
@@ -580,11 +717,11 @@ namespace Newkon
       delete[] state->channelInfos;
       state->channelInfos = nullptr;
     }
-    state->channelInfos = new ASIOChannelInfo[channelsToUse];
-    for (int i = 0; i < channelsToUse; i++)
+    state->channelInfos = new ASIOChannelInfo[buffersToCreate];
+    for (int i = 0; i < buffersToCreate; i++)
     {
-      state->channelInfos[i].channel = state->selectedInputIndex + i;
-      state->channelInfos[i].isInput = ASIOTrue;
+      state->channelInfos[i].channel = state->bufferInfos[i].channelNum;
+      state->channelInfos[i].isInput = state->bufferInfos[i].isInput;
       ASIOGetChannelInfo(&state->channelInfos[i]);
     }
 
@@ -595,68 +732,65 @@ namespace Newkon
       return false;
     }
 
-    // Precompute converters (mono path: index 0)
-    for (int i = 0; i < channelsToUse && i < 2; i++)
+    // Pick a block converter per captured channel, for the widest instruction set this machine runs
+    const CpuFeatures::Isa isa = CpuFeatures::detectIsa();
+    state->captureChannels = channelsToUse;
+    state->convertBlock.assign(channelsToUse, nullptr);
+    state->chainBlock.assign(channelsToUse, nullptr);
+    state->sampleBytes.assign(channelsToUse, 4);
+    for (int i = 0; i < channelsToUse; i++)
     {
-      switch (state->channelInfos[i].type)
+      const AsioConverters::SampleFormat format = sampleFormatFor(state->channelInfos[i].type);
+      if (format == AsioConverters::SampleFormat::kCount)
+        Logger::getInstance() << "Unsupported ASIO sample type " << state->channelInfos[i].type
+                              << " on input " << state->channelInfos[i].channel << ", capturing silence" << std::endl;
+      else
       {
-      case ASIOSTFloat32LSB:
-        state->convertSample[i] = AsioConverters::convFloat32;
-        state->kind[i] = AsioState::kKindFloat32;
-        state->scale[i] = 1.0f;
-        break;
-      case ASIOSTInt32LSB:
-        state->convertSample[i] = AsioConverters::convInt32;
-        state->kind[i] = AsioState::kKindInt32;
-        state->scale[i] = (1.0f / 2147483648.0f);
-        break;
-      case ASIOSTInt32LSB24:
-        state->convertSample[i] = AsioConverters::convInt32LSB24;
-        state->kind[i] = AsioState::kKindInt32LSB24;
-        state->scale[i] = (1.0f / 8388608.0f);
-        break;
-      case ASIOSTInt32LSB20:
-        state->convertSample[i] = AsioConverters::convInt32LSB20;
-        state->kind[i] = AsioState::kKindUnknown;
-        state->scale[i] = 1.0f;
-        break;
-      case ASIOSTInt32LSB18:
-        state->convertSample[i] = AsioConverters::convInt32LSB18;
-        state->kind[i] = AsioState::kKindUnknown;
-        state->scale[i] = 1.0f;
-        break;
-      case ASIOSTInt32LSB16:
-        state->convertSample[i] = AsioConverters::convInt32LSB16;
-        state->kind[i] = AsioState::kKindUnknown;
-        state->scale[i] = 1.0f;
-        break;
-      case ASIOSTInt24LSB:
-        state->convertSample[i] = AsioConverters::convInt24;
-        state->kind[i] = AsioState::kKindUnknown;
-        state->scale[i] = 1.0f;
-        break;
-      case ASIOSTInt16LSB:
-        state->convertSample[i] = AsioConverters::convInt16;
-        state->kind[i] = AsioState::kKindInt16;
-        state->scale[i] = (1.0f / 32768.0f);
-        break;
-      default:
-        state->convertSample[i] = nullptr;
-        state->kind[i] = AsioState::kKindUnknown;
-        state->scale[i] = 1.0f;
-        break;
+        state->convertBlock[i] = AsioConverters::select(format, isa);
+        state->chainBlock[i] = AsioConverters::selectChain(format, isa);
+        state->sampleBytes[i] = AsioConverters::bytesPerSample(format);
       }
     }
-
-    // ring buffer length: 100 ms mono or 8 blocks, whichever is larger, rounded to power of two
-    const int minFrames100ms = (state->sampleRate > 0 ? static_cast<int>(state->sampleRate * 0.1) : state->preferredSize * 8);
-    const int minFrames = (minFrames100ms > (state->preferredSize * 8) ? minFrames100ms : (state->preferredSize * 8));
-    int pow2 = 1;
-    while (pow2 < minFrames)
-      pow2 <<= 1;
-    // Double capacity for extra headroom against jitter/underruns
-    pow2 <<= 1;
-    ringBuffer.resize(static_cast<uint32_t>(pow2));
+    Logger::getInstance() << "ASIO sample conversion: " << CpuFeatures::isaName(isa) << " kernels" << std::endl;
+
+    // Input chains and meters start from rest with the current settings
+    InputStage stage;
+    if (!inputStages.take(stage))
+      stage = inputStages.load();
+    state->chains.assign(channelsToUse, AsioConverters::InputChain());
+    applyInputStage(stage);
+    levelMeter.reset(static_cast<int>(channelsToUse), state->preferredSize / state->sampleRate);
+
+    // And a writer per insert output
+    state->insertChannels = insertCount;
+    state->writeBlock.assign(insertCount, nullptr);
+    state->outputSampleBytes.assign(insertCount, 4);
+    for (int k = 0; k < insertCount; k++)
+    {
+      const ASIOChannelInfo &info = state->channelInfos[channelsToUse + k];
+      const AsioConverters::SampleFormat format = sampleFormatFor(info.type);
+      if (format == AsioConverters::SampleFormat::kCount)
+        Logger::getInstance() << "Unsupported ASIO sample type " << info.type << " on output " << info.channel
+                              << ", sending silence" << std::endl;
+      else
+      {
+        state->writeBlock[k] = AsioConverters::selectWriter(format);
+        state->outputSampleBytes[k] = AsioConverters::bytesPerSample(format);
+      }
+    }
+    // Drivers that do not support ASIOOutputReady() say so when asked after ASIOCreateBuffers
+    state->postOutput = insertCount > 0 && ASIOOutputReady() == ASE_OK;
+
+    configureRateConversion();
+    ringBuffer.resize(ringCapacityFrames(), static_cast<uint32_t>(channelsToUse));
+    sendRing.resize(ringCapacityFrames(), static_cast<uint32_t>(insertCount > 0 ? insertCount : 1));
+    sendAlignmentPending.store(true, std::memory_order_release);
+    impulseState.store(kImpulseIdle, std::memory_order_relaxed);
+    updateInsertActive();
+    while (driftResamplers.size() < static_cast<size_t>(channelsToUse))
+      driftResamplers.emplace_back();
+    driftActive = false;
+    readAlignmentPending.store(true, std::memory_order_release);
 
     state->callbacksEnabled = false;
     {
@@ -684,25 +818,26 @@ namespace Newkon
     isStreaming = true;
     Logger::getInstance() << "ASIO stream started for interface: " << asioDevices[currentInterfaceIndex].name
                           << ", input index: " << currentInputIndex
-                          << ", preferred buffer: " << state->preferredSize << std::endl;
-    state->callbacksEnabled = true;
+                          << ", channels: " << channelsToUse
+                          << ", insert outputs: " << insertCount
+                          << ", preferred buffer: " << state->preferredSize
+                          << ", ring: " << ringBuffer.capacity() << " frames" << (ringBuffer.mirrored() ? " (mirrored)" : "") << std::endl;
+    resumeStream();
     return true;
   }
 
   void AsioInterface::stopAudioStream()
   {
+    std::lock_guard<std::recursive_mutex> lock(streamMutex);
     if (!isStreaming)
       return;
-    state->callbacksEnabled = false;
+    // Any in-flight callback finishes before the buffers are freed, and the host threads stay out of
+    // the rings until the next start has resized them
+    pauseStream();
+    sampleClock.invalidate();
+    insertActive.store(false, std::memory_order_relaxed);
     Logger::getInstance() << "ASIO stream stopping" << std::endl;
     ASIOStop();
-    // Wait for any in-flight callback to finish before freeing buffers
-    for (int spins = 0; spins < 10000; ++spins)
-    {
-      if (state->activeCallbackCount == 0)
-        break;
-      _mm_pause();
-    }
     ASIODisposeBuffers();
     if (state->bufferInfos)
     {
@@ -716,6 +851,7 @@ namespace Newkon
     }
 
     isStreaming = false;
+    levelMeter.reset(0, 0.0);
     Logger::getInstance() << "ASIO stream stopped" << std::endl;
     if (AsioInterface::s_current == this)
       AsioInterface::s_current = nullptr;
@@ -748,6 +884,368 @@ namespace Newkon
     currentInputIndex = -1;
   }
 
+  double AsioInterface::getDeviceSampleRate() const
+  {
+    return (state && currentInterfaceIndex >= 0) ? state->sampleRate : 0.0;
+  }
+
+  long AsioInterface::getDeviceBufferFrames() const
+  {
+    return (state && currentInterfaceIndex >= 0) ? state->preferredSize : 0;
+  }
+
+  uint32_t AsioInterface::ringCapacityFrames() const
+  {
+    // ring buffer length: 100 ms mono or 8 blocks, whichever is larger, rounded to power of two
+    const double ringRate = getRingSampleRate();
+    const double deviceRate = state->sampleRate;
+    int blockFrames = static_cast<int>(state->preferredSize);
+    if (ringRate > 0.0 && deviceRate > 0.0)
+      blockFrames = static_cast<int>(std::ceil(state->preferredSize * ringRate / deviceRate));
+    const int minFrames100ms = (ringRate > 0 ? static_cast<int>(ringRate * 0.1) : blockFrames * 8);
+    const int minFrames = (minFrames100ms > (blockFrames * 8) ? minFrames100ms : (blockFrames * 8));
+    int pow2 = 1;
+    while (pow2 < minFrames)
+      pow2 <<= 1;
+    // Double capacity for extra headroom against jitter/underruns
+    pow2 <<= 1;
+    return static_cast<uint32_t>(pow2);
+  }
+
+  void AsioInterface::configureRateConversion()
+  {
+    const long deviceRate = std::lround(state->sampleRate);
+    const long hostRate = std::lround(hostSampleRate);
+    bool converting = false;
+    if (deviceRate > 0 && hostRate > 0 && deviceRate != hostRate && state->preferredSize > 0)
+    {
+      const long channels = state->captureChannels > 0 ? state->captureChannels : 1;
+      rateConverters.resize(static_cast<size_t>(channels));
+      converting = true;
+      for (PolyphaseResampler &converter : rateConverters)
+        converting = converting && converter.configure(static_cast<uint32_t>(deviceRate), static_cast<uint32_t>(hostRate), static_cast<uint32_t>(state->preferredSize));
+      if (converting)
+      {
+        const PolyphaseResampler &converter = rateConverters.front();
+        convertScratch.assign(static_cast<size_t>(state->preferredSize), 0.0f);
+        convertOutput.assign(converter.maxOutputFrames(static_cast<uint32_t>(state->preferredSize)), 0.0f);
+        Logger::getInstance() << "ASIO rate conversion " << deviceRate << " -> " << hostRate << " Hz ("
+                              << converter.interpolation() << "/" << converter.decimation() << ", "
+                              << converter.tapsPerPhase() << " taps per phase)" << std::endl;
+      }
+      else
+      {
+        Logger::getInstance() << "No rate conversion for " << deviceRate << " -> " << hostRate
+                              << " Hz, capturing at the device rate" << std::endl;
+      }
+    }
+
+    rateConverting = converting;
+    rateConvertingStatus.store(converting, std::memory_order_relaxed);
+    ringSampleRate.store(converting ? static_cast<double>(hostRate) : state->sampleRate, std::memory_order_relaxed);
+    rateConversionDelay.store(converting ? rateConverters.front().delayInputFrames() / deviceRate : 0.0, std::memory_order_relaxed);
+  }
+
+  void AsioInterface::setHostSampleRate(double rate)
+  {
+    std::lock_guard<std::recursive_mutex> lock(streamMutex);
+    if (rate == hostSampleRate)
+      return;
+    hostSampleRate = rate;
+    // Otherwise picked up when the stream starts
+    if (!isStreaming || !state)
+      return;
+
+    // Swap the converter with the callback and the host threads paused; the rings restart at the new rate
+    pauseStream();
+    configureRateConversion();
+    const uint32_t capacity = ringCapacityFrames();
+    if (capacity != ringBuffer.capacity())
+    {
+      ringBuffer.resize(capacity, static_cast<uint32_t>(state->captureChannels));
+      sendRing.resize(capacity, static_cast<uint32_t>(state->insertChannels > 0 ? state->insertChannels : 1));
+    }
+    readAlignmentPending.store(true, std::memory_order_release);
+    sendAlignmentPending.store(true, std::memory_order_release);
+    updateInsertActive();
+    resumeStream();
+  }
+
+  void AsioInterface::updateInsertActive()
+  {
+    if (state->insertChannels > 0 && rateConverting)
+      Logger::getInstance() << "Hardware insert needs the device at the host rate, insert outputs silent" << std::endl;
+    insertActive.store(state->insertChannels > 0 && !rateConverting, std::memory_order_relaxed);
+  }
+
+  void AsioInterface::setReadDelayFrames(uint32_t frames)
+  {
+    readDelayFrames.store(frames, std::memory_order_relaxed);
+    readAlignmentPending.store(true, std::memory_order_release);
+  }
+
+  bool AsioInterface::applyPendingReadAlignment()
+  {
+    if (!readAlignmentPending.load(std::memory_order_acquire))
+      return false;
+    readAlignmentPending.store(false, std::memory_order_relaxed);
+    const uint32_t delay = readDelayFrames.load(std::memory_order_relaxed);
+    if (delay > 0)
+      ringBuffer.alignReadBehindWrite(delay);
+    return true;
+  }
+
+  void AsioInterface::setInputStage(const InputStage &stage)
+  {
+    inputStages.store(stage);
+  }
+
+  void AsioInterface::applyInputStage(const InputStage &stage)
+  {
+    constexpr double pi = 3.14159265358979323846;
+    AsioState *st = state;
+    const double rate = st->sampleRate > 0.0 ? st->sampleRate : 44100.0;
+    const float gain = static_cast<float>(std::pow(10.0, stage.gainDb / 20.0));
+    const float pole = static_cast<float>(std::exp(-2.0 * pi * stage.dcCutoffHz / rate));
+    // With the stage off the chains only meter: unity gain, no blocker
+    const bool dcBlock = stage.enabled && stage.dcBlock;
+    for (AsioConverters::InputChain &chain : st->chains)
+    {
+      // A blocker switched on starts from rest rather than from stale state
+      if (dcBlock && !chain.dcBlock)
+        chain.dcX1 = chain.dcY1 = 0.0f;
+      chain.gain = stage.enabled ? gain : 1.0f;
+      chain.dcBlock = dcBlock;
+      chain.dcPole = pole;
+    }
+  }
+
+  void AsioInterface::setDriftControllerOptions(const DriftController::Options &options)
+  {
+    // The consumer may be mid-update: it picks the options up on its next compensated read
+    driftOptions.store(options);
+  }
+
+  AsioInterface::DriftStatus AsioInterface::getDriftStatus() const
+  {
+    DriftStatus status;
+    status.active = driftStatusActive.load(std::memory_order_relaxed);
+    status.ratio = driftStatusRatio.load(std::memory_order_relaxed);
+    status.driftPpm = driftStatusEstimate.load(std::memory_order_relaxed) * 1e6;
+    status.fillErrorFrames = driftStatusFillError.load(std::memory_order_relaxed);
+    return status;
+  }
+
+  template <typename Sample>
+  void AsioInterface::fanOutChannels(Sample *const *outputs, int numOutputs, int numSamples)
+  {
+    int sources[kMaxOutputChannels];
+    for (int o = 0; o < numOutputs; o++)
+      sources[o] = outputSource(o);
+    PlanarReadPath::fanOut(*dspKernels, ringBuffer.channels(), sources, outputs, numOutputs, numSamples);
+  }
+
+  template <typename Sample>
+  void AsioInterface::readDriftCompensated(Sample *const *outputs, int numOutputs, int numSamples, bool realigned)
+  {
+    DriftController::Options options;
+    if (driftOptions.take(options))
+      driftController.setOptions(options);
+
+    const uint32_t mask = ringBuffer.mask();
+    uint32_t available = (ringBuffer.getWritePos() - ringBuffer.getReadPos()) & mask;
+
+    // The ring fill jumps by a device buffer on every switch and would beat against the host blocks.
+    // Counting the frames captured since the last switch as already there makes it continuous.
+    // The clock counts device frames; the ring holds frames at the ring rate
+    const double deviceRate = state->sampleRate > 0.0 ? state->sampleRate : 44100.0;
+    const double rate = getRingSampleRate() > 0.0 ? getRingSampleRate() : deviceRate;
+    double sinceSwitch = 0.0;
+    double halfBuffer = 0.0;
+    AsioClock::Anchor anchor;
+    if (sampleClock.snapshot(anchor))
+    {
+      const double toRing = anchor.sampleRate > 0.0 ? rate / anchor.sampleRate : 1.0;
+      const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - anchor.time).count() * anchor.sampleRate;
+      sinceSwitch = (elapsed < 0.0 ? 0.0 : (elapsed > anchor.bufferFrames ? anchor.bufferFrames : elapsed)) * toRing;
+      halfBuffer = anchor.bufferFrames * 0.5 * toRing;
+    }
+    // Every channel's resampler sees the same frames at the same ratio, so the first one speaks for all
+    const uint32_t channels = ringBuffer.channels() < driftResamplers.size() ? ringBuffer.channels() : static_cast<uint32_t>(driftResamplers.size());
+    if (channels == 0)
+      return;
+    VariableResampler &resampler = driftResamplers[0];
+
+    // Distance from the write head to the output position, frames inside the resampler included
+    const double fill = available + sinceSwitch;
+
+    // The read delay is set at an arbitrary point of the device period: on average it sits half a
+    // buffer below the continuous fill
+    const uint32_t delay = readDelayFrames.load(std::memory_order_relaxed);
+    if (realigned || !driftActive)
+    {
+      for (uint32_t ch = 0; ch < channels; ch++)
+        driftResamplers[ch].reset();
+      driftTargetFrames = delay > 0 ? delay + halfBuffer : fill + resampler.pendingFrames();
+      driftController.reset(fill + resampler.pendingFrames());
+      driftActive = true;
+    }
+    else if (delay > 0)
+    {
+      driftTargetFrames = delay + halfBuffer;
+    }
+
+    // The ring is consumed at its own rate, nominally the host's once rate conversion is in place
+    const double ratio = driftController.update(fill + resampler.pendingFrames(), driftTargetFrames, rate, numSamples / rate);
+
+    int done = 0;
+    bool underrun = false;
+    while (done < numSamples)
+    {
+      const uint32_t chunk = static_cast<uint32_t>(numSamples - done) < VariableResampler::kMaxOutputFrames
+                                 ? static_cast<uint32_t>(numSamples - done)
+                                 : VariableResampler::kMaxOutputFrames;
+      const uint32_t needed = resampler.inputFramesNeeded(chunk, ratio);
+      const uint32_t got = needed < available ? needed : available;
+      for (uint32_t ch = 0; ch < channels; ch++)
+      {
+        // Resample each captured channel once, into the first output it feeds. Channels no output
+        // reads still advance with the others. The resamplers run in float: double outputs are
+        // widened from the scratch block.
+        Sample *target = nullptr;
+        for (int o = 0; o < numOutputs; o++)
+          if (outputSource(o) == static_cast<int>(ch))
+          {
+            target = outputs[o] + done;
+            break;
+          }
+        float *out = driftScratch.data();
+        if constexpr (std::is_same<Sample, float>::value)
+          out = target ? target : out;
+        float *dst = driftResamplers[ch].inputBuffer(needed);
+        ringBuffer.peek(ch, dst, got);
+        if (got < needed)
+          std::memset(dst + got, 0, sizeof(float) * (needed - got));
+        driftResamplers[ch].process(out, chunk, ratio);
+        if constexpr (!std::is_same<Sample, float>::value)
+          if (target)
+            dspKernels->widen(out, target, chunk);
+      }
+      ringBuffer.advanceRead(got);
+      available -= got;
+      underrun = underrun || got < needed;
+      done += static_cast<int>(chunk);
+    }
+    fanOutChannels(outputs, numOutputs, numSamples);
+
+    if (underrun)
+    {
+      TraceLogger::getInstance().trace(TraceEvent::kAudioUnderrun, numSamples, available);
+      // Start from a clean fill once the ring has data again
+      driftActive = false;
+    }
+
+    driftStatusActive.store(true, std::memory_order_relaxed);
+    driftStatusRatio.store(ratio, std::memory_order_relaxed);
+    driftStatusEstimate.store(driftController.driftEstimate(), std::memory_order_relaxed);
+    driftStatusFillError.store(driftController.smoothedFill() - driftTargetFrames, std::memory_order_relaxed);
+  }
+
+  bool AsioInterface::armCaptureTap(uint32_t frames, int output)
+  {
+    if (frames == 0 || output < 0 || output >= kMaxOutputChannels)
+      return false;
+    disarmCaptureTap();
+    tapBuffer.assign(frames, 0.0f);
+    tapOutput.store(output, std::memory_order_relaxed);
+    tapFrames.store(0, std::memory_order_relaxed);
+    tapState.store(kTapArmed, std::memory_order_release);
+    return true;
+  }
+
+  void AsioInterface::disarmCaptureTap()
+  {
+    for (;;)
+    {
+      int current = tapState.load(std::memory_order_acquire);
+      if (current == kTapIdle)
+        return;
+      // Never pull the buffer from under a callback that is copying into it
+      if (current != kTapWriting && tapState.compare_exchange_weak(current, kTapIdle, std::memory_order_acq_rel))
+        return;
+      _mm_pause();
+    }
+  }
+
+  bool AsioInterface::takeCaptureTap(std::vector<float> &samples, int64_t &firstFrame)
+  {
+    if (tapState.load(std::memory_order_acquire) != kTapFull)
+      return false;
+    samples.assign(tapBuffer.begin(), tapBuffer.end());
+    firstFrame = tapFirstFrame;
+    tapState.store(kTapIdle, std::memory_order_release);
+    return true;
+  }
+
+  void AsioInterface::feedCaptureTap(const float *first, uint32_t firstCount, const float *second, uint32_t secondCount, int64_t firstFrame)
+  {
+    int expected = kTapArmed;
+    if (!tapState.compare_exchange_strong(expected, kTapWriting, std::memory_order_acquire))
+      return;
+
+    const uint32_t frames = firstCount + secondCount;
+    uint32_t written = tapFrames.load(std::memory_order_relaxed);
+    if (written > 0 && firstFrame != tapNextFrame)
+      written = 0; // the driver skipped or repeated frames: start over so the stamp stays exact
+    if (written == 0)
+      tapFirstFrame = firstFrame;
+
+    const uint32_t room = static_cast<uint32_t>(tapBuffer.size()) - written;
+    const uint32_t count = frames < room ? frames : room;
+    const uint32_t fromFirst = count < firstCount ? count : firstCount;
+    std::memcpy(tapBuffer.data() + written, first, sizeof(float) * fromFirst);
+    if (count > fromFirst)
+      std::memcpy(tapBuffer.data() + written + fromFirst, second, sizeof(float) * (count - fromFirst));
+    written += count;
+    tapNextFrame = firstFrame + frames;
+
+    tapFrames.store(written, std::memory_order_release);
+    tapState.store(written == tapBuffer.size() ? kTapFull : kTapArmed, std::memory_order_release);
+  }
+
+  void AsioInterface::setAnalysisTap(int output, CaptureTap *tap)
+  {
+    if (output < 0 || output >= kMaxOutputChannels)
+      return;
+    analysisTaps[output].store(tap, std::memory_order_seq_cst);
+    // A callback that loaded the previous tap may still be writing to it
+    while (analysisTapUsers.load(std::memory_order_seq_cst) != 0)
+      std::this_thread::yield();
+  }
+
+  void AsioInterface::feedTaps(long plane, const float *first, uint32_t firstCount, const float *second, uint32_t secondCount, int64_t firstFrame)
+  {
+    // Arming publishes the output before the state
+    if (tapState.load(std::memory_order_acquire) == kTapArmed && outputSource(tapOutput.load(std::memory_order_relaxed)) == plane)
+      feedCaptureTap(first, firstCount, second, secondCount, firstFrame);
+
+    // Outputs sharing a plane each get the block in their own tap
+    const int outputs = mappedOutputs.load(std::memory_order_relaxed);
+    analysisTapUsers.fetch_add(1, std::memory_order_seq_cst);
+    for (int o = 0; o < outputs; o++)
+    {
+      if (outputSource(o) != plane)
+        continue;
+      if (CaptureTap *tap = analysisTaps[o].load(std::memory_order_seq_cst))
+      {
+        tap->write(firstFrame, first, firstCount);
+        if (secondCount > 0)
+          tap->write(firstFrame + firstCount, second, secondCount);
+      }
+    }
+    analysisTapUsers.fetch_sub(1, std::memory_order_release);
+  }
+
   bool AsioInterface::getAudioData(float *__restrict outputBuffer, int numSamples, int numChannels)
   {
     if (!isStreaming || currentInterfaceIndex < 0 || currentInputIndex < 0)
@@ -761,6 +1259,14 @@ namespace Newkon
     const int total = numSamples * numChannels;
     if (total <= 0)
       return false;
+    if (!enterHost())
+    {
+      // Paused for a reconfiguration
+      std::memset(outputBuffer, 0, sizeof(float) * total);
+      return false;
+    }
+
+    applyPendingReadAlignment();
 
     // read head is maintained inside ringBuffer
 
@@ -778,71 +1284,290 @@ namespace Newkon
     ringBuffer.advanceRead((uint32_t)toRead);
     if (toRead < total)
     {
-      Logger::getInstance() << "Underrun: requested " << total << ", available " << available << std::endl;
+      TraceLogger::getInstance().trace(TraceEvent::kAudioUnderrun, total, available);
       std::memset(outputBuffer + toRead, 0, sizeof(float) * (total - toRead));
     }
+    leaveHost();
 
     return true;
   }
 
   bool AsioInterface::getAudioDataStereo(float *__restrict outL, float *__restrict outR, int numSamples)
   {
-    if (!isStreaming || currentInterfaceIndex < 0 || currentInputIndex < 0 || !outL || !outR)
+    float *outputs[2] = {outL, outR};
+    return getAudioDataPlanar(outputs, 2, numSamples);
+  }
+
+  bool AsioInterface::getAudioDataPlanar(float *const *outputs, int numOutputs, int numSamples)
+  {
+    return readPlanar(outputs, numOutputs, numSamples);
+  }
+
+  bool AsioInterface::getAudioDataPlanar(double *const *outputs, int numOutputs, int numSamples)
+  {
+    return readPlanar(outputs, numOutputs, numSamples);
+  }
+
+  template <typename Sample>
+  bool AsioInterface::readPlanar(Sample *const *outputs, int numOutputs, int numSamples)
+  {
+    if (!isStreaming || currentInterfaceIndex < 0 || currentInputIndex < 0 || !outputs || numOutputs <= 0)
       return false;
 
     if (numSamples <= 0)
       return false;
+    for (int o = 0; o < numOutputs; o++)
+      if (!outputs[o])
+        return false;
+    if (numOutputs > kMaxOutputChannels)
+      numOutputs = kMaxOutputChannels;
+    if (!enterHost())
+    {
+      // Paused for a reconfiguration
+      for (int o = 0; o < numOutputs; o++)
+        std::fill(outputs[o], outputs[o] + numSamples, Sample(0));
+      return false;
+    }
 
-    // read head is maintained inside ringBuffer
+    const bool realigned = applyPendingReadAlignment();
+    if (driftCompensation.load(std::memory_order_relaxed))
+    {
+      readDriftCompensated(outputs, numOutputs, numSamples, realigned);
+      leaveHost();
+      return true;
+    }
+    if (driftActive)
+    {
+      driftActive = false;
+      driftStatusActive.store(false, std::memory_order_relaxed);
+    }
 
-    // Compute available frames (mono) and clamp reads to avoid underrun
-    const uint32_t wposNow = ringBuffer.getWritePos();
-    const uint32_t rposNow = ringBuffer.getReadPos();
-    const uint32_t mask = ringBuffer.mask();
-    uint32_t available = (wposNow - rposNow) & mask;
-    int framesToRead = numSamples < static_cast<int>(available) ? numSamples : static_cast<int>(available);
+    int sources[kMaxOutputChannels];
+    for (int o = 0; o < numOutputs; o++)
+      sources[o] = outputSource(o);
+    const uint32_t framesRead = PlanarReadPath::read(ringBuffer, *dspKernels, sources, outputs, numOutputs, numSamples);
+    if (framesRead < static_cast<uint32_t>(numSamples))
+      TraceLogger::getInstance().trace(TraceEvent::kAudioUnderrun, numSamples, framesRead);
+    leaveHost();
+
+    return true;
+  }
+
+  std::vector<long> AsioInterface::resolveChannelMap()
+  {
+    // Without an explicit map: the selected input and the next one as a stereo pair, or the selected
+    // input on both sides when it is the last one
+    std::vector<int> map = channelMap;
+    const int selected = state->selectedInputIndex;
+    if (map.empty())
+      map = {selected, selected + 1 < state->inputChannels ? selected + 1 : selected};
+
+    std::vector<long> inputs;
+    int resolved = 0;
+    for (int o = 0; o < kMaxOutputChannels; o++)
+    {
+      int source = -1;
+      if (o < static_cast<int>(map.size()) && map[o] >= 0 && map[o] < state->inputChannels)
+      {
+        const auto it = std::find(inputs.begin(), inputs.end(), static_cast<long>(map[o]));
+        if (it != inputs.end())
+          source = static_cast<int>(it - inputs.begin());
+        else if (inputs.size() < static_cast<size_t>(kMaxCaptureChannels))
+        {
+          source = static_cast<int>(inputs.size());
+          inputs.push_back(map[o]);
+        }
+      }
+      outputSources[o].store(source, std::memory_order_relaxed);
+      if (source >= 0)
+        resolved = o + 1;
+    }
+    mappedOutputs.store(resolved, std::memory_order_relaxed);
+    return inputs;
+  }
+
+  bool AsioInterface::setChannelMap(const std::vector<int> &map)
+  {
+    channelMap = map;
+    if (channelMap.size() > static_cast<size_t>(kMaxOutputChannels))
+      channelMap.resize(kMaxOutputChannels);
+    if (!isStreaming)
+      return true;
+    // The set of ASIO buffers may change: rebuild them
+    return startAudioStream();
+  }
+
+  bool AsioInterface::setInsertOutputs(const std::vector<int> &outputs)
+  {
+    insertOutputs = outputs;
+    if (insertOutputs.size() > static_cast<size_t>(kMaxOutputChannels))
+      insertOutputs.resize(kMaxOutputChannels);
+    if (!isStreaming)
+      return true;
+    // Output buffers are created with the input ones: rebuild them all
+    return startAudioStream();
+  }
+
+  void AsioInterface::sendAudioPlanar(const float *const *inputs, int numInputs, int numSamples)
+  {
+    sendPlanar(inputs, numInputs, numSamples);
+  }
 
-    // Ring is mono frames; duplicate to L/R with contiguous fast path
-    int framesLeft = framesToRead;
-    uint32_t rpos2 = ringBuffer.getReadPos();
-    int contFrames = static_cast<int>(ringBuffer.capacity() - rpos2);
-    int f1 = framesLeft < contFrames ? framesLeft : contFrames;
-    for (int i = 0; i < f1; i++)
+  void AsioInterface::sendAudioPlanar(const double *const *inputs, int numInputs, int numSamples)
+  {
+    sendPlanar(inputs, numInputs, numSamples);
+  }
+
+  template <typename Sample>
+  void AsioInterface::sendPlanar(const Sample *const *inputs, int numInputs, int numSamples)
+  {
+    if (!isStreaming || !isInsertActive() || !inputs || numInputs <= 0 || numSamples <= 0)
+      return;
+    if (!enterHost())
+      return;
+
+    // One frame short of the capacity: a full ring would read as empty
+    const uint32_t mask = sendRing.mask();
+    const uint32_t wpos = sendRing.getWritePos();
+    const uint32_t space = mask - ((wpos - sendRing.getReadPos()) & mask);
+    const uint32_t count = static_cast<uint32_t>(numSamples) < space ? static_cast<uint32_t>(numSamples) : space;
+    // As writeAt(): one span on a mirrored ring, two when a plain one wraps
+    const uint32_t start = wpos & mask;
+    const uint32_t contFrames = sendRing.contiguous(start);
+    const uint32_t f1 = count < contFrames ? count : contFrames;
+    for (uint32_t ch = 0; ch < sendRing.channels(); ch++)
     {
-      float v = ringBuffer.data()[rpos2++];
-      outL[i] = v;
-      outR[i] = v;
+      const Sample *src = inputs[static_cast<int>(ch) < numInputs ? ch : numInputs - 1];
+      float *plane = sendRing.data(ch);
+      if (!src)
+      {
+        dspKernels->fill(plane + start, 0.0f, static_cast<long>(f1));
+        if (count > f1)
+          dspKernels->fill(plane, 0.0f, static_cast<long>(count - f1));
+      }
+      else if constexpr (std::is_same<Sample, float>::value)
+        sendRing.writeAt(ch, wpos, src, count);
+      else
+      {
+        // The ring and the writers are float: narrow on the way in
+        dspKernels->narrow(src, plane + start, static_cast<long>(f1));
+        if (count > f1)
+          dspKernels->narrow(src + f1, plane, static_cast<long>(count - f1));
+      }
     }
-    framesLeft -= f1;
-    if (framesLeft > 0)
+    sendRing.advanceWrite(count);
+    leaveHost();
+    if (count < static_cast<uint32_t>(numSamples))
+      TraceLogger::getInstance().trace(TraceEvent::kSendOverrun, numSamples, count);
+  }
+
+  void AsioInterface::setSendDelayFrames(uint32_t frames)
+  {
+    sendDelayFrames.store(frames, std::memory_order_relaxed);
+    sendAlignmentPending.store(true, std::memory_order_release);
+  }
+
+  void AsioInterface::drainSendRing(long index, bool havePosition, int64_t samplePosition)
+  {
+    AsioState *st = state;
+    if (sendAlignmentPending.load(std::memory_order_acquire))
+    {
+      sendAlignmentPending.store(false, std::memory_order_relaxed);
+      sendPriming = true;
+    }
+
+    const uint32_t frames = static_cast<uint32_t>(st->preferredSize);
+    const bool active = insertActive.load(std::memory_order_relaxed);
+    const uint32_t mask = sendRing.mask();
+    uint32_t available = (sendRing.getWritePos() - sendRing.getReadPos()) & mask;
+
+    // Send silence until the host has queued the full delay, then start exactly that far behind the
+    // send head, so a restart or an underrun does not change the loop latency
+    const uint32_t delay = sendDelayFrames.load(std::memory_order_relaxed);
+    if (sendPriming && active && available >= delay)
     {
-      rpos2 = 0;
-      int base = f1;
-      for (int i = 0; i < framesLeft; i++)
+      if (delay > 0)
       {
-        float v = ringBuffer.data()[rpos2++];
-        outL[base + i] = v;
-        outR[base + i] = v;
+        sendRing.alignReadBehindWrite(delay);
+        available = (sendRing.getWritePos() - sendRing.getReadPos()) & mask;
       }
+      sendPriming = false;
+    }
+
+    // A muted insert still drains the ring, so the fill is where it was when it unmutes
+    const bool draining = active && !sendPriming;
+    const bool muted = insertMuted.load(std::memory_order_relaxed);
+    const uint32_t rpos = sendRing.getReadPos();
+    const uint32_t toRead = !draining ? 0 : (frames < available ? frames : available);
+    const uint32_t contFrames = sendRing.contiguous(rpos);
+    const uint32_t f1 = toRead < contFrames ? toRead : contFrames;
+    const uint32_t toWrite = muted ? 0 : toRead;
+
+    // The impulse needs a frame stamp: wait for a buffer switch that has one
+    const bool impulse = havePosition && impulseState.load(std::memory_order_acquire) == kImpulseArmed;
+    for (long k = 0; k < st->insertChannels; k++)
+    {
+      uint8_t *dst = static_cast<uint8_t *>(st->bufferInfos[st->captureChannels + k].buffers[index]);
+      const int bytes = st->outputSampleBytes[k];
+      const AsioConverters::BlockWriter write = st->writeBlock[k];
+      uint32_t written = 0;
+      if (write && toWrite > 0 && static_cast<uint32_t>(k) < sendRing.channels())
+      {
+        const float *plane = sendRing.data(static_cast<uint32_t>(k));
+        write(plane + rpos, dst, static_cast<long>(f1));
+        if (toWrite > f1)
+          write(plane, dst + static_cast<size_t>(f1) * bytes, static_cast<long>(toWrite - f1));
+        written = toWrite;
+      }
+      // Zero is all-zero bytes in every ASIO sample format
+      std::memset(dst + static_cast<size_t>(written) * bytes, 0, static_cast<size_t>(frames - written) * bytes);
+      if (impulse && write)
+        write(&impulseLevel, dst, 1);
+    }
+    sendRing.advanceRead(toRead);
+    if (draining && toRead < frames)
+    {
+      TraceLogger::getInstance().trace(TraceEvent::kSendUnderrun, frames, available);
+      sendPriming = true;
     }
-    ringBuffer.advanceRead((uint32_t)framesToRead);
-    if (framesToRead < numSamples)
+
+    // Stamped like the capture tap: the device frame being captured as the buffer is handed over
+    if (impulse)
     {
-      Logger::getInstance() << "Underrun: requested " << numSamples << ", available " << available << std::endl;
-      std::memset(outL + framesToRead, 0, sizeof(float) * (numSamples - framesToRead));
-      std::memset(outR + framesToRead, 0, sizeof(float) * (numSamples - framesToRead));
+      impulseFrame = samplePosition + st->preferredSize;
+      impulseState.store(kImpulseSent, std::memory_order_release);
     }
 
+    if (st->postOutput)
+      ASIOOutputReady();
+  }
+
+  bool AsioInterface::fireInsertImpulse(float level)
+  {
+    if (!isInsertActive() || impulseState.load(std::memory_order_acquire) == kImpulseArmed)
+      return false;
+    impulseLevel = level;
+    impulseState.store(kImpulseArmed, std::memory_order_release);
+    return true;
+  }
+
+  bool AsioInterface::takeInsertImpulse(int64_t &frame)
+  {
+    if (impulseState.load(std::memory_order_acquire) != kImpulseSent)
+      return false;
+    frame = impulseFrame;
+    impulseState.store(kImpulseIdle, std::memory_order_relaxed);
     return true;
   }
 
   int AsioInterface::availableFrames()
   {
-    if (!state || !state->callbacksEnabled)
+    if (!state || !state->callbacksEnabled || !enterHost())
       return 0;
     const uint32_t mask = ringBuffer.mask();
     const uint32_t wposNow = ringBuffer.getWritePos();
     const uint32_t rposNow = ringBuffer.getReadPos();
+    leaveHost();
     return (wposNow - rposNow) & mask;
   }
 
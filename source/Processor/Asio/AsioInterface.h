@@ -2,7 +2,19 @@
 
 #include <vector>
 #include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "RingBufferFloat.h"
+#include "AsioClock.h"
+#include "InputLevelMeter.h"
+#include "CaptureTap.h"
+#include "DriftController.h"
+#include "VariableResampler.h"
+#include "PolyphaseResampler.h"
+#include "DspKernels.h"
+#include "SeqlockSlot.h"
 
 // Forward declare minimal ASIO types to avoid including ASIO headers here
 struct ASIOTime;
@@ -24,7 +36,12 @@ namespace Newkon
   class AsioInterface
   {
   public:
-    // Owns a single ASIO driver connection and a mono ring buffer bridging the ASIO thread to the host thread.
+    static constexpr int kMaxCaptureChannels = 32;
+    static_assert(kMaxCaptureChannels <= InputLevelMeter::kMaxChannels, "every captured channel is metered");
+    static constexpr int kMaxOutputChannels = 32;
+
+    // Owns a single ASIO driver connection and a planar ring buffer bridging the ASIO thread to the host
+    // thread.
     AsioInterface();
     ~AsioInterface();
 
@@ -37,9 +54,55 @@ namespace Newkon
     // Return available input channel names for a given interface (connects to it if necessary).
     std::vector<std::string> getAsioInputs(int deviceIndex);
 
+    // Return available output channel names for a given interface (connects to it if necessary).
+    std::vector<std::string> getAsioOutputs(int deviceIndex);
+
     // Select the input channel index to use (first of a possible stereo pair). Does not start streaming.
     bool connectToInput(int inputIndex);
 
+    // Route ASIO inputs to output channels: map[k] is the ASIO input channel feeding output k, -1 for
+    // silence. Only the inputs named in the map are captured, each into its own ring plane; outputs past
+    // the end of the map are silent. An empty map follows connectToInput(): the selected input and the
+    // next one as a stereo pair (the selected input on both sides when it is the last one).
+    // Restarts the stream when streaming.
+    bool setChannelMap(const std::vector<int> &map);
+    const std::vector<int> &getChannelMap() const { return channelMap; }
+
+    // Hardware insert: ASIO outputs fed, in order, by the channels passed to sendAudioPlanar(), so an
+    // outboard effect can sit in the host's signal path like a plugin; its return comes back through the
+    // channel map. The outputs share the capture's driver session, so the loop runs on one clock. An
+    // empty list turns insert mode off. Restarts the stream when streaming.
+    bool setInsertOutputs(const std::vector<int> &outputs);
+    const std::vector<int> &getInsertOutputs() const { return insertOutputs; }
+
+    // True while the running stream drives insert outputs. The send ring holds host frames that go out
+    // unconverted, so rate conversion rules it out: the outputs then stay silent.
+    bool isInsertActive() const { return insertActive.load(std::memory_order_relaxed); }
+
+    // Producer side: queue `numSamples` frames of `numInputs` planar buffers for the insert outputs.
+    // Insert output k takes input k, or the last input when there are fewer (a mono source on a stereo
+    // insert). Frames that do not fit in the send ring are dropped.
+    void sendAudioPlanar(const float *const *inputs, int numInputs, int numSamples);
+    void sendAudioPlanar(const double *const *inputs, int numInputs, int numSamples);
+
+    // Keep the callback's drain head this many frames behind the send head. Applied by the callback on
+    // its next buffer switch, and again whenever the stream (re)starts.
+    void setSendDelayFrames(uint32_t frames);
+
+    // Insert loop measurement. While muted the insert outputs carry silence instead of the send ring.
+    // fireInsertImpulse() has the next buffer switch put one sample at `level` on every insert output;
+    // takeInsertImpulse() then hands out the device frame it left at, stamped like the capture tap's
+    // frames. Control thread only.
+    void setInsertMuted(bool muted) { insertMuted.store(muted, std::memory_order_relaxed); }
+    bool fireInsertImpulse(float level);
+    bool takeInsertImpulse(int64_t &frame);
+
+    // Number of ASIO inputs captured by the running stream
+    int getCaptureChannelCount() const { return static_cast<int>(ringBuffer.channels()); }
+
+    // Outputs up to and including the last one with a source in the running stream
+    int getMappedOutputCount() const { return mappedOutputs.load(std::memory_order_relaxed); }
+
     // Create ASIO buffers, bind callbacks, size the ring buffer, and start streaming.
     bool startAudioStream();
 
@@ -52,10 +115,16 @@ namespace Newkon
     // Read mono samples into an interleaved buffer (numChannels channels); zero-fills on underrun.
     bool getAudioData(float *__restrict outputBuffer, int numSamples, int numChannels);
 
-    // Read mono samples and duplicate into L/R buffers; zero-fills on underrun.
+    // Read the first two mapped outputs into L/R buffers; zero-fills on underrun.
     bool getAudioDataStereo(float *__restrict outL, float *__restrict outR, int numSamples);
 
-    // Number of readable mono frames currently buffered.
+    // Read `numSamples` frames into each of `numOutputs` planar buffers following the channel map;
+    // zero-fills on underrun and for unmapped outputs. The double overload, for hosts processing in
+    // double precision, widens straight from the capture ring.
+    bool getAudioDataPlanar(float *const *outputs, int numOutputs, int numSamples);
+    bool getAudioDataPlanar(double *const *outputs, int numOutputs, int numSamples);
+
+    // Number of readable frames currently buffered (per channel).
     int availableFrames();
 
     // True if a driver is initialized, an input is selected, and the stream is running.
@@ -64,10 +133,148 @@ namespace Newkon
     // Access the last enumerated list of ASIO devices.
     const std::vector<AsioInterfaceInfo> &getAsioDevices();
 
+    // Device sample clock, re-anchored on every buffer switch while streaming.
+    const AsioClock &getSampleClock() const { return sampleClock; }
+
+    // Driver sample rate and ASIO buffer size of the connected interface (0 when not connected).
+    double getDeviceSampleRate() const;
+    long getDeviceBufferFrames() const;
+
+    // Host sample rate. When it differs from the device rate the callback resamples each captured block
+    // to it before it enters the ring. Takes effect immediately while streaming (the ring restarts).
+    void setHostSampleRate(double rate);
+
+    // Rate of the frames held in the ring: the host rate while converting, the device rate otherwise.
+    double getRingSampleRate() const { return ringSampleRate.load(std::memory_order_relaxed); }
+    bool isRateConverting() const { return rateConvertingStatus.load(std::memory_order_relaxed); }
+
+    // Delay added by the rate converter's filter (0 when not converting).
+    double getRateConversionDelaySeconds() const { return rateConversionDelay.load(std::memory_order_relaxed); }
+
+    // Keep the host read head this many ring frames behind the ASIO write head. Applied by the
+    // consumer on its next read, and again whenever the stream (re)starts.
+    void setReadDelayFrames(uint32_t frames);
+
+    // Calibration capture tap. Once armed, the ASIO callback also copies each captured buffer of the
+    // plane feeding output channel `output` into a linear buffer of `frames` frames, stamped with the
+    // device frame of its first sample. The ring and the host read path are unaffected. Control thread only.
+    bool armCaptureTap(uint32_t frames, int output = 0);
+    void disarmCaptureTap();
+
+    // Frames captured so far; the tap starts over if the driver skips frames while it is armed.
+    uint32_t getCaptureTapFrames() const { return tapFrames.load(std::memory_order_acquire); }
+
+    // Copies out a complete capture and disarms the tap; false until `frames` frames are held.
+    bool takeCaptureTap(std::vector<float> &samples, int64_t &firstFrame);
+
+    // Clock-drift compensation on the planar/stereo reads: the ring is consumed through variable-ratio
+    // resamplers (one per captured channel) steered to hold the distance to the write head at the read
+    // delay (or, without one, at the fill found when compensation kicks in). Off by default; may be
+    // toggled while streaming.
+    void setDriftCompensation(bool enabled) { driftCompensation.store(enabled, std::memory_order_relaxed); }
+    bool getDriftCompensation() const { return driftCompensation.load(std::memory_order_relaxed); }
+    void setDriftControllerOptions(const DriftController::Options &options);
+
+    struct DriftStatus
+    {
+      bool active = false;
+      double ratio = 1.0;          // input frames consumed per output frame
+      double driftPpm = 0.0;       // device clock relative to the host's, as settled by the loop
+      double fillErrorFrames = 0.0;
+    };
+    DriftStatus getDriftStatus() const;
+
+    // Optional input stage, run inside the callback's conversion of every captured channel in the same
+    // pass over the driver buffer as the metering: trim gain and a one-pole DC blocker. Off by default;
+    // may be changed while streaming (picked up on the next buffer switch).
+    struct InputStage
+    {
+      bool enabled = false;
+      double gainDb = 0.0;
+      bool dcBlock = true;
+      double dcCutoffHz = 5.0; // -3 dB point of the blocker's high-pass
+    };
+    void setInputStage(const InputStage &stage);
+    InputStage getInputStage() const { return inputStages.load(); }
+
+    // Per-block peak and RMS of every captured channel (after the input stage, if on), measured in
+    // the same conversion pass and published once per buffer switch; safe to poll from any thread.
+    const InputLevelMeter &getInputLevelMeter() const { return levelMeter; }
+
+    // Continuous analysis tap on the plane feeding output channel `output`: every captured block of it
+    // is also written to `tap` at its device frame (null to detach). Each output has its own tap.
+    // Returns once the callback no longer uses the previous tap.
+    void setAnalysisTap(int output, CaptureTap *tap);
+
   private:
-    // Handle pending ASIO reset notifications by rebuilding buffers and restarting.
+    // Reset thread: apply a driver reset notification, re-querying the driver and resizing the rings
+    // and converters with the stream paused.
     void handlePendingReset();
 
+    // Body of the reset thread, which waits for requests flagged by the driver's message callback.
+    void runResets();
+
+    // Control thread, under streamMutex: stop the callback, then the host threads, each acknowledging
+    // that it has left the rings and converters, so they can be reallocated. resumeStream() lets both go.
+    void pauseStream();
+    void resumeStream();
+
+    // Host threads: take a reference on the rings before reading or sending. False, with no reference
+    // taken, while the stream is paused.
+    bool enterHost();
+    void leaveHost() { hostUsers.fetch_sub(1, std::memory_order_release); }
+
+    // Consumer side: move the read head behind the write head if a new read delay was requested.
+    // Returns true when the read head moved.
+    bool applyPendingReadAlignment();
+
+    // Producer side: sendAudioPlanar for float or double inputs.
+    template <typename Sample>
+    void sendPlanar(const Sample *const *inputs, int numInputs, int numSamples);
+
+    // Callback side, or with callbacks paused: configure every captured channel's input chain.
+    void applyInputStage(const InputStage &stage);
+
+    // Callback side: convert the next device buffer of the send ring into the insert outputs' driver
+    // buffers (silence when muted or short of frames), adding the armed impulse.
+    void drainSendRing(long index, bool havePosition, int64_t samplePosition);
+
+    // Consumer side: getAudioDataPlanar for float or double outputs.
+    template <typename Sample>
+    bool readPlanar(Sample *const *outputs, int numOutputs, int numSamples);
+
+    // Consumer side: planar read through the drift-compensating resamplers.
+    template <typename Sample>
+    void readDriftCompensated(Sample *const *outputs, int numOutputs, int numSamples, bool realigned);
+
+    // Consumer side: fill outputs that share a source with an earlier output, silence unmapped ones.
+    template <typename Sample>
+    void fanOutChannels(Sample *const *outputs, int numOutputs, int numSamples);
+
+    // Captured plane feeding output `o`, -1 for none
+    int outputSource(int o) const { return outputSources[o].load(std::memory_order_relaxed); }
+
+    // Control thread, stream stopped: work out which ASIO inputs to capture (returned in plane order)
+    // and which plane feeds each output.
+    std::vector<long> resolveChannelMap();
+
+    // Ring length for the current device buffer and rates: 100 ms or 8 blocks, whichever is larger,
+    // doubled and rounded to a power of two.
+    uint32_t ringCapacityFrames() const;
+
+    // Set up (or bypass) device-to-host rate conversion for the current rates and buffer size.
+    // Callbacks must be paused.
+    void configureRateConversion();
+
+    // Insert outputs carry the send ring only when the stream has some and does not convert rates.
+    // Callbacks must be paused.
+    void updateInsertActive();
+
+    // Callback side: copy a captured block of `plane`, given as up to two spans of device-rate samples
+    // stamped with the device frame of its first sample, into the taps of the outputs it feeds.
+    void feedTaps(long plane, const float *first, uint32_t firstCount, const float *second, uint32_t secondCount, int64_t firstFrame);
+    void feedCaptureTap(const float *first, uint32_t firstCount, const float *second, uint32_t secondCount, int64_t firstFrame);
+
     // Called by the ASIO driver on its audio thread when the driver flips the double-buffer.
     // index is 0/1 selecting which buffer half is ready. Forwards to the active instance.
     static void bufferSwitchThunk(long index, ASIOBool processNow);
@@ -76,6 +283,10 @@ namespace Newkon
     // Must return the same ASIOTime* it received after handling the buffer flip.
     static ASIOTime *bufferSwitchTimeInfoThunk(ASIOTime *timeInfo, long index, ASIOBool processNow);
 
+    // Shared body of both buffer switch callbacks. timeInfo is null for the plain bufferSwitch variant,
+    // in which case the sample position is queried from the driver.
+    static void processBufferSwitch(long index, ASIOTime *timeInfo);
+
     // Notification that the driver's sample rate changed while running; updates instance state.
     static void sampleRateDidChangeThunk(ASIOSampleRate sRate);
 
@@ -95,6 +306,101 @@ namespace Newkon
     bool isStreaming;
 
     RingBufferFloat ringBuffer;
+    AsioClock sampleClock;
+
+    // Latency compensation: requested distance between write and read heads
+    std::atomic<uint32_t> readDelayFrames{0};
+    std::atomic<bool> readAlignmentPending{false};
+
+    // Calibration tap. The callback owns the buffer while it holds kTapWriting; the control thread
+    // otherwise, resizing only in kTapIdle.
+    enum TapState : int
+    {
+      kTapIdle,
+      kTapArmed,
+      kTapWriting,
+      kTapFull
+    };
+    std::vector<float> tapBuffer;
+    std::atomic<int> tapState{kTapIdle};
+    std::atomic<uint32_t> tapFrames{0};
+    std::atomic<int> tapOutput{0}; // output channel whose plane is captured
+    int64_t tapFirstFrame = 0;
+    int64_t tapNextFrame = 0;
+
+    // Drift compensation; the controller and resampler belong to the consumer thread
+    std::atomic<bool> driftCompensation{false};
+    SeqlockSlot<DriftController::Options> driftOptions; // handed to the consumer thread
+    bool driftActive = false;
+    double driftTargetFrames = 0.0;
+    DriftController driftController;
+    std::vector<VariableResampler> driftResamplers; // grown at stream start, never shrunk
+    std::vector<float> driftScratch;
+    std::atomic<bool> driftStatusActive{false};
+    std::atomic<double> driftStatusRatio{1.0};
+    std::atomic<double> driftStatusEstimate{0.0};
+    std::atomic<double> driftStatusFillError{0.0};
+
+    // Device -> host rate conversion; the converter and scratch buffers belong to the callback while
+    // callbacks are enabled
+    double hostSampleRate = 0.0;
+    bool rateConverting = false;
+    std::vector<PolyphaseResampler> rateConverters; // one per captured channel
+    std::vector<float> convertScratch;
+    std::vector<float> convertOutput;
+    std::atomic<double> ringSampleRate{0.0};
+    std::atomic<bool> rateConvertingStatus{false};
+    std::atomic<double> rateConversionDelay{0.0};
+
+    // Channel routing: requested map (ASIO input per output) and its resolution for the running stream
+    std::vector<int> channelMap;
+    std::atomic<int> outputSources[kMaxOutputChannels] = {};
+    std::atomic<int> mappedOutputs{0};
+
+    // Hardware insert: the send ring is filled by the host thread and drained by the callback at the
+    // same rate, one plane per insert output
+    std::vector<int> insertOutputs;
+    RingBufferFloat sendRing;
+    std::atomic<uint32_t> sendDelayFrames{0};
+    std::atomic<bool> sendAlignmentPending{false};
+    std::atomic<bool> insertActive{false};
+    std::atomic<bool> insertMuted{false};
+    bool sendPriming = true; // callback side: waiting for the send delay to build up
+
+    // Insert loop impulse: armed by the control thread, written and stamped by the callback
+    enum ImpulseState : int
+    {
+      kImpulseIdle,
+      kImpulseArmed,
+      kImpulseSent
+    };
+    std::atomic<int> impulseState{kImpulseIdle};
+    float impulseLevel = 0.0f;
+    int64_t impulseFrame = 0;
+
+    // Input stage: requested settings, handed to the callback through a sequence lock
+    SeqlockSlot<InputStage> inputStages;
+    InputLevelMeter levelMeter;
+
+    // Float kernels for the widest instruction set this machine runs
+    const DspKernels::Table *dspKernels = &DspKernels::active();
+
+    // Analysis taps per output channel
+    std::atomic<CaptureTap *> analysisTaps[kMaxOutputChannels] = {};
+    std::atomic<int> analysisTapUsers{0};
+
+    // Host threads inside a read or a send, and whether new ones are turned away
+    std::atomic<int> hostUsers{0};
+    std::atomic<bool> hostPaused{true};
+
+    // Driver reset requests, flagged from the message callback and applied by the reset thread.
+    // streamMutex serializes starting, stopping, resets and rate changes (start may call stop).
+    std::recursive_mutex streamMutex;
+    std::atomic<bool> resetPending{false};
+    std::atomic<bool> resetThreadRunning{false};
+    std::mutex resetMutex;
+    std::condition_variable resetWake;
+    std::thread resetThread;
 
     // Internal ASIO driver state
     AsioState *state;
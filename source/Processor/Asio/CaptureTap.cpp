@@ -0,0 +1,63 @@
+#include "CaptureTap.h"
+#include <cstring>
+
+namespace Newkon
+{
+  CaptureTap::CaptureTap(uint32_t capacityPow2)
+  {
+    cap_ = 1;
+    while (cap_ < capacityPow2)
+      cap_ <<= 1;
+    mask_ = cap_ - 1;
+    data_.assign(cap_, 0.0f);
+  }
+
+  void CaptureTap::write(int64_t firstFrame, const float *samples, uint32_t count)
+  {
+    if (count == 0)
+      return;
+    if (count > cap_)
+    {
+      samples += count - cap_;
+      firstFrame += count - cap_;
+      count = cap_;
+    }
+
+    const int64_t end = end_.load(std::memory_order_relaxed);
+    if (end != firstFrame)
+      start_.store(firstFrame, std::memory_order_relaxed);
+    // Frames about to be overwritten leave the readable range before their slots change
+    const int64_t start = start_.load(std::memory_order_relaxed);
+    const int64_t oldest = firstFrame + count - cap_;
+    if (start < oldest)
+      start_.store(oldest, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    const uint32_t pos = static_cast<uint32_t>(firstFrame) & mask_;
+    const uint32_t first = (cap_ - pos) < count ? (cap_ - pos) : count;
+    std::memcpy(data_.data() + pos, samples, sizeof(float) * first);
+    if (count > first)
+      std::memcpy(data_.data(), samples + first, sizeof(float) * (count - first));
+
+    end_.store(firstFrame + count, std::memory_order_release);
+  }
+
+  bool CaptureTap::read(int64_t firstFrame, float *dst, uint32_t count) const
+  {
+    if (count == 0 || count > cap_)
+      return false;
+    const int64_t end = end_.load(std::memory_order_acquire);
+    if (end == kNoFrame || firstFrame < start_.load(std::memory_order_acquire) || firstFrame + count > end)
+      return false;
+
+    const uint32_t pos = static_cast<uint32_t>(firstFrame) & mask_;
+    const uint32_t first = (cap_ - pos) < count ? (cap_ - pos) : count;
+    std::memcpy(dst, data_.data() + pos, sizeof(float) * first);
+    if (count > first)
+      std::memcpy(dst + first, data_.data(), sizeof(float) * (count - first));
+
+    // The writer moves start_ past any frame before reusing its slot
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return firstFrame >= start_.load(std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <vector>
+
+namespace Newkon
+{
+  // Continuous copy of the captured mono stream for analysis threads, addressed by ASIO device frame.
+  // The ASIO callback writes each block at its sample position; a reader asks for any range of frames
+  // still held and learns whether it was overwritten while copying. A gap in the driver's sample
+  // positions restarts the valid range. Single writer, any number of readers; nothing blocks.
+  class CaptureTap
+  {
+  public:
+    explicit CaptureTap(uint32_t capacityPow2);
+
+    CaptureTap(const CaptureTap &) = delete;
+    CaptureTap &operator=(const CaptureTap &) = delete;
+
+    // Writer side (ASIO callback thread).
+    void write(int64_t firstFrame, const float *samples, uint32_t count);
+
+    // Reader side. Copies frames [firstFrame, firstFrame + count); false when any of them is not
+    // captured yet, lies before a gap, or was overwritten before the copy finished.
+    bool read(int64_t firstFrame, float *dst, uint32_t count) const;
+
+    // One past the last frame written, or kNoFrame before the first write.
+    int64_t endFrame() const { return end_.load(std::memory_order_acquire); }
+
+    uint32_t capacity() const { return cap_; }
+
+    static constexpr int64_t kNoFrame = INT64_MIN;
+
+  private:
+    std::vector<float> data_;
+    uint32_t cap_ = 0;
+    uint32_t mask_ = 0;
+    std::atomic<int64_t> start_{kNoFrame}; // first frame of the current contiguous run
+    std::atomic<int64_t> end_{kNoFrame};
+  };
+}
@@ -0,0 +1,81 @@
+#include "CpuFeatures.h"
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace Newkon
+{
+  namespace CpuFeatures
+  {
+    namespace
+    {
+      void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4])
+      {
+#if defined(_MSC_VER)
+        int r[4];
+        __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (int i = 0; i < 4; i++)
+          regs[i] = static_cast<unsigned>(r[i]);
+#else
+        if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3]))
+          regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#endif
+      }
+
+      uint64_t enabledStateMask()
+      {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        uint32_t lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+      }
+
+      Isa queryIsa()
+      {
+        unsigned leaf0[4], leaf1[4], leaf7[4] = {0, 0, 0, 0};
+        cpuid(0, 0, leaf0);
+        cpuid(1, 0, leaf1);
+        if (leaf0[0] >= 7)
+          cpuid(7, 0, leaf7);
+
+        // The OS must save the wider registers across context switches, not just the CPU have them
+        const bool osxsave = (leaf1[2] & (1u << 27)) != 0;
+        const uint64_t xcr0 = osxsave ? enabledStateMask() : 0;
+        const bool avxState = (xcr0 & 0x6) == 0x6;       // XMM, YMM
+        const bool avx512State = (xcr0 & 0xE6) == 0xE6;  // + opmask, ZMM upper halves, ZMM16-31
+
+        // The AVX2 translation units are also built with FMA code generation
+        const bool fma = (leaf1[2] & (1u << 12)) != 0;
+        const bool avx2 = avxState && fma && (leaf1[2] & (1u << 28)) && (leaf7[1] & (1u << 5));
+        const bool avx512 = avx2 && avx512State && (leaf7[1] & (1u << 16)) && (leaf7[1] & (1u << 30));
+        return avx512 ? Isa::kAVX512 : (avx2 ? Isa::kAVX2 : Isa::kSSE2);
+      }
+    }
+
+    Isa detectIsa()
+    {
+      static const Isa isa = queryIsa();
+      return isa;
+    }
+
+    const char *isaName(Isa isa)
+    {
+      switch (isa)
+      {
+      case Isa::kAVX512:
+        return "AVX-512";
+      case Isa::kAVX2:
+        return "AVX2";
+      default:
+        return "SSE2";
+      }
+    }
+  }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+namespace Newkon
+{
+  // Runtime instruction-set detection. The plugin itself is built for the x64 baseline; wider kernels
+  // live in translation units compiled for their own instruction set and are only reached through
+  // tables picked with detectIsa().
+  namespace CpuFeatures
+  {
+    enum class Isa : int
+    {
+      kSSE2, // x64 baseline
+      kAVX2, // AVX2 + FMA
+      kAVX512 // F + BW
+    };
+
+    // Widest instruction set usable on this machine; queried once and cached
+    Isa detectIsa();
+    const char *isaName(Isa isa);
+  }
+}
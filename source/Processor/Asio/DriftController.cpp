@@ -0,0 +1,53 @@
+#include "DriftController.h"
+#include "VariableResampler.h"
+#include <cmath>
+
+namespace Newkon
+{
+  void DriftController::setOptions(const Options &options)
+  {
+    options_ = options;
+    const double widest = VariableResampler::kMaxRatio - 1.0;
+    if (!(options_.maxCorrection >= 0.0))
+      options_.maxCorrection = 0.0;
+    else if (options_.maxCorrection > widest)
+      options_.maxCorrection = widest;
+  }
+
+  void DriftController::reset(double fill)
+  {
+    smoothedFill_ = fill;
+    integral_ = 0.0;
+    correction_ = 0.0;
+  }
+
+  double DriftController::update(double fill, double target, double sampleRate, double elapsedSeconds)
+  {
+    if (sampleRate <= 0.0 || elapsedSeconds <= 0.0)
+      return ratio();
+
+    const double smoothing = options_.smoothingSeconds > 0.0 ? 1.0 - std::exp(-elapsedSeconds / options_.smoothingSeconds) : 1.0;
+    smoothedFill_ += smoothing * (fill - smoothedFill_);
+    const double error = smoothedFill_ - target;
+
+    // The fill moves at sampleRate * (drift - correction) frames per second. Both poles at
+    // -1 / responseSeconds: kp = 2 / (rate * T), ki = 1 / (rate * T^2)
+    const double response = options_.responseSeconds > 0.0 ? options_.responseSeconds : 10.0;
+    const double kp = 2.0 / (sampleRate * response);
+    const double ki = 1.0 / (sampleRate * response * response);
+    const double limit = options_.maxCorrection;
+
+    integral_ += ki * error * elapsedSeconds;
+    if (integral_ > limit)
+      integral_ = limit;
+    else if (integral_ < -limit)
+      integral_ = -limit;
+
+    correction_ = kp * error + integral_;
+    if (correction_ > limit)
+      correction_ = limit;
+    else if (correction_ < -limit)
+      correction_ = -limit;
+    return ratio();
+  }
+}
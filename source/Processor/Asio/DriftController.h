@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Newkon
+{
+  // Holds the host read path at a target buffer fill by steering a resampling ratio.
+  // The ASIO interface and the host's audio device run on different crystals, so the ring drains or
+  // fills by a few tens of ppm. The measured fill is low-passed (it saw-tooths by one device buffer
+  // per callback) and fed to a critically damped PI loop; the integral term converges on the actual
+  // drift, the proportional term pulls the fill back to target. Audio thread only, no allocation.
+  class DriftController
+  {
+  public:
+    struct Options
+    {
+      double responseSeconds = 10.0;  // time constant of the fill loop
+      double smoothingSeconds = 0.5;  // low-pass on the measured fill
+      double maxCorrection = 0.001;   // +/- 1000 ppm, far below audible pitch change
+    };
+
+    // maxCorrection is clamped to [0, VariableResampler::kMaxRatio - 1], the widest ratio the
+    // resampler's input buffer holds.
+    void setOptions(const Options &options);
+    const Options &options() const { return options_; }
+
+    // Start over with the fill as measured now and no correction.
+    void reset(double fill);
+
+    // One step per host block. `fill`: frames between the ASIO write head and the output position;
+    // `sampleRate`: device frames per second; `elapsedSeconds`: duration of the block.
+    // Returns the ratio to resample at (input frames per output frame).
+    double update(double fill, double target, double sampleRate, double elapsedSeconds);
+
+    double ratio() const { return 1.0 + correction_; }
+    double driftEstimate() const { return integral_; } // relative clock offset the loop has settled on
+    double smoothedFill() const { return smoothedFill_; }
+
+  private:
+    Options options_;
+    double smoothedFill_ = 0.0;
+    double integral_ = 0.0;
+    double correction_ = 0.0;
+  };
+}
@@ -0,0 +1,26 @@
+#include "DspKernels.h"
+
+namespace Newkon
+{
+  namespace DspKernels
+  {
+    const Table &forIsa(CpuFeatures::Isa isa)
+    {
+      switch (isa)
+      {
+      case CpuFeatures::Isa::kAVX512:
+        return detail::avx512Kernels();
+      case CpuFeatures::Isa::kAVX2:
+        return detail::avx2Kernels();
+      default:
+        return detail::sse2Kernels();
+      }
+    }
+
+    const Table &active()
+    {
+      static const Table &table = forIsa(CpuFeatures::detectIsa());
+      return table;
+    }
+  }
+}
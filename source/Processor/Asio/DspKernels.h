@@ -0,0 +1,44 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include <cstdint>
+
+namespace Newkon
+{
+  // Float kernels on the audio path outside sample conversion: the ring copies (to or from float or
+  // double buffers), the fan-out of one captured channel to several outputs, and the resampler inner
+  // products. Like AsioConverters, each instruction set has its own translation unit and callers keep
+  // the table for the running machine.
+  namespace DspKernels
+  {
+    struct Table
+    {
+      // dst[0, count) = src[0, count); the ranges do not overlap
+      void (*copy)(const float *src, float *dst, long count);
+      void (*copy64)(const double *src, double *dst, long count);
+      // float -> double, for hosts processing in double precision
+      void (*widen)(const float *src, double *dst, long count);
+      // double -> float, for double-precision hosts feeding the float send ring
+      void (*narrow)(const double *src, float *dst, long count);
+      // dst[0, count) = value
+      void (*fill)(float *dst, float value, long count);
+      // Sum of a[i] * b[i]; n is a multiple of 8
+      float (*dot)(const float *a, const float *b, uint32_t n);
+      // Sum of (c0[i] + t * (c1[i] - c0[i])) * x[i]: a dot product against coefficients interpolated
+      // between two rows; n is a multiple of 8
+      float (*lerpDot)(const float *c0, const float *c1, float t, const float *x, uint32_t n);
+    };
+
+    const Table &forIsa(CpuFeatures::Isa isa);
+    // forIsa(CpuFeatures::detectIsa())
+    const Table &active();
+
+    namespace detail
+    {
+      // One table per instruction set, each defined in its own translation unit
+      const Table &sse2Kernels();
+      const Table &avx2Kernels();
+      const Table &avx512Kernels();
+    }
+  }
+}
@@ -0,0 +1,113 @@
+// AVX2 + FMA float kernels. Built with AVX2 code generation; only reached through forIsa() after
+// detectIsa() has confirmed the CPU and OS support it.
+
+#include "DspKernels.h"
+#include <immintrin.h>
+
+namespace Newkon
+{
+  namespace DspKernels
+  {
+    namespace detail
+    {
+      namespace
+      {
+        inline float horizontalSum(__m256 v)
+        {
+          __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+          sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+          sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+          return _mm_cvtss_f32(sum);
+        }
+
+        void copy(const float *src, float *dst, long count)
+        {
+          long i = 0;
+          for (; i + 16 <= count; i += 16)
+          {
+            _mm256_storeu_ps(dst + i, _mm256_loadu_ps(src + i));
+            _mm256_storeu_ps(dst + i + 8, _mm256_loadu_ps(src + i + 8));
+          }
+          for (; i < count; i++)
+            dst[i] = src[i];
+        }
+
+        void copy64(const double *src, double *dst, long count)
+        {
+          long i = 0;
+          for (; i + 8 <= count; i += 8)
+          {
+            _mm256_storeu_pd(dst + i, _mm256_loadu_pd(src + i));
+            _mm256_storeu_pd(dst + i + 4, _mm256_loadu_pd(src + i + 4));
+          }
+          for (; i < count; i++)
+            dst[i] = src[i];
+        }
+
+        void widen(const float *src, double *dst, long count)
+        {
+          long i = 0;
+          for (; i + 8 <= count; i += 8)
+          {
+            _mm256_storeu_pd(dst + i, _mm256_cvtps_pd(_mm_loadu_ps(src + i)));
+            _mm256_storeu_pd(dst + i + 4, _mm256_cvtps_pd(_mm_loadu_ps(src + i + 4)));
+          }
+          for (; i < count; i++)
+            dst[i] = src[i];
+        }
+
+        void narrow(const double *src, float *dst, long count)
+        {
+          long i = 0;
+          for (; i + 8 <= count; i += 8)
+          {
+            _mm_storeu_ps(dst + i, _mm256_cvtpd_ps(_mm256_loadu_pd(src + i)));
+            _mm_storeu_ps(dst + i + 4, _mm256_cvtpd_ps(_mm256_loadu_pd(src + i + 4)));
+          }
+          for (; i < count; i++)
+            dst[i] = static_cast<float>(src[i]);
+        }
+
+        void fill(float *dst, float value, long count)
+        {
+          const __m256 v = _mm256_set1_ps(value);
+          long i = 0;
+          for (; i + 16 <= count; i += 16)
+          {
+            _mm256_storeu_ps(dst + i, v);
+            _mm256_storeu_ps(dst + i + 8, v);
+          }
+          for (; i < count; i++)
+            dst[i] = value;
+        }
+
+        float dot(const float *a, const float *b, uint32_t n)
+        {
+          __m256 acc = _mm256_setzero_ps();
+          for (uint32_t i = 0; i < n; i += 8)
+            acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc);
+          return horizontalSum(acc);
+        }
+
+        float lerpDot(const float *c0, const float *c1, float t, const float *x, uint32_t n)
+        {
+          const __m256 tv = _mm256_set1_ps(t);
+          __m256 acc = _mm256_setzero_ps();
+          for (uint32_t i = 0; i < n; i += 8)
+          {
+            const __m256 a = _mm256_loadu_ps(c0 + i);
+            const __m256 coef = _mm256_fmadd_ps(tv, _mm256_sub_ps(_mm256_loadu_ps(c1 + i), a), a);
+            acc = _mm256_fmadd_ps(coef, _mm256_loadu_ps(x + i), acc);
+          }
+          return horizontalSum(acc);
+        }
+      }
+
+      const Table &avx2Kernels()
+      {
+        static const Table table = {copy, copy64, widen, narrow, fill, dot, lerpDot};
+        return table;
+      }
+    }
+  }
+}
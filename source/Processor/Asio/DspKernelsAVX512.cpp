@@ -0,0 +1,112 @@
+// AVX-512 float kernels. Built with AVX-512 code generation; only reached through forIsa() after
+// detectIsa() has confirmed the CPU and OS support it.
+
+#include "DspKernels.h"
+#include <immintrin.h>
+
+namespace Newkon
+{
+  namespace DspKernels
+  {
+    namespace detail
+    {
+      namespace
+      {
+        void copy(const float *src, float *dst, long count)
+        {
+          long i = 0;
+          for (; i + 16 <= count; i += 16)
+            _mm512_storeu_ps(dst + i, _mm512_loadu_ps(src + i));
+          // Masked tail: no scalar loop for the last partial vector
+          if (i < count)
+          {
+            const __mmask16 tail = static_cast<__mmask16>((1u << (count - i)) - 1);
+            _mm512_mask_storeu_ps(dst + i, tail, _mm512_maskz_loadu_ps(tail, src + i));
+          }
+        }
+
+        void copy64(const double *src, double *dst, long count)
+        {
+          long i = 0;
+          for (; i + 8 <= count; i += 8)
+            _mm512_storeu_pd(dst + i, _mm512_loadu_pd(src + i));
+          if (i < count)
+          {
+            const __mmask8 tail = static_cast<__mmask8>((1u << (count - i)) - 1);
+            _mm512_mask_storeu_pd(dst + i, tail, _mm512_maskz_loadu_pd(tail, src + i));
+          }
+        }
+
+        void widen(const float *src, double *dst, long count)
+        {
+          long i = 0;
+          for (; i + 8 <= count; i += 8)
+            _mm512_storeu_pd(dst + i, _mm512_cvtps_pd(_mm256_loadu_ps(src + i)));
+          if (i < count)
+          {
+            // F + BW has no 256-bit masked load; a masked 512-bit load touches the same elements
+            const __mmask8 tail = static_cast<__mmask8>((1u << (count - i)) - 1);
+            const __m256 v = _mm512_castps512_ps256(_mm512_maskz_loadu_ps(tail, src + i));
+            _mm512_mask_storeu_pd(dst + i, tail, _mm512_cvtps_pd(v));
+          }
+        }
+
+        void narrow(const double *src, float *dst, long count)
+        {
+          long i = 0;
+          for (; i + 8 <= count; i += 8)
+            _mm256_storeu_ps(dst + i, _mm512_cvtpd_ps(_mm512_loadu_pd(src + i)));
+          if (i < count)
+          {
+            // Masked load and store, as in copy64: no scalar loop for the last partial vector
+            const __mmask8 tail = static_cast<__mmask8>((1u << (count - i)) - 1);
+            const __m256 v = _mm512_cvtpd_ps(_mm512_maskz_loadu_pd(tail, src + i));
+            _mm512_mask_storeu_ps(dst + i, static_cast<__mmask16>(tail), _mm512_castps256_ps512(v));
+          }
+        }
+
+        void fill(float *dst, float value, long count)
+        {
+          const __m512 v = _mm512_set1_ps(value);
+          long i = 0;
+          for (; i + 16 <= count; i += 16)
+            _mm512_storeu_ps(dst + i, v);
+          if (i < count)
+            _mm512_mask_storeu_ps(dst + i, static_cast<__mmask16>((1u << (count - i)) - 1), v);
+        }
+
+        float dot(const float *a, const float *b, uint32_t n)
+        {
+          __m512 acc = _mm512_setzero_ps();
+          for (uint32_t i = 0; i < n; i += 16)
+          {
+            // The last step is half width when n is an odd multiple of 8; masked-off lanes load zero
+            const __mmask16 lanes = i + 16 <= n ? static_cast<__mmask16>(0xFFFF) : static_cast<__mmask16>(0xFF);
+            acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(lanes, a + i), _mm512_maskz_loadu_ps(lanes, b + i), acc);
+          }
+          return _mm512_reduce_add_ps(acc);
+        }
+
+        float lerpDot(const float *c0, const float *c1, float t, const float *x, uint32_t n)
+        {
+          const __m512 tv = _mm512_set1_ps(t);
+          __m512 acc = _mm512_setzero_ps();
+          for (uint32_t i = 0; i < n; i += 16)
+          {
+            const __mmask16 lanes = i + 16 <= n ? static_cast<__mmask16>(0xFFFF) : static_cast<__mmask16>(0xFF);
+            const __m512 a = _mm512_maskz_loadu_ps(lanes, c0 + i);
+            const __m512 coef = _mm512_fmadd_ps(tv, _mm512_sub_ps(_mm512_maskz_loadu_ps(lanes, c1 + i), a), a);
+            acc = _mm512_fmadd_ps(coef, _mm512_maskz_loadu_ps(lanes, x + i), acc);
+          }
+          return _mm512_reduce_add_ps(acc);
+        }
+      }
+
+      const Table &avx512Kernels()
+      {
+        static const Table table = {copy, copy64, widen, narrow, fill, dot, lerpDot};
+        return table;
+      }
+    }
+  }
+}
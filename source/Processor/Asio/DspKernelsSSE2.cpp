@@ -0,0 +1,117 @@
+// SSE2 float kernels: the x64 baseline, used when the CPU or OS lacks AVX2.
+
+#include "DspKernels.h"
+#include <emmintrin.h>
+
+namespace Newkon
+{
+  namespace DspKernels
+  {
+    namespace detail
+    {
+      namespace
+      {
+        inline float horizontalSum(__m128 v)
+        {
+          v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+          v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+          return _mm_cvtss_f32(v);
+        }
+
+        void copy(const float *src, float *dst, long count)
+        {
+          long i = 0;
+          for (; i + 8 <= count; i += 8)
+          {
+            _mm_storeu_ps(dst + i, _mm_loadu_ps(src + i));
+            _mm_storeu_ps(dst + i + 4, _mm_loadu_ps(src + i + 4));
+          }
+          for (; i < count; i++)
+            dst[i] = src[i];
+        }
+
+        void copy64(const double *src, double *dst, long count)
+        {
+          long i = 0;
+          for (; i + 4 <= count; i += 4)
+          {
+            _mm_storeu_pd(dst + i, _mm_loadu_pd(src + i));
+            _mm_storeu_pd(dst + i + 2, _mm_loadu_pd(src + i + 2));
+          }
+          for (; i < count; i++)
+            dst[i] = src[i];
+        }
+
+        void widen(const float *src, double *dst, long count)
+        {
+          long i = 0;
+          for (; i + 4 <= count; i += 4)
+          {
+            const __m128 v = _mm_loadu_ps(src + i);
+            _mm_storeu_pd(dst + i, _mm_cvtps_pd(v));
+            _mm_storeu_pd(dst + i + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+          }
+          for (; i < count; i++)
+            dst[i] = src[i];
+        }
+
+        void narrow(const double *src, float *dst, long count)
+        {
+          long i = 0;
+          for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(dst + i, _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(src + i)), _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2))));
+          for (; i < count; i++)
+            dst[i] = static_cast<float>(src[i]);
+        }
+
+        void fill(float *dst, float value, long count)
+        {
+          const __m128 v = _mm_set1_ps(value);
+          long i = 0;
+          for (; i + 8 <= count; i += 8)
+          {
+            _mm_storeu_ps(dst + i, v);
+            _mm_storeu_ps(dst + i + 4, v);
+          }
+          for (; i < count; i++)
+            dst[i] = value;
+        }
+
+        float dot(const float *a, const float *b, uint32_t n)
+        {
+          __m128 acc0 = _mm_setzero_ps();
+          __m128 acc1 = _mm_setzero_ps();
+          for (uint32_t i = 0; i < n; i += 8)
+          {
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+          }
+          return horizontalSum(_mm_add_ps(acc0, acc1));
+        }
+
+        float lerpDot(const float *c0, const float *c1, float t, const float *x, uint32_t n)
+        {
+          const __m128 tv = _mm_set1_ps(t);
+          __m128 acc0 = _mm_setzero_ps();
+          __m128 acc1 = _mm_setzero_ps();
+          for (uint32_t i = 0; i < n; i += 8)
+          {
+            const __m128 a0 = _mm_loadu_ps(c0 + i);
+            const __m128 a1 = _mm_loadu_ps(c0 + i + 4);
+            const __m128 k0 = _mm_add_ps(a0, _mm_mul_ps(tv, _mm_sub_ps(_mm_loadu_ps(c1 + i), a0)));
+            const __m128 k1 = _mm_add_ps(a1, _mm_mul_ps(tv, _mm_sub_ps(_mm_loadu_ps(c1 + i + 4), a1)));
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(k0, _mm_loadu_ps(x + i)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(k1, _mm_loadu_ps(x + i + 4)));
+          }
+          return horizontalSum(_mm_add_ps(acc0, acc1));
+        }
+      }
+
+      const Table &sse2Kernels()
+      {
+        static const Table table = {copy, copy64, widen, narrow, fill, dot, lerpDot};
+        return table;
+      }
+    }
+  }
+}
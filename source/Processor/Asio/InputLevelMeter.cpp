@@ -0,0 +1,73 @@
+#include "InputLevelMeter.h"
+#include <cmath>
+
+namespace Newkon
+{
+  void InputLevelMeter::reset(int channels, double blockSeconds, double holdFallDbPerSecond)
+  {
+    if (channels < 0)
+      channels = 0;
+    if (channels > kMaxChannels)
+      channels = kMaxChannels;
+    holdDecay_ = static_cast<float>(std::pow(10.0, -holdFallDbPerSecond * blockSeconds / 20.0));
+    for (float &h : hold_)
+      h = 0.0f;
+
+    beginBlock();
+    channels_.store(channels, std::memory_order_relaxed);
+    blocks_.store(0, std::memory_order_relaxed);
+    for (int ch = 0; ch < kMaxChannels; ch++)
+    {
+      peak_[ch].store(0.0f, std::memory_order_relaxed);
+      rms_[ch].store(0.0f, std::memory_order_relaxed);
+      peakHold_[ch].store(0.0f, std::memory_order_relaxed);
+    }
+    // Not counted as a block
+    sequence_.store(writeSequence_ += 1, std::memory_order_release);
+  }
+
+  void InputLevelMeter::beginBlock()
+  {
+    sequence_.store(writeSequence_ += 1, std::memory_order_relaxed); // odd: update in progress
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void InputLevelMeter::store(int channel, float peak, float rms)
+  {
+    if (channel < 0 || channel >= kMaxChannels)
+      return;
+    const float decayed = hold_[channel] * holdDecay_;
+    hold_[channel] = peak > decayed ? peak : decayed;
+    peak_[channel].store(peak, std::memory_order_relaxed);
+    rms_[channel].store(rms, std::memory_order_relaxed);
+    peakHold_[channel].store(hold_[channel], std::memory_order_relaxed);
+  }
+
+  void InputLevelMeter::endBlock()
+  {
+    blocks_.store(blocks_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sequence_.store(writeSequence_ += 1, std::memory_order_release);
+  }
+
+  bool InputLevelMeter::snapshot(Snapshot &levels) const
+  {
+    for (;;)
+    {
+      const uint32_t before = sequence_.load(std::memory_order_acquire);
+      if (before & 1u)
+        continue; // writer in progress, its critical section is a few stores per channel
+      const int channels = channels_.load(std::memory_order_relaxed);
+      levels.channels = channels;
+      levels.blocks = blocks_.load(std::memory_order_relaxed);
+      for (int ch = 0; ch < channels; ch++)
+      {
+        levels.peak[ch] = peak_[ch].load(std::memory_order_relaxed);
+        levels.rms[ch] = rms_[ch].load(std::memory_order_relaxed);
+        levels.peakHold[ch] = peakHold_[ch].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == before)
+        return channels > 0;
+    }
+  }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+
+namespace Newkon
+{
+  // Per-channel input levels of the capture stream, for the UI.
+  // The ASIO callback publishes one set per buffer switch; any other thread polls the latest set.
+  // Publishing is wait-free, reading retries only while a publish is in progress (sequence lock with a
+  // single writer), so a slow or stalled reader never holds up the callback.
+  class InputLevelMeter
+  {
+  public:
+    static constexpr int kMaxChannels = 32;
+
+    // Linear full-scale levels, one entry per captured channel (ring plane)
+    struct Snapshot
+    {
+      int channels = 0;
+      uint64_t blocks = 0; // buffer switches published since the last reset
+      float peak[kMaxChannels] = {};
+      float rms[kMaxChannels] = {};
+      // Peak falling at a fixed rate, so a reader polling far slower than the callback still sees
+      // every transient
+      float peakHold[kMaxChannels] = {};
+    };
+
+    InputLevelMeter() = default;
+
+    // With callbacks stopped: clears the levels for a stream of `channels` channels whose buffer
+    // switches are `blockSeconds` apart (0 channels: no stream).
+    void reset(int channels, double blockSeconds, double holdFallDbPerSecond = 20.0);
+
+    // Writer side (ASIO callback thread): one beginBlock(), a store() per channel, one endBlock().
+    void beginBlock();
+    void store(int channel, float peak, float rms);
+    void endBlock();
+
+    // Reader side. Returns false while no stream is metered.
+    bool snapshot(Snapshot &levels) const;
+
+  private:
+    std::atomic<uint32_t> sequence_{0};
+    std::atomic<int> channels_{0};
+    std::atomic<uint64_t> blocks_{0};
+    std::atomic<float> peak_[kMaxChannels] = {};
+    std::atomic<float> rms_[kMaxChannels] = {};
+    std::atomic<float> peakHold_[kMaxChannels] = {};
+
+    // Writer only
+    uint32_t writeSequence_ = 0;
+    float holdDecay_ = 0.0f; // per block
+    float hold_[kMaxChannels] = {};
+  };
+}
@@ -0,0 +1,187 @@
+#include "MirroredMemory.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Newkon
+{
+#if defined(_WIN32)
+  namespace
+  {
+#ifndef MEM_RESERVE_PLACEHOLDER
+#define MEM_RESERVE_PLACEHOLDER 0x00040000
+#endif
+#ifndef MEM_REPLACE_PLACEHOLDER
+#define MEM_REPLACE_PLACEHOLDER 0x00004000
+#endif
+#ifndef MEM_PRESERVE_PLACEHOLDER
+#define MEM_PRESERVE_PLACEHOLDER 0x00000002
+#endif
+
+    // Declared without MEM_EXTENDED_PARAMETER, which older SDKs lack; no extended parameters are passed
+    typedef PVOID(WINAPI *VirtualAlloc2Fn)(HANDLE, PVOID, SIZE_T, ULONG, ULONG, void *, ULONG);
+    typedef PVOID(WINAPI *MapViewOfFile3Fn)(HANDLE, HANDLE, PVOID, ULONG64, SIZE_T, ULONG, ULONG, void *, ULONG);
+
+    struct PlaceholderApi
+    {
+      VirtualAlloc2Fn virtualAlloc2 = nullptr;
+      MapViewOfFile3Fn mapViewOfFile3 = nullptr;
+
+      PlaceholderApi()
+      {
+        if (HMODULE kernelBase = GetModuleHandleW(L"kernelbase.dll"))
+        {
+          virtualAlloc2 = reinterpret_cast<VirtualAlloc2Fn>(GetProcAddress(kernelBase, "VirtualAlloc2"));
+          mapViewOfFile3 = reinterpret_cast<MapViewOfFile3Fn>(GetProcAddress(kernelBase, "MapViewOfFile3"));
+        }
+      }
+    };
+
+    const PlaceholderApi &placeholderApi()
+    {
+      static const PlaceholderApi api;
+      return api;
+    }
+  }
+#endif
+
+  MirroredMemory::~MirroredMemory()
+  {
+    release();
+  }
+
+  size_t MirroredMemory::granularity()
+  {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#elif defined(__linux__)
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+  }
+
+  bool MirroredMemory::allocate(size_t planeBytes, uint32_t planes)
+  {
+    release();
+    const size_t grain = granularity();
+    if (grain == 0 || planeBytes == 0 || planes == 0 || planeBytes % grain != 0)
+      return false;
+    const size_t views = 2 * static_cast<size_t>(planes);
+    const size_t total = views * planeBytes;
+
+#if defined(_WIN32)
+    const PlaceholderApi &api = placeholderApi();
+    if (!api.virtualAlloc2 || !api.mapViewOfFile3)
+      return false;
+
+    const unsigned long long sectionBytes = static_cast<unsigned long long>(planeBytes) * planes;
+    HANDLE section = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(sectionBytes >> 32),
+                                        static_cast<DWORD>(sectionBytes & 0xFFFFFFFFu), nullptr);
+    if (!section)
+      return false;
+    uint8_t *base = static_cast<uint8_t *>(api.virtualAlloc2(nullptr, nullptr, total, MEM_RESERVE | MEM_RESERVE_PLACEHOLDER, PAGE_NOACCESS, nullptr, 0));
+    if (!base)
+    {
+      CloseHandle(section);
+      return false;
+    }
+
+    // One placeholder per view, each then replaced by a view of its plane's part of the section
+    for (size_t v = 0; v + 1 < views; v++)
+      VirtualFree(base + v * planeBytes, planeBytes, MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER);
+    size_t mapped = 0;
+    for (; mapped < views; mapped++)
+    {
+      const ULONG64 offset = static_cast<ULONG64>(mapped / 2) * planeBytes;
+      if (!api.mapViewOfFile3(section, GetCurrentProcess(), base + mapped * planeBytes, offset, planeBytes, MEM_REPLACE_PLACEHOLDER,
+                              PAGE_READWRITE, nullptr, 0))
+        break;
+    }
+    // The views keep the section alive
+    CloseHandle(section);
+    if (mapped < views)
+    {
+      for (size_t v = 0; v < views; v++)
+      {
+        if (v < mapped)
+          UnmapViewOfFile(base + v * planeBytes);
+        else
+          VirtualFree(base + v * planeBytes, 0, MEM_RELEASE);
+      }
+      return false;
+    }
+#elif defined(__linux__)
+    const int fd = memfd_create("RingBufferFloat", MFD_CLOEXEC);
+    if (fd < 0)
+      return false;
+    if (ftruncate(fd, static_cast<off_t>(planeBytes * planes)) != 0)
+    {
+      close(fd);
+      return false;
+    }
+    void *reserved = mmap(nullptr, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED)
+    {
+      close(fd);
+      return false;
+    }
+    uint8_t *base = static_cast<uint8_t *>(reserved);
+    bool ok = true;
+    for (size_t v = 0; v < views && ok; v++)
+      ok = mmap(base + v * planeBytes, planeBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+                static_cast<off_t>((v / 2) * planeBytes)) != MAP_FAILED;
+    // The mappings keep the file alive
+    close(fd);
+    if (!ok)
+    {
+      munmap(base, total);
+      return false;
+    }
+#else
+    (void)total;
+    return false;
+#endif
+
+#if defined(_WIN32) || defined(__linux__)
+    base_ = base;
+    planeBytes_ = planeBytes;
+    planes_ = planes;
+    return true;
+#endif
+  }
+
+  void MirroredMemory::swap(MirroredMemory &other)
+  {
+    uint8_t *base = base_;
+    base_ = other.base_;
+    other.base_ = base;
+    const size_t planeBytes = planeBytes_;
+    planeBytes_ = other.planeBytes_;
+    other.planeBytes_ = planeBytes;
+    const uint32_t planes = planes_;
+    planes_ = other.planes_;
+    other.planes_ = planes;
+  }
+
+  void MirroredMemory::release()
+  {
+    if (!base_)
+      return;
+#if defined(_WIN32)
+    for (size_t v = 0; v < 2 * static_cast<size_t>(planes_); v++)
+      UnmapViewOfFile(base_ + v * planeBytes_);
+#elif defined(__linux__)
+    munmap(base_, 2 * static_cast<size_t>(planes_) * planeBytes_);
+#endif
+    base_ = nullptr;
+    planeBytes_ = 0;
+    planes_ = 0;
+  }
+}
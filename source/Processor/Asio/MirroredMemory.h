@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Newkon
+{
+  // Address space in which each of `planes` blocks of `planeBytes` is mapped twice, back to back: a span
+  // of up to planeBytes starting anywhere in a block's first copy is contiguous, and writes through
+  // either copy land in the same memory.
+  // Linux: one memfd mapped into a reserved range. Windows 10 1803+: a pagefile-backed section mapped
+  // over placeholders (VirtualAlloc2 / MapViewOfFile3, looked up at run time so older systems simply
+  // get no mirror). Elsewhere allocate() fails and callers keep a plain buffer.
+  class MirroredMemory
+  {
+  public:
+    MirroredMemory() = default;
+    ~MirroredMemory();
+    MirroredMemory(const MirroredMemory &) = delete;
+    MirroredMemory &operator=(const MirroredMemory &) = delete;
+
+    // planeBytes must be a multiple of this (the page size, or the allocation granularity on Windows)
+    static size_t granularity();
+
+    // Releases any previous mapping first. Returns false, with nothing mapped, when the platform or
+    // the size does not allow it. The memory starts zeroed.
+    bool allocate(size_t planeBytes, uint32_t planes);
+    void release();
+
+    void swap(MirroredMemory &other);
+
+    bool valid() const { return base_ != nullptr; }
+    uint8_t *plane(uint32_t index) const { return base_ + 2 * static_cast<size_t>(index) * planeBytes_; }
+
+  private:
+    uint8_t *base_ = nullptr;
+    size_t planeBytes_ = 0;
+    uint32_t planes_ = 0;
+  };
+}
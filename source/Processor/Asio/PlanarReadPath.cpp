@@ -0,0 +1,80 @@
+#include "PlanarReadPath.h"
+#include <cstring>
+
+namespace Newkon
+{
+  namespace PlanarReadPath
+  {
+    namespace
+    {
+      inline void copy(const DspKernels::Table &kernels, const float *src, float *dst, long count) { kernels.copy(src, dst, count); }
+      inline void copy(const DspKernels::Table &kernels, const double *src, double *dst, long count) { kernels.copy64(src, dst, count); }
+
+      template <typename Sample>
+      void fanOutPlanes(const DspKernels::Table &kernels, uint32_t planes, const int *sources, Sample *const *outputs, int numOutputs, int numSamples)
+      {
+        for (int o = 0; o < numOutputs; o++)
+        {
+          const int source = sources[o];
+          if (source < 0 || static_cast<uint32_t>(source) >= planes)
+            std::memset(outputs[o], 0, sizeof(Sample) * numSamples);
+          else
+          {
+            const int first = firstOutputFor(sources, o);
+            if (first != o)
+              copy(kernels, outputs[first], outputs[o], numSamples);
+          }
+        }
+      }
+
+      template <typename Sample>
+      uint32_t readPlanes(RingBufferFloat &ring, const DspKernels::Table &kernels, const int *sources, Sample *const *outputs, int numOutputs, int numSamples)
+      {
+        const uint32_t available = (ring.getWritePos() - ring.getReadPos()) & ring.mask();
+        const uint32_t framesToRead = static_cast<uint32_t>(numSamples) < available ? static_cast<uint32_t>(numSamples) : available;
+
+        // Each plane goes to the first output it feeds; the head moves once all of them are out
+        for (int o = 0; o < numOutputs; o++)
+        {
+          const int source = sources[o];
+          if (source < 0 || static_cast<uint32_t>(source) >= ring.channels() || firstOutputFor(sources, o) != o)
+            continue;
+          ring.peek(static_cast<uint32_t>(source), outputs[o], framesToRead);
+          if (framesToRead < static_cast<uint32_t>(numSamples))
+            std::memset(outputs[o] + framesToRead, 0, sizeof(Sample) * (numSamples - framesToRead));
+        }
+        ring.advanceRead(framesToRead);
+        fanOutPlanes(kernels, ring.channels(), sources, outputs, numOutputs, numSamples);
+        return framesToRead;
+      }
+    }
+
+    int firstOutputFor(const int *sources, int o)
+    {
+      for (int p = 0; p < o; p++)
+        if (sources[p] == sources[o])
+          return p;
+      return o;
+    }
+
+    void fanOut(const DspKernels::Table &kernels, uint32_t planes, const int *sources, float *const *outputs, int numOutputs, int numSamples)
+    {
+      fanOutPlanes(kernels, planes, sources, outputs, numOutputs, numSamples);
+    }
+
+    void fanOut(const DspKernels::Table &kernels, uint32_t planes, const int *sources, double *const *outputs, int numOutputs, int numSamples)
+    {
+      fanOutPlanes(kernels, planes, sources, outputs, numOutputs, numSamples);
+    }
+
+    uint32_t read(RingBufferFloat &ring, const DspKernels::Table &kernels, const int *sources, float *const *outputs, int numOutputs, int numSamples)
+    {
+      return readPlanes(ring, kernels, sources, outputs, numOutputs, numSamples);
+    }
+
+    uint32_t read(RingBufferFloat &ring, const DspKernels::Table &kernels, const int *sources, double *const *outputs, int numOutputs, int numSamples)
+    {
+      return readPlanes(ring, kernels, sources, outputs, numOutputs, numSamples);
+    }
+  }
+}
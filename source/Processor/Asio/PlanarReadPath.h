@@ -0,0 +1,26 @@
+#pragma once
+
+#include "RingBufferFloat.h"
+#include "DspKernels.h"
+
+namespace Newkon
+{
+  // Consumer side of the planar capture ring, without the ASIO driver around it: each output names the
+  // plane it plays (-1 for silence). A plane feeding several outputs (a mono unit on both sides of a
+  // bus) is read from the ring once and copied to the others. Outputs are float, or double for hosts
+  // processing in double precision, which are filled straight from the float planes.
+  namespace PlanarReadPath
+  {
+    // Lowest output up to `o` fed from the same plane as `o`: the one the others copy
+    int firstOutputFor(const int *sources, int o);
+
+    // Fill outputs that share a plane with an earlier output, silence unmapped ones
+    void fanOut(const DspKernels::Table &kernels, uint32_t planes, const int *sources, float *const *outputs, int numOutputs, int numSamples);
+    void fanOut(const DspKernels::Table &kernels, uint32_t planes, const int *sources, double *const *outputs, int numOutputs, int numSamples);
+
+    // Read up to numSamples frames from the read head into every output, zero-filling what the ring does
+    // not hold, and move the head past them. Returns the frames taken from the ring.
+    uint32_t read(RingBufferFloat &ring, const DspKernels::Table &kernels, const int *sources, float *const *outputs, int numOutputs, int numSamples);
+    uint32_t read(RingBufferFloat &ring, const DspKernels::Table &kernels, const int *sources, double *const *outputs, int numOutputs, int numSamples);
+  }
+}
@@ -0,0 +1,164 @@
+#include "PolyphaseResampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <numeric>
+
+namespace Newkon
+{
+  namespace
+  {
+    constexpr uint32_t kBaseTaps = 64;           // taps per phase when not decimating
+    constexpr uint32_t kMaxInterpolation = 2048; // larger L means rates with no small common ratio
+    constexpr double kCutoff = 0.96;             // centre of the transition band, of the lower Nyquist
+    constexpr double kKaiserBeta = 8.0;
+
+    double besselI0(double x)
+    {
+      double sum = 1.0, term = 1.0;
+      for (int k = 1; k < 32; k++)
+      {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+      }
+      return sum;
+    }
+  }
+
+  void PolyphaseResampler::setKernel(CpuFeatures::Isa isa)
+  {
+    isa_ = isa;
+    kernels_ = &DspKernels::forIsa(isa);
+  }
+
+  std::shared_ptr<const PolyphaseResampler::Bank> PolyphaseResampler::bankFor(uint32_t interpolation, uint32_t decimation)
+  {
+    // Designed once per rate pair for the whole process: stream restarts and other instances reuse it
+    static std::mutex mutex;
+    static std::map<std::pair<uint32_t, uint32_t>, std::shared_ptr<const Bank>> banks;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &bank = banks[{interpolation, decimation}];
+    if (!bank)
+      bank = design(interpolation, decimation);
+    return bank;
+  }
+
+  std::shared_ptr<const PolyphaseResampler::Bank> PolyphaseResampler::design(uint32_t interpolation, uint32_t decimation)
+  {
+    constexpr double pi = 3.14159265358979323846;
+    auto bank = std::make_shared<Bank>();
+    bank->interpolation = interpolation;
+    bank->decimation = decimation;
+
+    // Decimating narrows the cutoff relative to the input; more taps keep the transition as steep
+    const double widen = std::max(1.0, static_cast<double>(decimation) / interpolation);
+    bank->taps = (static_cast<uint32_t>(std::ceil(kBaseTaps * widen)) + 7) & ~7u;
+
+    const uint32_t length = bank->taps * interpolation;
+    const double centre = (length - 1) * 0.5;
+    // Cutoff in cycles per upsampled frame: half the lower of the two rates
+    const double cutoff = 0.5 * kCutoff / std::max(interpolation, decimation);
+    const double norm = besselI0(kKaiserBeta);
+
+    std::vector<double> prototype(length);
+    for (uint32_t i = 0; i < length; i++)
+    {
+      const double d = i - centre;
+      const double x = 2.0 * pi * cutoff * d;
+      const double sinc = std::fabs(x) < 1e-12 ? 1.0 : std::sin(x) / x;
+      const double w = d / (centre + 1.0);
+      prototype[i] = 2.0 * cutoff * sinc * besselI0(kKaiserBeta * std::sqrt(std::max(0.0, 1.0 - w * w))) / norm;
+    }
+
+    // Phase p, tap j multiplies input frame base - (K - 1 - j); unity DC gain per phase
+    bank->coefficients.resize(static_cast<size_t>(length));
+    for (uint32_t p = 0; p < interpolation; p++)
+    {
+      float *row = &bank->coefficients[static_cast<size_t>(p) * bank->taps];
+      double sum = 0.0;
+      for (uint32_t k = 0; k < bank->taps; k++)
+        sum += prototype[p + k * interpolation];
+      for (uint32_t k = 0; k < bank->taps; k++)
+        row[bank->taps - 1 - k] = static_cast<float>(prototype[p + k * interpolation] / sum);
+    }
+    return bank;
+  }
+
+  bool PolyphaseResampler::configure(uint32_t inputRate, uint32_t outputRate, uint32_t maxInputFrames)
+  {
+    if (inputRate == 0 || outputRate == 0 || maxInputFrames == 0)
+      return false;
+    const uint32_t g = std::gcd(inputRate, outputRate);
+    const uint32_t interpolation = outputRate / g;
+    const uint32_t decimation = inputRate / g;
+    if (interpolation > kMaxInterpolation || decimation > kMaxInterpolation * 8)
+      return false;
+
+    bank_ = bankFor(interpolation, decimation);
+    maxInput_ = maxInputFrames;
+    history_.assign(bank_->taps - 1 + maxInputFrames, 0.0f);
+    reset();
+    return true;
+  }
+
+  void PolyphaseResampler::reset()
+  {
+    if (!bank_)
+      return;
+    std::fill(history_.begin(), history_.end(), 0.0f);
+    base_ = bank_->taps - 1;
+    phase_ = 0;
+  }
+
+  uint32_t PolyphaseResampler::maxOutputFrames(uint32_t inputFrames) const
+  {
+    if (!bank_)
+      return inputFrames;
+    return static_cast<uint32_t>((static_cast<uint64_t>(inputFrames) * bank_->interpolation + bank_->decimation - 1) / bank_->decimation) + 1;
+  }
+
+  double PolyphaseResampler::delayInputFrames() const
+  {
+    if (!bank_)
+      return 0.0;
+    return (static_cast<double>(bank_->taps) * bank_->interpolation - 1.0) * 0.5 / bank_->interpolation;
+  }
+
+  uint32_t PolyphaseResampler::process(const float *in, uint32_t count, float *out)
+  {
+    if (!bank_ || count == 0)
+      return 0;
+    if (count > maxInput_)
+      count = maxInput_;
+
+    const uint32_t taps = bank_->taps;
+    const uint32_t L = bank_->interpolation;
+    const uint32_t M = bank_->decimation;
+    const float *coefficients = bank_->coefficients.data();
+    float *buffer = history_.data();
+    std::memcpy(buffer + taps - 1, in, sizeof(float) * count);
+
+    const uint32_t end = taps - 1 + count;
+    uint32_t base = base_;
+    uint32_t phase = phase_;
+    uint32_t produced = 0;
+    float (*const dot)(const float *, const float *, uint32_t) = kernels_->dot;
+    while (base < end)
+    {
+      const float *row = coefficients + static_cast<size_t>(phase) * taps;
+      const float *x = buffer + base - (taps - 1);
+      out[produced++] = dot(row, x, taps);
+      phase += M;
+      base += phase / L;
+      phase %= L;
+    }
+
+    // Keep the last K - 1 frames in front of the next block
+    std::memmove(buffer, buffer + count, sizeof(float) * (taps - 1));
+    base_ = base - count;
+    phase_ = phase;
+    return produced;
+  }
+}
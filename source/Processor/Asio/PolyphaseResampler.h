@@ -0,0 +1,66 @@
+#pragma once
+
+#include "DspKernels.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Newkon
+{
+  // Fixed-ratio polyphase sample-rate converter from the ASIO device rate to the host rate.
+  // The rates reduce to L/M (48000 -> 44100 is 147/160). A Kaiser-windowed sinc prototype of
+  // K * L taps, cut off just below the lower Nyquist, is split into L phases of K taps; every output
+  // frame is one K-tap inner product over the latest input frames. Banks are designed once per rate
+  // pair and shared process-wide. The inner product is DspKernels::dot for the running machine.
+  class PolyphaseResampler
+  {
+  public:
+    PolyphaseResampler() = default;
+
+    // Control thread. Designs (or reuses) the bank for the pair and sizes the buffers for blocks of up
+    // to maxInputFrames. Returns false for rates it cannot reduce to a usable ratio.
+    bool configure(uint32_t inputRate, uint32_t outputRate, uint32_t maxInputFrames);
+    bool isConfigured() const { return bank_ != nullptr; }
+
+    // Inner-product kernel, by default the widest the machine runs; benchmarks pick narrower ones.
+    // `isa` must not be wider than CpuFeatures::detectIsa().
+    void setKernel(CpuFeatures::Isa isa);
+    CpuFeatures::Isa kernel() const { return isa_; }
+
+    // Clears the history: the stream restarts from silence.
+    void reset();
+
+    // Most frames process() can return for `inputFrames` frames.
+    uint32_t maxOutputFrames(uint32_t inputFrames) const;
+
+    // Audio thread. Consumes `count` (<= maxInputFrames) frames and returns how many it wrote to `out`.
+    uint32_t process(const float *in, uint32_t count, float *out);
+
+    // Group delay of the filter in input frames
+    double delayInputFrames() const;
+
+    uint32_t interpolation() const { return bank_ ? bank_->interpolation : 1; }
+    uint32_t decimation() const { return bank_ ? bank_->decimation : 1; }
+    uint32_t tapsPerPhase() const { return bank_ ? bank_->taps : 0; }
+
+  private:
+    struct Bank
+    {
+      uint32_t interpolation = 1; // L
+      uint32_t decimation = 1;    // M
+      uint32_t taps = 0;          // K, a multiple of 8
+      std::vector<float> coefficients; // L rows of K taps, each row reversed to run over ascending input
+    };
+
+    static std::shared_ptr<const Bank> bankFor(uint32_t interpolation, uint32_t decimation);
+    static std::shared_ptr<const Bank> design(uint32_t interpolation, uint32_t decimation);
+
+    std::shared_ptr<const Bank> bank_;
+    CpuFeatures::Isa isa_ = CpuFeatures::detectIsa();
+    const DspKernels::Table *kernels_ = &DspKernels::active();
+    std::vector<float> history_; // K - 1 frames of history, then the current block
+    uint32_t maxInput_ = 0;
+    uint32_t base_ = 0;  // newest input frame (index in history_) of the next output
+    uint32_t phase_ = 0; // its phase, 0..L-1
+  };
+}
@@ -22,74 +22,94 @@ namespace Newkon
     return v;
   }
 
-  RingBufferFloat::RingBufferFloat(uint32_t capacityPow2)
+  RingBufferFloat::RingBufferFloat(uint32_t capacityPow2, uint32_t channels, Layout layout) : layout_(layout)
   {
-    cap_ = roundUpPow2(capacityPow2);
-    mask_ = cap_ - 1;
-#if defined(_MSC_VER)
-    data_ = static_cast<float *>(_aligned_malloc(sizeof(float) * cap_, 32));
-#else
-    posix_memalign(reinterpret_cast<void **>(&data_), 32, sizeof(float) * cap_);
-#endif
-    std::memset(data_, 0, sizeof(float) * cap_);
-    writePos_.store(0, std::memory_order_relaxed);
-    readPos_.store(0, std::memory_order_relaxed);
+    allocate(capacityPow2, channels);
   }
 
   RingBufferFloat::~RingBufferFloat()
   {
-    if (data_)
+    freePlain();
+  }
+
+  void RingBufferFloat::freePlain()
+  {
+    if (plain_)
     {
 #if defined(_MSC_VER)
-      _aligned_free(data_);
+      _aligned_free(plain_);
 #else
-      free(data_);
+      free(plain_);
 #endif
-      data_ = nullptr;
+      plain_ = nullptr;
     }
   }
 
-  void RingBufferFloat::resize(uint32_t capacityPow2)
+  bool RingBufferFloat::allocate(uint32_t capacityPow2, uint32_t channels)
   {
     uint32_t newCap = roundUpPow2(capacityPow2);
-    if (newCap == 0)
-      newCap = 1;
+    const uint32_t newChannels = channels > 0 ? channels : 1;
 
-    // Allocate new block first
+    if (layout_ == Layout::kMirrored)
+    {
+      // A plane must fill whole mapping units (a 4 KiB page, 64 KiB on Windows); both are powers of two
+      const size_t grain = MirroredMemory::granularity();
+      uint32_t mirroredCap = newCap;
+      while (grain > 0 && (sizeof(float) * mirroredCap) % grain != 0 && mirroredCap < (1u << 30))
+        mirroredCap <<= 1;
+      MirroredMemory fresh;
+      if (fresh.allocate(sizeof(float) * mirroredCap, newChannels))
+      {
+        mirror_.swap(fresh);
+        freePlain();
+        data_ = reinterpret_cast<float *>(mirror_.plane(0));
+        cap_ = mirroredCap;
+        stride_ = 2 * static_cast<size_t>(mirroredCap);
+        mask_ = cap_ - 1;
+        channels_ = newChannels;
+        writePos_.store(0, std::memory_order_relaxed);
+        readPos_.store(0, std::memory_order_relaxed);
+        return true;
+      }
+    }
+
+    const size_t bytes = sizeof(float) * newCap * newChannels;
     float *newData = nullptr;
 #if defined(_MSC_VER)
-    newData = static_cast<float *>(_aligned_malloc(sizeof(float) * newCap, 32));
+    newData = static_cast<float *>(_aligned_malloc(bytes, 32));
 #else
-    if (posix_memalign(reinterpret_cast<void **>(&newData), 32, sizeof(float) * newCap) != 0)
+    if (posix_memalign(reinterpret_cast<void **>(&newData), 32, bytes) != 0)
       newData = nullptr;
 #endif
     if (!newData)
-      return; // keep existing buffer if allocation fails
-
-    std::memset(newData, 0, sizeof(float) * newCap);
+      return false; // keep existing buffer if allocation fails
+    std::memset(newData, 0, bytes);
 
-    // Free old storage
-    if (data_)
-    {
-#if defined(_MSC_VER)
-      _aligned_free(data_);
-#else
-      free(data_);
-#endif
-    }
-
-    // Swap in new
+    // Free old storage, plain or mirrored, and swap in the new block
+    freePlain();
+    mirror_.release();
+    plain_ = newData;
     data_ = newData;
     cap_ = newCap;
+    stride_ = newCap;
     mask_ = cap_ - 1;
+    channels_ = newChannels;
     writePos_.store(0, std::memory_order_relaxed);
     readPos_.store(0, std::memory_order_relaxed);
+    return true;
+  }
+
+  void RingBufferFloat::resize(uint32_t capacityPow2, uint32_t channels)
+  {
+    allocate(capacityPow2, channels);
   }
 
   void RingBufferFloat::clear()
   {
+    // Through the first copy only: a mirror shares its memory
     if (data_)
-      std::memset(data_, 0, sizeof(float) * cap_);
+      for (uint32_t ch = 0; ch < channels_; ch++)
+        std::memset(data(ch), 0, sizeof(float) * cap_);
     writePos_.store(0, std::memory_order_relaxed);
     readPos_.store(0, std::memory_order_relaxed);
   }
@@ -119,19 +139,60 @@ namespace Newkon
     if (count == 0)
       return 0;
     uint32_t r = readPos_.load(std::memory_order_relaxed);
-    const uint32_t c1 = cap_ - r;
+    const uint32_t c1 = contiguous(r);
     uint32_t n1 = (count < c1) ? count : c1;
-    std::memcpy(dst, data_ + r, sizeof(float) * n1);
+    kernels_->copy(data_ + r, dst, n1);
     r = (r + n1) & mask_;
     uint32_t done = n1;
     if (done < count)
     {
       uint32_t n2 = count - done;
-      std::memcpy(dst + done, data_, sizeof(float) * n2);
+      kernels_->copy(data_, dst + done, n2);
       r = n2;
       done += n2;
     }
     readPos_.store(r, std::memory_order_relaxed);
     return done;
   }
+
+  void RingBufferFloat::peek(uint32_t channel, float *dst, uint32_t count) const
+  {
+    if (count == 0 || channel >= channels_)
+      return;
+    const float *plane = data(channel);
+    const uint32_t r = readPos_.load(std::memory_order_relaxed);
+    const uint32_t c1 = contiguous(r);
+    const uint32_t n1 = (count < c1) ? count : c1;
+    kernels_->copy(plane + r, dst, n1);
+    if (n1 < count)
+      kernels_->copy(plane, dst + n1, count - n1);
+  }
+
+  void RingBufferFloat::peek(uint32_t channel, double *dst, uint32_t count) const
+  {
+    if (count == 0 || channel >= channels_)
+      return;
+    const float *plane = data(channel);
+    const uint32_t r = readPos_.load(std::memory_order_relaxed);
+    const uint32_t c1 = contiguous(r);
+    const uint32_t n1 = (count < c1) ? count : c1;
+    kernels_->widen(plane + r, dst, n1);
+    if (n1 < count)
+      kernels_->widen(plane, dst + n1, count - n1);
+  }
+
+  void RingBufferFloat::writeAt(uint32_t channel, uint32_t pos, const float *src, uint32_t count)
+  {
+    if (count == 0 || channel >= channels_)
+      return;
+    if (count > cap_)
+      count = cap_;
+    float *plane = data(channel);
+    const uint32_t w = pos & mask_;
+    const uint32_t c1 = contiguous(w);
+    const uint32_t n1 = (count < c1) ? count : c1;
+    kernels_->copy(src, plane + w, n1);
+    if (n1 < count)
+      kernels_->copy(src + n1, plane, count - n1);
+  }
 }
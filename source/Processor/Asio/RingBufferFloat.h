@@ -1,38 +1,82 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <atomic>
+#include "DspKernels.h"
+#include "MirroredMemory.h"
 
 namespace Newkon
 {
+  // Planar ring: `channels` planes of `capacity` frames sharing one write and one read head, so all
+  // channels of a block become readable together.
+  // A mirrored ring maps every plane twice in a row (MirroredMemory): the capacity() frames from any
+  // position are contiguous, so spans never split at the wrap point and callers can work on data(ch) + pos
+  // directly. Mirroring rounds the capacity up to the mapping granularity, and falls back to a plain ring
+  // where the platform cannot map it.
   class RingBufferFloat
   {
   public:
-    explicit RingBufferFloat(uint32_t capacityPow2);
+    enum class Layout
+    {
+      kPlain,
+      kMirrored
+    };
+
+    explicit RingBufferFloat(uint32_t capacityPow2, uint32_t channels = 1, Layout layout = Layout::kPlain);
     ~RingBufferFloat();
+    RingBufferFloat(const RingBufferFloat &) = delete;
+    RingBufferFloat &operator=(const RingBufferFloat &) = delete;
 
-    void resize(uint32_t capacityPow2);
+    // Keeps the layout asked for at construction
+    void resize(uint32_t capacityPow2, uint32_t channels = 1);
     uint32_t capacity() const { return cap_; }
     uint32_t mask() const { return mask_; }
+    uint32_t channels() const { return channels_; }
+    bool mirrored() const { return mirror_.valid(); }
+
+    // Frames that can be accessed from `pos` before the wrap point: the whole ring when mirrored
+    uint32_t contiguous(uint32_t pos) const { return mirrored() ? cap_ : cap_ - (pos & mask_); }
+
+    // Copy kernels, by default those of the running machine; benchmarks swap in narrower ones
+    void setKernels(const DspKernels::Table &kernels) { kernels_ = &kernels; }
 
     void clear();
     void alignReadBehindWrite(uint32_t distance);
 
     // Low-level accessors used for zero-copy conversions
-    float *data() { return data_; }
+    float *data(uint32_t channel = 0) { return data_ + static_cast<size_t>(channel) * stride_; }
+    const float *data(uint32_t channel = 0) const { return data_ + static_cast<size_t>(channel) * stride_; }
     uint32_t getWritePos() const { return writePos_.load(std::memory_order_relaxed); }
     uint32_t getReadPos() const { return readPos_.load(std::memory_order_relaxed); }
     void setReadPos(uint32_t pos) { readPos_.store(pos & mask_, std::memory_order_relaxed); }
     void advanceWrite(uint32_t count);
     void advanceRead(uint32_t count);
 
-    // Convenience copying APIs
+    // Convenience copying APIs. read() takes channel 0 and moves the read head; peek() copies any
+    // channel from the read head and leaves it, for advanceRead() once every channel is out; the double
+    // overload widens on the way out. writeAt() copies into a channel from `pos` (wrapping) and leaves
+    // the write head, for advanceWrite() once every channel is in.
     uint32_t read(float *dst, uint32_t count);
+    void peek(uint32_t channel, float *dst, uint32_t count) const;
+    void peek(uint32_t channel, double *dst, uint32_t count) const;
+    void writeAt(uint32_t channel, uint32_t pos, const float *src, uint32_t count);
 
   private:
+    // Sets up storage for the given size, mirrored when requested and possible; false leaves the ring
+    // as it was
+    bool allocate(uint32_t capacityPow2, uint32_t channels);
+    void freePlain();
+
     float *data_ = nullptr;
+    float *plain_ = nullptr; // data_ when not mirrored
+    MirroredMemory mirror_;
+    Layout layout_ = Layout::kPlain;
+    size_t stride_ = 0; // floats from one plane to the next
     uint32_t cap_ = 0;
     uint32_t mask_ = 0;
+    uint32_t channels_ = 1;
+    const DspKernels::Table *kernels_ = &DspKernels::active();
     std::atomic<uint32_t> writePos_{0};
     std::atomic<uint32_t> readPos_{0};
   };
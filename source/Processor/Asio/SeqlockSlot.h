@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+namespace Newkon
+{
+  // Settings handed from control threads to one real-time reader, as a sequence lock like
+  // InputLevelMeter's. Writers take turns on a mutex and copy the value into atomic words with the
+  // sequence odd; the reader copies the words back and keeps them only if the sequence was even and
+  // unchanged. The reader never waits: a take() that meets a store in progress returns false, and the
+  // store leaves the value pending for the next one.
+  template <typename T>
+  class SeqlockSlot
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "the value is copied word by word");
+
+  public:
+    // Control threads: publish `value` for the reader.
+    void store(const T &value)
+    {
+      std::lock_guard<std::mutex> lock(writeMutex_);
+      latest_ = value;
+      uint64_t words[kWords] = {};
+      std::memcpy(words, &value, sizeof(T));
+      sequence_.store(writeSequence_ += 1, std::memory_order_relaxed); // odd: store in progress
+      std::atomic_thread_fence(std::memory_order_release);
+      for (size_t i = 0; i < kWords; i++)
+        words_[i].store(words[i], std::memory_order_relaxed);
+      sequence_.store(writeSequence_ += 1, std::memory_order_release);
+      pending_.store(true, std::memory_order_release);
+    }
+
+    // Control threads: the value last stored.
+    T load() const
+    {
+      std::lock_guard<std::mutex> lock(writeMutex_);
+      return latest_;
+    }
+
+    // Reader: true, with the value, when one was stored since the last successful take.
+    bool take(T &value)
+    {
+      if (!pending_.exchange(false, std::memory_order_acquire))
+        return false;
+      const uint32_t before = sequence_.load(std::memory_order_acquire);
+      uint64_t words[kWords];
+      for (size_t i = 0; i < kWords; i++)
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      // A store under way raises the flag again when it completes
+      if ((before & 1) != 0 || sequence_.load(std::memory_order_relaxed) != before)
+        return false;
+      std::memcpy(&value, words, sizeof(T));
+      return true;
+    }
+
+  private:
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint32_t> sequence_{0};
+    std::atomic<uint64_t> words_[kWords] = {};
+    std::atomic<bool> pending_{false};
+
+    // Writers only, under the mutex
+    mutable std::mutex writeMutex_;
+    uint32_t writeSequence_ = 0;
+    T latest_{};
+  };
+}
@@ -0,0 +1,109 @@
+#include "VariableResampler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Newkon
+{
+  namespace
+  {
+    // Zeroth-order modified Bessel function, for the Kaiser window
+    double besselI0(double x)
+    {
+      double sum = 1.0, term = 1.0;
+      for (int k = 1; k < 32; k++)
+      {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+      }
+      return sum;
+    }
+
+    constexpr double kCutoff = 0.94; // of the input Nyquist; leaves a transition band below it
+    constexpr double kKaiserBeta = 8.0;
+  }
+
+  VariableResampler::VariableResampler()
+  {
+    constexpr double pi = 3.14159265358979323846;
+    table_.resize(static_cast<size_t>(kPhases + 1) * kTaps);
+    const double norm = besselI0(kKaiserBeta);
+    for (int phase = 0; phase <= kPhases; phase++)
+    {
+      // Tap j sits at input frame n - (kHalfTaps - 1) + j; the output lies `frac` after frame n
+      const double frac = static_cast<double>(phase) / kPhases;
+      float *row = &table_[static_cast<size_t>(phase) * kTaps];
+      double sum = 0.0;
+      for (int j = 0; j < kTaps; j++)
+      {
+        const double d = j - (kHalfTaps - 1) - frac;
+        const double x = d * kCutoff * pi;
+        const double sinc = std::fabs(x) < 1e-9 ? 1.0 : std::sin(x) / x;
+        const double w = d / kHalfTaps;
+        const double window = std::fabs(w) >= 1.0 ? 0.0 : besselI0(kKaiserBeta * std::sqrt(1.0 - w * w)) / norm;
+        row[j] = static_cast<float>(sinc * window);
+        sum += row[j];
+      }
+      // Unity gain at DC for every phase, so steering the ratio never modulates the level
+      for (int j = 0; j < kTaps; j++)
+        row[j] = static_cast<float>(row[j] / sum);
+    }
+
+    buffer_.resize(static_cast<size_t>(kTaps + std::ceil(kMaxOutputFrames * kMaxRatio) + kTaps));
+    reset();
+  }
+
+  void VariableResampler::reset()
+  {
+    std::fill(buffer_.begin(), buffer_.end(), 0.0f);
+    buffered_ = kHalfTaps - 1;
+    position_ = static_cast<double>(kHalfTaps - 1);
+  }
+
+  uint32_t VariableResampler::inputFramesNeeded(uint32_t outputFrames, double ratio) const
+  {
+    if (outputFrames == 0)
+      return 0;
+    const double last = position_ + static_cast<double>(outputFrames - 1) * ratio;
+    const int64_t required = static_cast<int64_t>(std::floor(last)) + kHalfTaps + 1;
+    return required > buffered_ ? static_cast<uint32_t>(required - buffered_) : 0;
+  }
+
+  float *VariableResampler::inputBuffer(uint32_t count)
+  {
+    float *dst = buffer_.data() + buffered_;
+    buffered_ += count;
+    return dst;
+  }
+
+  void VariableResampler::process(float *out, uint32_t outputFrames, double ratio)
+  {
+    float (*const lerpDot)(const float *, const float *, float, const float *, uint32_t) = kernels_->lerpDot;
+    const float *table = table_.data();
+    const float *input = buffer_.data();
+    double position = position_;
+    for (uint32_t i = 0; i < outputFrames; i++)
+    {
+      const double base = std::floor(position);
+      const double phase = (position - base) * kPhases;
+      const int row = static_cast<int>(phase);
+      const float t = static_cast<float>(phase - row);
+      const float *c0 = table + static_cast<size_t>(row) * kTaps;
+      const float *x = input + static_cast<int64_t>(base) - (kHalfTaps - 1);
+      out[i] = lerpDot(c0, c0 + kTaps, t, x, kTaps);
+
+      position += ratio;
+    }
+
+    // Keep kHalfTaps - 1 frames of history before the next output position
+    const int64_t consumed = static_cast<int64_t>(std::floor(position)) - (kHalfTaps - 1);
+    if (consumed > 0)
+    {
+      const uint32_t drop = consumed < static_cast<int64_t>(buffered_) ? static_cast<uint32_t>(consumed) : buffered_;
+      std::memmove(buffer_.data(), buffer_.data() + drop, sizeof(float) * (buffered_ - drop));
+      buffered_ -= drop;
+      position -= drop;
+    }
+    position_ = position;
+  }
+}
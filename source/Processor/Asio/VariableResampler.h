@@ -0,0 +1,54 @@
+#pragma once
+
+#include "DspKernels.h"
+#include <cstdint>
+#include <vector>
+
+namespace Newkon
+{
+  // Band-limited variable-ratio resampler for the mono host read path.
+  // Each output frame is a 32-tap Kaiser-windowed sinc centred on its fractional input position. The
+  // taps come from a table of 256 phases, interpolated linearly between neighbouring phases, in the
+  // same pass as the inner product (DspKernels::lerpDot for the running machine). The ratio may
+  // change on every block: positions carry over exactly, so steering it never clicks. All storage is
+  // allocated in the constructor.
+  //
+  // Usage per block: ask inputFramesNeeded(), write that many frames to inputBuffer(), then process().
+  class VariableResampler
+  {
+  public:
+    static constexpr int kTaps = 32;
+    static constexpr int kPhases = 256;
+    // Largest output block per process() call; split longer host blocks
+    static constexpr uint32_t kMaxOutputFrames = 4096;
+    // Widest ratio the input buffer is sized for
+    static constexpr double kMaxRatio = 1.05;
+
+    VariableResampler();
+
+    // Forget the history: the next output starts on the next input frame, preceded by silence.
+    void reset();
+
+    // Frames to append before producing `outputFrames` frames at `ratio` (input frames per output frame).
+    uint32_t inputFramesNeeded(uint32_t outputFrames, double ratio) const;
+
+    // Where to write `count` new input frames; they count as appended once the call returns.
+    float *inputBuffer(uint32_t count);
+
+    // Produce outputFrames (<= kMaxOutputFrames) frames, consuming input at `ratio`.
+    void process(float *out, uint32_t outputFrames, double ratio);
+
+    // Input frames held but not yet reached by the output position: delay the resampler adds on top of
+    // whatever still waits upstream.
+    double pendingFrames() const { return static_cast<double>(buffered_) - position_; }
+
+  private:
+    static constexpr int kHalfTaps = kTaps / 2;
+
+    const DspKernels::Table *kernels_ = &DspKernels::active();
+    std::vector<float> table_;  // (kPhases + 1) rows of kTaps coefficients
+    std::vector<float> buffer_; // input history, then frames not consumed yet
+    uint32_t buffered_ = 0;
+    double position_ = 0.0; // input position of the next output frame, in buffer_ frames
+  };
+}
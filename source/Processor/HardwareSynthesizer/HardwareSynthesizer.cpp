@@ -5,11 +5,19 @@
 
 namespace Newkon
 {
+  namespace
+  {
+    int64_t toThinnerStamp(std::chrono::steady_clock::time_point when)
+    {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(when.time_since_epoch()).count();
+    }
+  }
+
   HardwareSynthesizer::HardwareSynthesizer(const std::string &deviceName,
                                            const std::string &manufacturer,
                                            UINT deviceId,
                                            bool isInputDevice)
-      : deviceName(deviceName), manufacturer(manufacturer), deviceId(deviceId), inputDevice(isInputDevice), connected(false), midiOutHandle(nullptr), midiInHandle(nullptr)
+      : deviceName(deviceName), manufacturer(manufacturer), deviceId(deviceId), inputDevice(isInputDevice), connected(false), producer(nullptr), directProducer(nullptr), midiInHandle(nullptr), sampleClock(nullptr)
   {
     Logger::getInstance() << "HardwareSynthesizer created: " << deviceName
                           << " (ID: " << deviceId << ")" << std::endl;
@@ -32,9 +40,8 @@ namespace Newkon
     if (initializeMIDI())
     {
       connected = true;
+      controlThinner.reset();
       Logger::getInstance() << "Successfully connected to: " << deviceName << std::endl;
-      if (midiOutHandle)
-        scheduler.start(midiOutHandle);
       return true;
     }
     else
@@ -49,7 +56,6 @@ namespace Newkon
     if (!connected)
       return;
 
-    scheduler.stop();
     cleanupMIDI();
     connected = false;
     Logger::getInstance() << "Disconnected from: " << deviceName << std::endl;
@@ -57,140 +63,183 @@ namespace Newkon
 
   bool HardwareSynthesizer::sendMIDINote(UINT note, UINT velocity, UINT channel)
   {
-    if (!connected || inputDevice)
-    {
-      return false;
-    }
-
     // MIDI Note On message: 0x90 + channel, note, velocity
     DWORD midiMessage = 0x90 | (channel & 0x0F);
     midiMessage |= (note & 0x7F) << 8;
     midiMessage |= (velocity & 0x7F) << 16;
 
-    MMRESULT result = midiOutShortMsg(midiOutHandle, midiMessage);
-    if (result == MMSYSERR_NOERROR)
+    std::lock_guard<std::mutex> lock(directMutex);
+    if (!directProducer)
+      return false; // not connected, or an input device
+    // Forget send times of earlier notes nobody asked for
+    MIDIEventQueue::Event stale;
+    while (directProducer->popDispatchedNoteOn(stale))
     {
-      return true;
-    }
-    else
-    {
-      return false;
     }
+    return directProducer->scheduleShortMsg(midiMessage, std::chrono::steady_clock::now());
   }
 
   bool HardwareSynthesizer::sendMIDINoteOff(UINT note, UINT channel)
   {
-    if (!connected || inputDevice)
-    {
-
-      return false;
-    }
-
     // MIDI Note Off message: 0x80 + channel, note, velocity (usually 64 for note off)
     DWORD midiMessage = 0x80 | (channel & 0x0F);
     midiMessage |= (note & 0x7F) << 8;
     midiMessage |= 64 << 16; // Standard note off velocity
 
-    MMRESULT result = midiOutShortMsg(midiOutHandle, midiMessage);
-    if (result == MMSYSERR_NOERROR)
-    {
-
-      return true;
-    }
-    else
-    {
-
-      return false;
-    }
+    std::lock_guard<std::mutex> lock(directMutex);
+    if (!directProducer)
+      return false; // not connected, or an input device
+    return directProducer->scheduleShortMsg(midiMessage, std::chrono::steady_clock::now());
   }
 
   bool HardwareSynthesizer::sendMIDIControlChange(UINT controller, UINT value, UINT channel)
   {
-    if (!connected || inputDevice)
-    {
-
-      return false;
-    }
-
     // MIDI Control Change message: 0xB0 + channel, controller, value
     DWORD midiMessage = 0xB0 | (channel & 0x0F);
     midiMessage |= (controller & 0x7F) << 8;
     midiMessage |= (value & 0x7F) << 16;
 
-    MMRESULT result = midiOutShortMsg(midiOutHandle, midiMessage);
-    if (result == MMSYSERR_NOERROR)
-    {
-
-      return true;
-    }
-    else
-    {
+    std::lock_guard<std::mutex> lock(directMutex);
+    if (!directProducer)
+      return false; // not connected, or an input device
+    return directProducer->scheduleShortMsg(midiMessage, std::chrono::steady_clock::now());
+  }
 
+  bool HardwareSynthesizer::takeSentNoteOnTime(std::chrono::steady_clock::time_point &sentAt)
+  {
+    std::lock_guard<std::mutex> lock(directMutex);
+    MIDIEventQueue::Event event;
+    if (!directProducer || !directProducer->popDispatchedNoteOn(event))
       return false;
-    }
+    sentAt = event.when;
+    return true;
   }
 
   void HardwareSynthesizer::scheduleMIDINote(UINT note, UINT velocity, UINT channel, double offsetSeconds)
   {
-    if (!connected || inputDevice || !midiOutHandle)
+    if (!connected || inputDevice || !producer)
       return;
     DWORD msg = 0x90 | (channel & 0x0F);
     msg |= (note & 0x7F) << 8;
     msg |= (velocity & 0x7F) << 16;
     auto when = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(offsetSeconds));
-    scheduler.scheduleShortMsg(msg, when);
+    producer->scheduleShortMsg(msg, when);
   }
 
   void HardwareSynthesizer::scheduleMIDINoteOff(UINT note, UINT channel, double offsetSeconds)
   {
-    if (!connected || inputDevice || !midiOutHandle)
+    if (!connected || inputDevice || !producer)
       return;
     DWORD msg = 0x80 | (channel & 0x0F);
     msg |= (note & 0x7F) << 8;
     msg |= 64 << 16;
     auto when = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(offsetSeconds));
-    scheduler.scheduleShortMsg(msg, when);
+    producer->scheduleShortMsg(msg, when);
   }
 
   void HardwareSynthesizer::scheduleMIDIControlChange(UINT controller, UINT value, UINT channel, double offsetSeconds)
   {
-    if (!connected || inputDevice || !midiOutHandle)
+    if (!connected || inputDevice || !producer)
       return;
     DWORD msg = 0xB0 | (channel & 0x0F);
     msg |= (controller & 0x7F) << 8;
     msg |= (value & 0x7F) << 16;
     auto when = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(offsetSeconds));
-    scheduler.scheduleShortMsg(msg, when);
+    if (!controlThinner.filter(channel, controller, value, MIDIControlThinner::StampDomain::kTime, toThinnerStamp(when), 1e9))
+      return;
+    producer->scheduleShortMsg(msg, when);
   }
 
   void HardwareSynthesizer::scheduleMIDINoteAt(UINT note, UINT velocity, UINT channel, std::chrono::steady_clock::time_point when)
   {
-    if (!connected || inputDevice || !midiOutHandle)
+    if (!connected || inputDevice || !producer)
       return;
     DWORD msg = 0x90 | (channel & 0x0F);
     msg |= (note & 0x7F) << 8;
     msg |= (velocity & 0x7F) << 16;
-    scheduler.scheduleShortMsg(msg, when);
+    producer->scheduleShortMsg(msg, when);
   }
 
   void HardwareSynthesizer::scheduleMIDINoteOffAt(UINT note, UINT channel, std::chrono::steady_clock::time_point when)
   {
-    if (!connected || inputDevice || !midiOutHandle)
+    if (!connected || inputDevice || !producer)
       return;
     DWORD msg = 0x80 | (channel & 0x0F);
     msg |= (note & 0x7F) << 8;
     msg |= 64 << 16;
-    scheduler.scheduleShortMsg(msg, when);
+    producer->scheduleShortMsg(msg, when);
   }
 
   void HardwareSynthesizer::scheduleMIDIControlChangeAt(UINT controller, UINT value, UINT channel, std::chrono::steady_clock::time_point when)
   {
-    if (!connected || inputDevice || !midiOutHandle)
+    if (!connected || inputDevice || !producer)
+      return;
+    DWORD msg = 0xB0 | (channel & 0x0F);
+    msg |= (controller & 0x7F) << 8;
+    msg |= (value & 0x7F) << 16;
+    if (!controlThinner.filter(channel, controller, value, MIDIControlThinner::StampDomain::kTime, toThinnerStamp(when), 1e9))
+      return;
+    producer->scheduleShortMsg(msg, when);
+  }
+
+  void HardwareSynthesizer::scheduleMIDINoteAtFrame(UINT note, UINT velocity, UINT channel, int64_t deviceFrame)
+  {
+    if (!connected || inputDevice || !producer)
+      return;
+    DWORD msg = 0x90 | (channel & 0x0F);
+    msg |= (note & 0x7F) << 8;
+    msg |= (velocity & 0x7F) << 16;
+    producer->scheduleShortMsgAtFrame(msg, deviceFrame);
+  }
+
+  void HardwareSynthesizer::scheduleMIDINoteOffAtFrame(UINT note, UINT channel, int64_t deviceFrame)
+  {
+    if (!connected || inputDevice || !producer)
+      return;
+    DWORD msg = 0x80 | (channel & 0x0F);
+    msg |= (note & 0x7F) << 8;
+    msg |= 64 << 16;
+    producer->scheduleShortMsgAtFrame(msg, deviceFrame);
+  }
+
+  void HardwareSynthesizer::scheduleMIDIControlChangeAtFrame(UINT controller, UINT value, UINT channel, int64_t deviceFrame)
+  {
+    if (!connected || inputDevice || !producer)
       return;
     DWORD msg = 0xB0 | (channel & 0x0F);
     msg |= (controller & 0x7F) << 8;
     msg |= (value & 0x7F) << 16;
-    scheduler.scheduleShortMsg(msg, when);
+    if (!controlThinner.filter(channel, controller, value, MIDIControlThinner::StampDomain::kDeviceFrame, deviceFrame, producer->getDeviceSampleRate()))
+      return;
+    producer->scheduleShortMsgAtFrame(msg, deviceFrame);
+  }
+
+  void HardwareSynthesizer::setSampleClock(const AsioClock *clock)
+  {
+    sampleClock = clock;
+    if (producer)
+      producer->setSampleClock(clock);
+  }
+
+  void HardwareSynthesizer::setDispatchLogging(bool enabled)
+  {
+    if (producer)
+      producer->setDispatchLogging(enabled);
+  }
+
+  void HardwareSynthesizer::flushControlChanges()
+  {
+    if (!connected || inputDevice || !producer)
+      return;
+    controlThinner.flush([this](uint32_t channel, uint32_t controller, uint32_t value, MIDIControlThinner::StampDomain domain, int64_t stamp)
+                         {
+      DWORD msg = 0xB0 | (channel & 0x0F);
+      msg |= (controller & 0x7F) << 8;
+      msg |= (value & 0x7F) << 16;
+      if (domain == MIDIControlThinner::StampDomain::kDeviceFrame)
+        producer->scheduleShortMsgAtFrame(msg, stamp);
+      else
+        producer->scheduleShortMsg(msg, std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(stamp)))); });
   }
 
   bool HardwareSynthesizer::initializeMIDI()
@@ -208,14 +257,28 @@ namespace Newkon
     }
     else
     {
-      // For output devices, open midiOut
-      MMRESULT result = midiOutOpen(&midiOutHandle, deviceId, 0, 0, CALLBACK_NULL);
-      if (result != MMSYSERR_NOERROR)
+      // For output devices, share the process-wide port and attach our own queue to its scheduler
+      port = MIDIPortHub::getInstance().acquire(deviceId);
+      if (!port)
       {
-        Logger::getInstance() << "Failed to open MIDI output device " << deviceName
-                              << " (Error: " << result << ")" << std::endl;
+        Logger::getInstance() << "Failed to open MIDI output device " << deviceName << std::endl;
         return false;
       }
+      MIDIScheduler &scheduler = port->getScheduler();
+      producer = scheduler.attachProducer();
+      MIDIScheduler::Producer *direct = producer ? scheduler.attachProducer() : nullptr;
+      if (!direct)
+      {
+        Logger::getInstance() << "Too many users of MIDI output device " << deviceName << std::endl;
+        scheduler.detachProducer(producer);
+        producer = nullptr;
+        port.reset();
+        return false;
+      }
+      producer->setSampleClock(sampleClock);
+      direct->setDispatchLogging(true);
+      std::lock_guard<std::mutex> lock(directMutex);
+      directProducer = direct;
     }
 
     return true;
@@ -223,10 +286,18 @@ namespace Newkon
 
   void HardwareSynthesizer::cleanupMIDI()
   {
-    if (midiOutHandle)
+    if (port)
     {
-      midiOutClose(midiOutHandle);
-      midiOutHandle = nullptr;
+      // Events already queued still go out; when this is the last user, the port sends those due by now
+      // and then closes
+      port->getScheduler().detachProducer(producer);
+      producer = nullptr;
+      {
+        std::lock_guard<std::mutex> lock(directMutex);
+        port->getScheduler().detachProducer(directProducer);
+        directProducer = nullptr;
+      }
+      port.reset();
     }
 
     if (midiInHandle)
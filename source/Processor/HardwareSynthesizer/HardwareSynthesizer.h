@@ -2,9 +2,12 @@
 
 #include <string>
 #include <memory>
+#include <mutex>
 #include <windows.h>
 #include <mmsystem.h>
 #include "MIDIScheduler.h"
+#include "MIDIPortHub.h"
+#include "MIDIControlThinner.h"
 #include <chrono>
 
 namespace Newkon
@@ -29,10 +32,17 @@ namespace Newkon
     // MIDI operations
     bool connect();
     void disconnect();
+
+    // Immediate sends from control threads (never the audio thread). They go through a producer queue
+    // of their own, so the scheduler worker stays the only writer to the port. Returns false when the
+    // message could not be queued.
     bool sendMIDINote(UINT note, UINT velocity, UINT channel = 0);
     bool sendMIDINoteOff(UINT note, UINT channel = 0);
     bool sendMIDIControlChange(UINT controller, UINT value, UINT channel = 0);
 
+    // Time the worker actually sent the latest sendMIDINote(); false until it has gone out.
+    bool takeSentNoteOnTime(std::chrono::steady_clock::time_point &sentAt);
+
     // Scheduled (time-aware) sending API
     void scheduleMIDINote(UINT note, UINT velocity, UINT channel, double offsetSeconds);
     void scheduleMIDINoteOff(UINT note, UINT channel, double offsetSeconds);
@@ -43,6 +53,31 @@ namespace Newkon
     void scheduleMIDINoteOffAt(UINT note, UINT channel, std::chrono::steady_clock::time_point when);
     void scheduleMIDIControlChangeAt(UINT controller, UINT value, UINT channel, std::chrono::steady_clock::time_point when);
 
+    // Device-frame variants: stamped on the ASIO sample clock attached to the scheduler
+    void scheduleMIDINoteAtFrame(UINT note, UINT velocity, UINT channel, int64_t deviceFrame);
+    void scheduleMIDINoteOffAtFrame(UINT note, UINT channel, int64_t deviceFrame);
+    void scheduleMIDIControlChangeAtFrame(UINT controller, UINT value, UINT channel, int64_t deviceFrame);
+
+    // Sends control changes held back by the rate limit. Call once per process block, after its events.
+    void flushControlChanges();
+
+    // Duplicate suppression and per-controller rate limit applied to every scheduled control change
+    void setControlThinning(const MIDIControlThinner::Options &options) { controlThinner.setOptions(options); }
+    MIDIControlThinner::Options getControlThinning() const { return controlThinner.getOptions(); }
+    MIDIControlThinner::Stats getControlThinningStats() const { return controlThinner.getStats(); }
+
+    // Sample clock used to resolve the device-frame variants (null to detach). Once this returns, or
+    // once disconnected, the port's scheduler no longer reads the previous clock.
+    void setSampleClock(const AsioClock *clock);
+
+    // Note-ons this instance sent, stamped with their actual send time (see MIDIScheduler::Producer)
+    void setDispatchLogging(bool enabled);
+    bool popDispatchedNoteOn(MIDIEventQueue::Event &event) { return producer && producer->popDispatchedNoteOn(event); }
+
+    // Dispatch tuning (mode, guard interval, spin policy) and lateness statistics live on the port's
+    // scheduler, which is shared with every other instance driving the same device. Only valid while connected.
+    MIDIScheduler &getScheduler() { return port->getScheduler(); }
+
   private:
     std::string deviceName;
     std::string manufacturer;
@@ -50,10 +85,16 @@ namespace Newkon
     bool inputDevice;
     bool connected;
 
-    // MIDI handles
-    HMIDIOUT midiOutHandle;
+    // MIDI handles: the output port is shared process-wide, the producer queue is ours
+    std::shared_ptr<MIDIPortHub::Port> port;
+    MIDIScheduler::Producer *producer;
+    // Queue for the immediate sends; control threads take turns on it
+    MIDIScheduler::Producer *directProducer;
+    std::mutex directMutex;
     HMIDIIN midiInHandle;
-    MIDIScheduler scheduler;
+    const AsioClock *sampleClock;
+    // Last value per channel/controller on this device; used from the host audio thread only
+    MIDIControlThinner controlThinner;
 
     bool initializeMIDI();
     void cleanupMIDI();
@@ -0,0 +1,110 @@
+#include "HighResolutionTimer.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <mmsystem.h>
+#elif defined(__linux__)
+#include <ctime>
+#include <cerrno>
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <thread>
+#endif
+
+#if defined(_WIN32) && !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace Newkon
+{
+  HighResolutionTimer::HighResolutionTimer()
+  {
+#if defined(_WIN32)
+    // Windows 10 1803+; older systems reject the flag and we fall back to Sleep() at 1 ms period
+    timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!timer)
+      raisedTimerPeriod = (timeBeginPeriod(1) == MMSYSERR_NOERROR);
+    wakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+#endif
+  }
+
+  HighResolutionTimer::~HighResolutionTimer()
+  {
+#if defined(_WIN32)
+    if (timer)
+      CloseHandle(timer);
+    if (wakeEvent)
+      CloseHandle(wakeEvent);
+    if (raisedTimerPeriod)
+      timeEndPeriod(1);
+#endif
+  }
+
+  void HighResolutionTimer::sleepUntil(std::chrono::steady_clock::time_point deadline)
+  {
+    using namespace std::chrono;
+#if defined(_WIN32)
+    // Waitable timers only take absolute times on the wall clock, which can jump; use a
+    // relative due time computed against the same steady clock as the deadline
+    const auto remaining = deadline - steady_clock::now();
+    if (remaining <= steady_clock::duration::zero())
+      return;
+    if (timer)
+    {
+      LARGE_INTEGER due;
+      due.QuadPart = -static_cast<LONGLONG>(duration_cast<nanoseconds>(remaining).count() / 100); // 100 ns units, negative = relative
+      if (due.QuadPart == 0)
+        return;
+      if (SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE))
+      {
+        if (!wakeEvent)
+        {
+          WaitForSingleObject(timer, INFINITE);
+          return;
+        }
+        HANDLE handles[2] = {timer, wakeEvent};
+        if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0)
+          CancelWaitableTimer(timer);
+        return;
+      }
+    }
+    const auto ms = duration_cast<milliseconds>(remaining).count();
+    if (wakeEvent)
+      WaitForSingleObject(wakeEvent, static_cast<DWORD>(ms > 0 ? ms : 0));
+    else
+      Sleep(static_cast<DWORD>(ms > 0 ? ms : 0));
+#elif defined(__linux__)
+    // libstdc++/libc++ steady_clock is CLOCK_MONOTONIC, so its epoch maps directly onto an absolute timespec
+    const auto ns = duration_cast<nanoseconds>(deadline.time_since_epoch()).count();
+    if (ns <= 0)
+      return;
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(ns / 1000000000);
+    ts.tv_nsec = static_cast<long>(ns % 1000000000);
+    // FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC deadline, with the same resolution as clock_nanosleep
+    while (wakePending.exchange(0, std::memory_order_acquire) == 0)
+    {
+      if (syscall(SYS_futex, reinterpret_cast<uint32_t *>(&wakePending), FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG, 0, &ts,
+                  nullptr, FUTEX_BITSET_MATCH_ANY) != 0 &&
+          errno == ETIMEDOUT)
+        return;
+    }
+#else
+    std::this_thread::sleep_until(deadline);
+#endif
+  }
+
+  void HighResolutionTimer::wake()
+  {
+#if defined(_WIN32)
+    if (wakeEvent)
+      SetEvent(wakeEvent);
+#elif defined(__linux__)
+    if (wakePending.exchange(1, std::memory_order_release) == 0)
+      syscall(SYS_futex, reinterpret_cast<uint32_t *>(&wakePending), FUTEX_WAKE | FUTEX_PRIVATE_FLAG, 1, nullptr, nullptr, 0);
+#endif
+  }
+}
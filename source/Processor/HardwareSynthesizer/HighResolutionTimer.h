@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+
+namespace Newkon
+{
+  // Absolute-deadline sleep with the best resolution the platform offers:
+  // clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME) on Linux, a high-resolution waitable timer on
+  // Windows (falling back to a 1 ms timer period on older systems). Create and sleep on it from one
+  // thread; any thread may wake() that sleeper early.
+  class HighResolutionTimer
+  {
+  public:
+    HighResolutionTimer();
+    ~HighResolutionTimer();
+
+    HighResolutionTimer(const HighResolutionTimer &) = delete;
+    HighResolutionTimer &operator=(const HighResolutionTimer &) = delete;
+
+    // Block until deadline (returns immediately if it already passed) or until woken.
+    void sleepUntil(std::chrono::steady_clock::time_point deadline);
+
+    // Ends the current sleep, or the next one if nobody sleeps. Never blocks or allocates, so the
+    // host audio thread may call it; several wakes before a sleep count as one.
+    void wake();
+
+  private:
+#if defined(_WIN32)
+    void *timer = nullptr;
+    void *wakeEvent = nullptr; // auto-reset
+    bool raisedTimerPeriod = false;
+#elif defined(__linux__)
+    // Futex word: 1 while a wake is pending
+    std::atomic<uint32_t> wakePending{0};
+#endif
+  };
+}
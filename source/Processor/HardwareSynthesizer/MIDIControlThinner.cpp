@@ -0,0 +1,108 @@
+#include "MIDIControlThinner.h"
+#include <cmath>
+
+namespace Newkon
+{
+  void MIDIControlThinner::setOptions(const Options &options)
+  {
+    suppressDuplicates_.store(options.suppressDuplicates, std::memory_order_relaxed);
+    maxRateHz_.store(options.maxRateHz > 0.0 ? options.maxRateHz : 0.0, std::memory_order_relaxed);
+  }
+
+  MIDIControlThinner::Options MIDIControlThinner::getOptions() const
+  {
+    Options options;
+    options.suppressDuplicates = suppressDuplicates_.load(std::memory_order_relaxed);
+    options.maxRateHz = maxRateHz_.load(std::memory_order_relaxed);
+    return options;
+  }
+
+  void MIDIControlThinner::reset()
+  {
+    for (auto &s : table_)
+      s = State();
+    heldCount_ = 0;
+  }
+
+  bool MIDIControlThinner::isThinnable(uint32_t controller)
+  {
+    switch (controller)
+    {
+    case 0:  // bank select MSB
+    case 32: // bank select LSB
+    case 6:  // data entry MSB
+    case 38: // data entry LSB
+      return false;
+    default:
+      // 96-101: data increment/decrement and (N)RPN selection, 120-127: channel mode messages
+      return !(controller >= 96 && controller <= 101) && controller < 120;
+    }
+  }
+
+  bool MIDIControlThinner::filter(uint32_t channel, uint32_t controller, uint32_t value, StampDomain domain, int64_t stamp, double unitsPerSecond)
+  {
+    received_.fetch_add(1, std::memory_order_relaxed);
+    channel &= 0x0F;
+    controller &= 0x7F;
+    value &= 0x7F;
+
+    State &s = table_[channel * kControllers + controller];
+    if (!isThinnable(controller))
+    {
+      forwarded_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    if (s.domain != domain)
+    {
+      // Stamps are not comparable across domains
+      s.domain = domain;
+      s.lastValue = -1;
+      s.heldValue = -1;
+    }
+
+    if (s.heldValue < 0 && s.lastValue == static_cast<int16_t>(value) && suppressDuplicates_.load(std::memory_order_relaxed))
+    {
+      suppressed_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    const double rate = maxRateHz_.load(std::memory_order_relaxed);
+    const int64_t minInterval = (rate > 0.0 && unitsPerSecond > 0.0) ? static_cast<int64_t>(std::llround(unitsPerSecond / rate)) : 0;
+    if (s.lastValue < 0 || minInterval <= 0 || stamp - s.lastStamp >= minInterval)
+    {
+      if (s.heldValue >= 0)
+      {
+        // A newer value supersedes the held one and goes out right away
+        s.heldValue = -1;
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+      }
+      s.lastValue = static_cast<int16_t>(value);
+      s.lastStamp = stamp;
+      forwarded_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    // Too soon: hold it, replacing any value already held for this controller
+    if (s.heldValue >= 0)
+      suppressed_.fetch_add(1, std::memory_order_relaxed);
+    const int64_t earliest = s.lastStamp + minInterval;
+    s.heldValue = static_cast<int16_t>(value);
+    s.heldStamp = stamp > earliest ? stamp : earliest;
+    if (!s.queued)
+    {
+      s.queued = true;
+      held_[heldCount_++] = static_cast<uint16_t>(channel * kControllers + controller);
+    }
+    return false;
+  }
+
+  MIDIControlThinner::Stats MIDIControlThinner::getStats() const
+  {
+    Stats stats;
+    stats.received = received_.load(std::memory_order_relaxed);
+    stats.forwarded = forwarded_.load(std::memory_order_relaxed);
+    stats.suppressed = suppressed_.load(std::memory_order_relaxed);
+    return stats;
+  }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+
+namespace Newkon
+{
+  // Last-value cache for control changes, one entry per channel and controller (16 x 128).
+  // - Redundant values (equal to what the device already has) are dropped.
+  // - Each controller is limited to maxRateHz: a change arriving sooner than 1/maxRateHz after the
+  //   previous one is held back, later changes replace it, and flush() sends the final held value at
+  //   the earliest time the rate allows. The last value of a sweep is therefore always delivered.
+  // Stamps are opaque int64 values in a domain (steady_clock nanoseconds or ASIO device frames);
+  // a controller switching domains starts over. filter() and flush() belong to the host audio thread,
+  // never lock and never allocate. Options and statistics can be accessed from any thread.
+  class MIDIControlThinner
+  {
+  public:
+    enum class StampDomain : uint8_t
+    {
+      kTime,       // steady_clock nanoseconds since epoch
+      kDeviceFrame // ASIO device frames
+    };
+
+    struct Options
+    {
+      bool suppressDuplicates = true;
+      // Maximum messages per second per controller; 0 disables rate limiting
+      double maxRateHz = 250.0;
+    };
+
+    struct Stats
+    {
+      uint64_t received = 0;
+      uint64_t forwarded = 0;  // sent as they came in or as held final values
+      uint64_t suppressed = 0; // duplicates and superseded held values
+    };
+
+    MIDIControlThinner() = default;
+
+    MIDIControlThinner(const MIDIControlThinner &) = delete;
+    MIDIControlThinner &operator=(const MIDIControlThinner &) = delete;
+
+    void setOptions(const Options &options);
+    Options getOptions() const;
+
+    // Forget every cached value, e.g. after (re)connecting: the device state is unknown.
+    void reset();
+
+    // Returns true when the change should be sent now at `stamp`; otherwise it is dropped or held
+    // for flush(). `unitsPerSecond` converts the rate limit into the stamp's domain (0: no limit).
+    bool filter(uint32_t channel, uint32_t controller, uint32_t value, StampDomain domain, int64_t stamp, double unitsPerSecond);
+
+    // Sends every held value through send(channel, controller, value, domain, stamp).
+    // Call once per processing block after the block's events have gone through filter().
+    template <typename Send>
+    void flush(Send &&send);
+
+    Stats getStats() const;
+
+    // True for controllers that may be thinned: every CC except bank select (0, 32), data entry
+    // (6, 38), data increment/decrement and (N)RPN selection (96-101) and channel mode messages
+    // (120-127), which must reach the device exactly as sent
+    static bool isThinnable(uint32_t controller);
+
+  private:
+    static constexpr uint32_t kChannels = 16;
+    static constexpr uint32_t kControllers = 128;
+
+    struct State
+    {
+      int64_t lastStamp = 0;
+      int64_t heldStamp = 0;
+      int16_t lastValue = -1; // -1: unknown
+      int16_t heldValue = -1; // -1: nothing held
+      StampDomain domain = StampDomain::kTime;
+      bool queued = false; // index is in held_
+    };
+
+    State table_[kChannels * kControllers];
+    uint16_t held_[kChannels * kControllers];
+    uint32_t heldCount_ = 0;
+
+    std::atomic<bool> suppressDuplicates_{true};
+    std::atomic<double> maxRateHz_{250.0};
+
+    // Written by the audio thread only
+    std::atomic<uint64_t> received_{0};
+    std::atomic<uint64_t> forwarded_{0};
+    std::atomic<uint64_t> suppressed_{0};
+  };
+
+  template <typename Send>
+  void MIDIControlThinner::flush(Send &&send)
+  {
+    const bool suppress = suppressDuplicates_.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < heldCount_; i++)
+    {
+      const uint32_t index = held_[i];
+      State &s = table_[index];
+      s.queued = false;
+      if (s.heldValue < 0)
+        continue;
+      if (suppress && s.heldValue == s.lastValue)
+      {
+        // The sweep came back to where the device already is
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+      }
+      else
+      {
+        send(index / kControllers, index % kControllers, static_cast<uint32_t>(s.heldValue), s.domain, s.heldStamp);
+        s.lastValue = s.heldValue;
+        s.lastStamp = s.heldStamp;
+        forwarded_.fetch_add(1, std::memory_order_relaxed);
+      }
+      s.heldValue = -1;
+    }
+    heldCount_ = 0;
+  }
+}
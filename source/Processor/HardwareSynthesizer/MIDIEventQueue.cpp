@@ -0,0 +1,75 @@
+#include "MIDIEventQueue.h"
+
+namespace Newkon
+{
+  static inline uint32_t roundUpPow2(uint32_t v)
+  {
+    if (v < 2)
+      return 2;
+    v--;
+    v |= v >> 1;
+    v |= v >> 2;
+    v |= v >> 4;
+    v |= v >> 8;
+    v |= v >> 16;
+    v++;
+    return v;
+  }
+
+  MIDIEventQueue::MIDIEventQueue(uint32_t capacityPow2, OverflowPolicy policy, uint32_t reservedSlots)
+      : policy_(policy)
+  {
+    cap_ = roundUpPow2(capacityPow2);
+    mask_ = cap_ - 1;
+    // Never reserve more than half the ring, otherwise regular traffic could starve
+    reserved_ = (reservedSlots > cap_ / 2) ? (cap_ / 2) : reservedSlots;
+    slots_.resize(cap_);
+  }
+
+  bool MIDIEventQueue::isNoteOff(uint32_t msg)
+  {
+    const uint32_t status = msg & 0xF0;
+    return status == 0x80 || (status == 0x90 && ((msg >> 16) & 0x7F) == 0);
+  }
+
+  bool MIDIEventQueue::push(const Event &event)
+  {
+    const uint32_t w = writeCount_.load(std::memory_order_relaxed);
+    uint32_t used = w - cachedReadCount_;
+    const uint32_t limit = (policy_ == OverflowPolicy::kReserveForNoteOff && !isNoteOff(event.msg)) ? (cap_ - reserved_) : cap_;
+    if (used >= limit)
+    {
+      // Refresh the consumer position only when the cached one says we are full
+      cachedReadCount_ = readCount_.load(std::memory_order_acquire);
+      used = w - cachedReadCount_;
+      if (used >= limit)
+      {
+        overflows_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    }
+    slots_[w & mask_] = event;
+    writeCount_.store(w + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool MIDIEventQueue::pop(Event &event)
+  {
+    const uint32_t r = readCount_.load(std::memory_order_relaxed);
+    if (r == writeCount_.load(std::memory_order_acquire))
+      return false;
+    event = slots_[r & mask_];
+    readCount_.store(r + 1, std::memory_order_release);
+    return true;
+  }
+
+  void MIDIEventQueue::clear()
+  {
+    readCount_.store(writeCount_.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+  uint32_t MIDIEventQueue::size() const
+  {
+    return writeCount_.load(std::memory_order_acquire) - readCount_.load(std::memory_order_acquire);
+  }
+}
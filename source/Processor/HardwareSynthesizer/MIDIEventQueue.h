@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace Newkon
+{
+  // Bounded wait-free single-producer/single-consumer queue carrying timestamped MIDI short messages
+  // from the host audio thread (producer) to the scheduler thread (consumer).
+  // All storage is allocated in the constructor; push() and pop() never lock, block or allocate.
+  class MIDIEventQueue
+  {
+  public:
+    // Marks an event stamped with `when` rather than a device sample frame
+    static constexpr int64_t kNoDeviceFrame = -1;
+
+    struct Event
+    {
+      std::chrono::steady_clock::time_point when;
+      uint32_t msg;
+      // ASIO device frame the event belongs to; resolved to a time point by the consumer
+      int64_t deviceFrame = kNoDeviceFrame;
+    };
+
+    enum class OverflowPolicy
+    {
+      // Reject any event pushed into a full queue.
+      kDropNewest,
+      // Reject everything but note-offs once only reservedSlots remain, so a burst of
+      // note-ons or CCs can never leave a note hanging on the hardware.
+      kReserveForNoteOff
+    };
+
+    explicit MIDIEventQueue(uint32_t capacityPow2,
+                            OverflowPolicy policy = OverflowPolicy::kReserveForNoteOff,
+                            uint32_t reservedSlots = 64);
+    ~MIDIEventQueue() = default;
+
+    MIDIEventQueue(const MIDIEventQueue &) = delete;
+    MIDIEventQueue &operator=(const MIDIEventQueue &) = delete;
+
+    // Producer side. Returns false (and counts an overflow) when the event is dropped by the policy.
+    bool push(const Event &event);
+
+    // Consumer side. Returns false when the queue is empty.
+    bool pop(Event &event);
+
+    // Consumer side. Discards every queued event.
+    void clear();
+
+    uint32_t capacity() const { return cap_; }
+    uint32_t size() const;
+    OverflowPolicy policy() const { return policy_; }
+
+    // Number of events dropped since construction; safe to read from any thread.
+    uint64_t overflowCount() const { return overflows_.load(std::memory_order_relaxed); }
+
+  private:
+    static bool isNoteOff(uint32_t msg);
+
+    std::vector<Event> slots_;
+    uint32_t cap_ = 0;
+    uint32_t mask_ = 0;
+    uint32_t reserved_ = 0;
+    OverflowPolicy policy_;
+
+    // Free-running counters; producer and consumer live on separate cache lines.
+    alignas(64) std::atomic<uint32_t> writeCount_{0};
+    uint32_t cachedReadCount_ = 0; // producer-local snapshot of readCount_
+    alignas(64) std::atomic<uint32_t> readCount_{0};
+    alignas(64) std::atomic<uint64_t> overflows_{0};
+  };
+}
@@ -0,0 +1,81 @@
+#include "MIDIPortHub.h"
+#include "../../Logger.h"
+
+namespace Newkon
+{
+  MIDIPortHub::Port::Port(UINT deviceId, HMIDIOUT handle) : deviceId(deviceId), handle(handle)
+  {
+    scheduler.start(handle);
+  }
+
+  MIDIPortHub::Port::~Port()
+  {
+    scheduler.stop();
+    if (handle)
+      midiOutClose(handle);
+  }
+
+  MIDIPortHub &MIDIPortHub::getInstance()
+  {
+    static MIDIPortHub instance;
+    return instance;
+  }
+
+  std::shared_ptr<MIDIPortHub::Port> MIDIPortHub::acquire(UINT deviceId)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    // An expired entry is a port whose last user is closing it; many drivers allow one handle per
+    // port, so wait for the close before opening it again
+    portClosed.wait(lock, [&]
+                    {
+      auto found = ports.find(deviceId);
+      return found == ports.end() || !found->second.expired(); });
+
+    auto it = ports.find(deviceId);
+    if (it != ports.end())
+    {
+      if (auto shared = it->second.lock())
+      {
+        Logger::getInstance() << "MIDI port " << deviceId << " shared (" << shared.use_count() << " users)" << std::endl;
+        return shared;
+      }
+    }
+
+    HMIDIOUT handle = nullptr;
+    MMRESULT result = midiOutOpen(&handle, deviceId, 0, 0, CALLBACK_NULL);
+    if (result != MMSYSERR_NOERROR)
+    {
+      Logger::getInstance() << "Failed to open MIDI output port " << deviceId << " (Error: " << result << ")" << std::endl;
+      return nullptr;
+    }
+
+    std::shared_ptr<Port> port(new Port(deviceId, handle), [this](Port *p)
+                               { release(p); });
+    ports[deviceId] = port;
+    Logger::getInstance() << "MIDI port " << deviceId << " opened" << std::endl;
+    return port;
+  }
+
+  void MIDIPortHub::release(Port *port)
+  {
+    const UINT deviceId = port->getDeviceId();
+    // Stops the dispatch thread and closes the handle
+    delete port;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      ports.erase(deviceId);
+    }
+    portClosed.notify_all();
+    Logger::getInstance() << "MIDI port " << deviceId << " closed" << std::endl;
+  }
+
+  size_t MIDIPortHub::getOpenPortCount()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+    for (const auto &entry : ports)
+      count += entry.second.expired() ? 0 : 1;
+    return count;
+  }
+}
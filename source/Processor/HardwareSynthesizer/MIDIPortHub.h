@@ -0,0 +1,60 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <windows.h>
+#include <mmsystem.h>
+#include "MIDIScheduler.h"
+
+namespace Newkon
+{
+  // Process-wide registry of open MIDI output ports.
+  // Every plugin instance targeting the same device shares one HMIDIOUT and one MIDIScheduler (one
+  // dispatch thread). Each instance attaches its own producer queue to that scheduler, so events from
+  // different instances are merged by time and go through a single running-status encoder and wire model.
+  // A port is closed when its last user releases it.
+  class MIDIPortHub
+  {
+  public:
+    class Port
+    {
+    public:
+      ~Port();
+
+      Port(const Port &) = delete;
+      Port &operator=(const Port &) = delete;
+
+      UINT getDeviceId() const { return deviceId; }
+      HMIDIOUT getHandle() const { return handle; }
+      MIDIScheduler &getScheduler() { return scheduler; }
+
+    private:
+      friend class MIDIPortHub;
+      Port(UINT deviceId, HMIDIOUT handle);
+
+      UINT deviceId;
+      HMIDIOUT handle;
+      MIDIScheduler scheduler;
+    };
+
+    static MIDIPortHub &getInstance();
+
+    // Opens the port or shares the already open one. Returns null when the device cannot be opened.
+    std::shared_ptr<Port> acquire(UINT deviceId);
+
+    // Number of distinct ports currently open
+    size_t getOpenPortCount();
+
+  private:
+    MIDIPortHub() = default;
+
+    void release(Port *port);
+
+    std::mutex mutex;
+    std::condition_variable portClosed;
+    // Expired entries belong to ports being closed; release() erases them
+    std::map<UINT, std::weak_ptr<Port>> ports;
+  };
+}
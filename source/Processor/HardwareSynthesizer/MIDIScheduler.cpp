@@ -1,15 +1,21 @@
 #include "MIDIScheduler.h"
-#include "../../Logger.h"
+#include "HighResolutionTimer.h"
+#include "../Asio/AsioClock.h"
+#include "../../TraceLogger.h"
+#include <immintrin.h>
 
 namespace Newkon
 {
-  MIDIScheduler::MIDIScheduler() {}
+  MIDIScheduler::MIDIScheduler() : timer(new HighResolutionTimer()), pending(kPendingCapacity) {}
+
   MIDIScheduler::~MIDIScheduler() { stop(); }
 
   void MIDIScheduler::start(HMIDIOUT handle)
   {
     stop();
     midiOut = handle;
+    pending.reset(std::chrono::steady_clock::now());
+    encoder.reset();
     running.store(true, std::memory_order_relaxed);
     worker = std::thread(&MIDIScheduler::run, this);
   }
@@ -18,74 +24,355 @@ namespace Newkon
   {
     if (running.exchange(false))
     {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+      }
       cv.notify_all();
+      timer->wake();
       if (worker.joinable())
         worker.join();
     }
-    // drain
+    // The worker is gone, so this thread is now the only consumer. Events due by now, such as the
+    // note-offs a disconnect schedules for held notes, still go out before the port closes.
+    const auto now = std::chrono::steady_clock::now();
+    for (;;)
     {
-      std::lock_guard<std::mutex> lock(mutex);
-      while (!queue.empty())
-        queue.pop();
+      drainIncoming();
+      if (const uint32_t due = popDueBatch(now))
+      {
+        for (uint32_t i = 0; i < due; i++)
+          dispatch(batch[i]);
+        continue;
+      }
+      // Nothing in the wheel is due: make room for due events still waiting in the rings
+      if (!pending.full() || !hasIncoming())
+        break;
+      pending.clear();
     }
+    // Later events are dropped
+    const uint32_t count = producerCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++)
+      producers[i]->queue.clear();
+    pending.clear();
     midiOut = nullptr;
   }
 
-  void MIDIScheduler::scheduleShortMsg(DWORD msg, std::chrono::steady_clock::time_point when)
+  bool MIDIScheduler::Producer::scheduleShortMsg(DWORD msg, std::chrono::steady_clock::time_point when)
+  {
+    if (!queue.push(MIDIEventQueue::Event{when, static_cast<uint32_t>(msg)}))
+      return false;
+    scheduler.wakeWorker();
+    return true;
+  }
+
+  bool MIDIScheduler::Producer::scheduleShortMsgAtFrame(DWORD msg, int64_t deviceFrame)
+  {
+    if (!queue.push(MIDIEventQueue::Event{std::chrono::steady_clock::time_point{}, static_cast<uint32_t>(msg), deviceFrame}))
+      return false;
+    scheduler.wakeWorker();
+    return true;
+  }
+
+  void MIDIScheduler::Producer::setSampleClock(const AsioClock *clock)
+  {
+    sampleClock.store(clock, std::memory_order_seq_cst);
+    // A use that started before the store has the flag up and ends by bumping the counter; any later
+    // use sees the new clock
+    const uint32_t ended = clockUsesEnded.load(std::memory_order_seq_cst);
+    while (clockInUse.load(std::memory_order_seq_cst) && clockUsesEnded.load(std::memory_order_seq_cst) == ended)
+      std::this_thread::yield();
+  }
+
+  double MIDIScheduler::Producer::getDeviceSampleRate() const
   {
+    const AsioClock *clock = sampleClock.load(std::memory_order_acquire);
+    return clock ? clock->sampleRate() : 0.0;
+  }
+
+  void MIDIScheduler::Producer::setDispatchLogging(bool enabled)
+  {
+    if (enabled)
+      dispatchLog.clear();
+    logDispatches.store(enabled, std::memory_order_release);
+  }
+
+  MIDIScheduler::Producer *MIDIScheduler::attachProducer()
+  {
+    std::lock_guard<std::mutex> lock(producerMutex);
+    const uint32_t count = producerCount.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; i++)
     {
-      std::lock_guard<std::mutex> lock(mutex);
-      queue.push(Scheduled{when, msg});
+      if (!producers[i]->attached.load(std::memory_order_relaxed))
+      {
+        producers[i]->attached.store(true, std::memory_order_relaxed);
+        return producers[i].get();
+      }
     }
-    cv.notify_all();
+    if (count == kMaxProducers)
+      return nullptr;
+    producers[count].reset(new Producer(*this, kIncomingCapacity));
+    producers[count]->attached.store(true, std::memory_order_relaxed);
+    producerCount.store(count + 1, std::memory_order_release);
+    return producers[count].get();
+  }
+
+  void MIDIScheduler::detachProducer(Producer *producer)
+  {
+    if (!producer)
+      return;
+    std::lock_guard<std::mutex> lock(producerMutex);
+    producer->setSampleClock(nullptr);
+    producer->logDispatches.store(false, std::memory_order_relaxed);
+    producer->attached.store(false, std::memory_order_relaxed);
+  }
+
+  uint64_t MIDIScheduler::getDroppedEventCount() const
+  {
+    uint64_t total = 0;
+    const uint32_t count = producerCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++)
+      total += producers[i]->getDroppedEventCount();
+    return total;
+  }
+
+  void MIDIScheduler::setDispatchOptions(const DispatchOptions &options)
+  {
+    dispatchMode.store(static_cast<int>(options.mode), std::memory_order_relaxed);
+    spinPolicy.store(static_cast<int>(options.spinPolicy), std::memory_order_relaxed);
+    // Half the poll interval at most, so the coarse sleep always has room before the fine phase
+    const int64_t maxGuardUs = std::chrono::duration_cast<std::chrono::microseconds>(kPollInterval).count() / 2;
+    const int64_t guardUs = options.guardInterval.count();
+    guardIntervalUs.store(guardUs < 0 ? 0 : (guardUs > maxGuardUs ? maxGuardUs : guardUs), std::memory_order_relaxed);
+  }
+
+  MIDIScheduler::DispatchOptions MIDIScheduler::getDispatchOptions() const
+  {
+    DispatchOptions options;
+    options.mode = static_cast<DispatchMode>(dispatchMode.load(std::memory_order_relaxed));
+    options.spinPolicy = static_cast<SpinPolicy>(spinPolicy.load(std::memory_order_relaxed));
+    options.guardInterval = std::chrono::microseconds(guardIntervalUs.load(std::memory_order_relaxed));
+    return options;
+  }
+
+  void MIDIScheduler::setWireOptions(const MIDIWireEncoder::Options &options)
+  {
+    wireRunningStatus.store(options.runningStatus, std::memory_order_relaxed);
+    wireNoteOffAsZeroVelocity.store(options.noteOffAsZeroVelocity, std::memory_order_relaxed);
+    wireByteNanoseconds.store(options.byteNanoseconds > 0 ? options.byteNanoseconds : 0, std::memory_order_relaxed);
+  }
+
+  MIDIWireEncoder::Options MIDIScheduler::getWireOptions() const
+  {
+    MIDIWireEncoder::Options options;
+    options.runningStatus = wireRunningStatus.load(std::memory_order_relaxed);
+    options.noteOffAsZeroVelocity = wireNoteOffAsZeroVelocity.load(std::memory_order_relaxed);
+    options.byteNanoseconds = wireByteNanoseconds.load(std::memory_order_relaxed);
+    return options;
+  }
+
+  MIDIScheduler::LatenessStats MIDIScheduler::getLatenessStats() const
+  {
+    LatenessStats stats;
+    stats.count = latenessCount.load(std::memory_order_relaxed);
+    if (stats.count > 0)
+      stats.meanUs = static_cast<double>(latenessSumNs.load(std::memory_order_relaxed)) / 1000.0 / static_cast<double>(stats.count);
+    stats.maxUs = static_cast<double>(latenessMaxNs.load(std::memory_order_relaxed)) / 1000.0;
+    for (int i = 0; i < LatenessStats::kBuckets; i++)
+      stats.buckets[i] = latenessBuckets[i].load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  void MIDIScheduler::resetLatenessStats()
+  {
+    latenessCount.store(0, std::memory_order_relaxed);
+    latenessSumNs.store(0, std::memory_order_relaxed);
+    latenessMaxNs.store(0, std::memory_order_relaxed);
+    for (auto &bucket : latenessBuckets)
+      bucket.store(0, std::memory_order_relaxed);
+  }
+
+  void MIDIScheduler::recordLateness(std::chrono::steady_clock::duration lateness)
+  {
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(lateness).count();
+    if (ns < 0)
+      ns = 0;
+    latenessCount.fetch_add(1, std::memory_order_relaxed);
+    latenessSumNs.fetch_add(ns, std::memory_order_relaxed);
+    if (ns > latenessMaxNs.load(std::memory_order_relaxed))
+      latenessMaxNs.store(ns, std::memory_order_relaxed);
+    int bucket = 0;
+    while (bucket < LatenessStats::kBuckets - 1 && ns >= LatenessStats::kBucketLimitsUs[bucket] * 1000)
+      bucket++;
+    latenessBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void MIDIScheduler::drainIncoming()
+  {
+    // Every producer's events land in the same wheel, which orders them by time across instances
+    MIDIEventQueue::Event event;
+    const uint32_t count = producerCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++)
+    {
+      Producer &producer = *producers[i];
+      // The clock stays valid until the flag drops, see Producer::setSampleClock()
+      producer.clockInUse.store(true, std::memory_order_seq_cst);
+      const AsioClock *clock = producer.sampleClock.load(std::memory_order_seq_cst);
+      // Stop pulling when the wheel is full: events stay in the ring and the producer
+      // sees back-pressure through the ring's overflow policy instead of a reallocation
+      while (!pending.full() && producer.queue.pop(event))
+      {
+        if (event.deviceFrame != MIDIEventQueue::kNoDeviceFrame)
+        {
+          // Resolve against the anchor of the producer's most recent device period
+          if (!clock || !clock->timeAtFrame(event.deviceFrame, event.when))
+            event.when = std::chrono::steady_clock::now();
+        }
+        pending.insert(event.when, event.msg, i);
+      }
+      producer.clockInUse.store(false, std::memory_order_seq_cst);
+      producer.clockUsesEnded.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    const uint64_t drops = getDroppedEventCount();
+    if (drops != reportedDrops)
+    {
+      TraceLogger::getInstance().trace(TraceEvent::kMidiDropped, static_cast<int64_t>(drops - reportedDrops), static_cast<int64_t>(drops));
+      reportedDrops = drops;
+    }
+  }
+
+  bool MIDIScheduler::hasIncoming() const
+  {
+    const uint32_t count = producerCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++)
+    {
+      if (producers[i]->queue.size() > 0)
+        return true;
+    }
+    return false;
+  }
+
+  void MIDIScheduler::wakeWorker()
+  {
+    // Pairs with the fence in run(): either the worker sees this event before it sleeps, or we see
+    // it asleep. Only the producer that clears the flag pays for the system call.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!sleeping.load(std::memory_order_relaxed) || !sleeping.exchange(false, std::memory_order_relaxed))
+      return;
+    if (static_cast<DispatchMode>(dispatchMode.load(std::memory_order_relaxed)) == DispatchMode::kHybrid)
+      timer->wake();
+    else
+      cv.notify_one();
+  }
+
+  void MIDIScheduler::waitConditionVariable(std::chrono::steady_clock::time_point wakeAt)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait_until(lock, wakeAt, [&]
+                  { return !running.load(std::memory_order_relaxed) || !sleeping.load(std::memory_order_relaxed); });
+  }
+
+  void MIDIScheduler::waitHybrid(std::chrono::steady_clock::time_point now, std::chrono::steady_clock::time_point wakeAt,
+                                 bool wakeIsDeadline)
+  {
+    using namespace std::chrono;
+    const auto guard = microseconds(guardIntervalUs.load(std::memory_order_relaxed));
+    if (!wakeIsDeadline || wakeAt - now > guard)
+    {
+      // Coarse phase: the OS may wake us late by its timer slack, which the guard absorbs
+      timer->sleepUntil(wakeIsDeadline ? wakeAt - guard : wakeAt);
+      return;
+    }
+
+    // Fine phase: within the guard interval of a deadline, finish the wait on the CPU
+    const bool busy = static_cast<SpinPolicy>(spinPolicy.load(std::memory_order_relaxed)) == SpinPolicy::kBusySpin;
+    while (steady_clock::now() < wakeAt && running.load(std::memory_order_relaxed) && sleeping.load(std::memory_order_relaxed))
+    {
+      if (busy)
+        _mm_pause();
+      else
+        std::this_thread::yield();
+    }
+  }
+
+  uint32_t MIDIScheduler::popDueBatch(std::chrono::steady_clock::time_point now)
+  {
+    uint32_t count = 0;
+    while (count < MIDIWireEncoder::kMaxBatch && pending.popDue(now, batch[count]))
+      count++;
+    if (count == 0)
+      return 0;
+
+    MIDIWireEncoder::prioritize(batch, count);
+
+    const MIDIWireEncoder::Options options = getWireOptions();
+    encoder.setOptions(options);
+    return count;
+  }
+
+  void MIDIScheduler::dispatch(const MIDITimingWheel::Entry &entry)
+  {
+    HMIDIOUT out = midiOut;
+    if (!out)
+      return;
+
+    const auto sendTime = std::chrono::steady_clock::now();
+    const MIDIWireEncoder::Encoded encoded = encoder.encode(entry.msg, entry.when, sendTime);
+    midiOutShortMsg(out, static_cast<DWORD>(encoded.msg));
+    const auto lateness = std::chrono::steady_clock::now() - entry.when;
+    recordLateness(lateness);
+
+    if ((entry.msg & 0xF0) == 0x90 && (entry.msg & 0x7F0000) != 0)
+    {
+      Producer &producer = *producers[entry.source];
+      if (producer.logDispatches.load(std::memory_order_acquire))
+        producer.dispatchLog.push(MIDIEventQueue::Event{sendTime, entry.msg});
+    }
+
+    // Traced in its original form, whatever went on the wire; formatting happens on the trace writer
+    TraceLogger::getInstance().trace(TraceEvent::kMidiSent, entry.msg,
+                                     std::chrono::duration_cast<std::chrono::nanoseconds>(lateness).count(), encoded.length);
   }
 
   void MIDIScheduler::run()
   {
     using namespace std::chrono;
+    TraceLogger::getInstance().registerCurrentThread("midi");
     while (running.load(std::memory_order_relaxed))
     {
-      std::unique_lock<std::mutex> lock(mutex);
-      if (queue.empty())
+      drainIncoming();
+
+      auto now = steady_clock::now();
+      if (const uint32_t count = popDueBatch(now))
       {
-        cv.wait(lock, [&]
-                { return !running.load(std::memory_order_relaxed) || !queue.empty(); });
-        if (!running.load(std::memory_order_relaxed))
-          break;
+        for (uint32_t i = 0; i < count; i++)
+          dispatch(batch[i]);
+        continue;
       }
-      auto next = queue.top();
-      auto now = steady_clock::now();
-      if (next.when > now)
+
+      // Nothing due: wait for the next deadline or a producer's wake-up, and never longer than the poll interval
+      auto wakeAt = now + kPollInterval;
+      bool wakeIsDeadline = false;
+      steady_clock::time_point deadline;
+      if (pending.nextDeadline(deadline) && deadline <= wakeAt)
       {
-        cv.wait_until(lock, next.when, [&]
-                      { return !running.load(std::memory_order_relaxed); });
-        if (!running.load(std::memory_order_relaxed))
-          break;
-        now = steady_clock::now();
-        if (next.when > now)
-          continue; // re-check
+        wakeAt = deadline;
+        wakeIsDeadline = true;
       }
-      queue.pop();
-      DWORD msg = next.msg;
-      HMIDIOUT out = midiOut;
-      lock.unlock();
-      if (out)
+
+      sleeping.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!pending.full() && hasIncoming())
       {
-        midiOutShortMsg(out, msg);
-        const UINT status = msg & 0xF0;
-        if (status == 0x90)
-        {
-          Logger::getInstance() << "MIDI Note On sent: msg=0x" << std::hex << msg << std::dec << std::endl;
-        }
-        else if (status == 0x80)
-        {
-          Logger::getInstance() << "MIDI Note Off sent: msg=0x" << std::hex << msg << std::dec << std::endl;
-        }
-        else if (status == 0xB0)
-        {
-          Logger::getInstance() << "MIDI CC sent: msg=0x" << std::hex << msg << std::dec << std::endl;
-        }
+        // Pushed after the drain above, before the producer could see us asleep
+        sleeping.store(false, std::memory_order_relaxed);
+        continue;
       }
+      if (static_cast<DispatchMode>(dispatchMode.load(std::memory_order_relaxed)) == DispatchMode::kHybrid)
+        waitHybrid(now, wakeAt, wakeIsDeadline);
+      else
+        waitConditionVariable(wakeAt);
+      sleeping.store(false, std::memory_order_relaxed);
     }
   }
 }
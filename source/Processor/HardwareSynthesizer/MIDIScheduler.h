@@ -6,39 +6,206 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
 #include <chrono>
+#include <memory>
+#include "MIDIEventQueue.h"
+#include "MIDITimingWheel.h"
+#include "MIDIWireEncoder.h"
 
 namespace Newkon
 {
+  class HighResolutionTimer;
+  class AsioClock;
+
   class MIDIScheduler
   {
   public:
+    enum class DispatchMode
+    {
+      // Wait on a condition variable until each deadline; accuracy bound by OS timer slack
+      kConditionVariable,
+      // Absolute-deadline sleep until guardInterval before the deadline, then spin/yield to it
+      kHybrid
+    };
+
+    enum class SpinPolicy
+    {
+      // Busy-wait with the CPU pause hint: lowest lateness, burns one core during the guard interval
+      kBusySpin,
+      // Yield the time slice between clock checks: slightly later, friendlier to other threads
+      kYield
+    };
+
+    static constexpr int64_t kDefaultGuardIntervalUs = 150;
+
+    struct DispatchOptions
+    {
+      DispatchMode mode = DispatchMode::kHybrid;
+      SpinPolicy spinPolicy = SpinPolicy::kYield;
+      // Covers the timer's wake-up slack. Clamped to half the poll interval: a guard as long as the
+      // poll would make the worker spin for every event
+      std::chrono::microseconds guardInterval{kDefaultGuardIntervalUs};
+    };
+
+    // Lateness (send time minus scheduled time) of dispatched messages since the last reset.
+    struct LatenessStats
+    {
+      static constexpr int kBuckets = 8;
+      // Upper bounds of the histogram buckets in microseconds; the last bucket is open-ended
+      static constexpr int64_t kBucketLimitsUs[kBuckets - 1] = {50, 100, 250, 500, 1000, 2000, 5000};
+
+      uint64_t count = 0;
+      double meanUs = 0.0;
+      double maxUs = 0.0;
+      uint64_t buckets[kBuckets] = {};
+    };
+
     MIDIScheduler();
     ~MIDIScheduler();
 
     void start(HMIDIOUT handle);
+    // Joins the worker, then sends the queued events already due and drops the rest.
     void stop();
 
-    void scheduleShortMsg(DWORD msg, std::chrono::steady_clock::time_point when);
-
-  private:
-    struct Scheduled
+    // Handoff point for one producing thread (one plugin instance's audio thread). Several producers
+    // can feed the same scheduler; the worker merges their events into one time-ordered stream.
+    class Producer
     {
-      std::chrono::steady_clock::time_point when;
-      DWORD msg;
-      bool operator>(const Scheduled &other) const { return when > other.when; }
+    public:
+      // Lock-free and allocation-free: safe to call from the host audio thread. Wakes the worker if it
+      // sleeps, so an event due now leaves without waiting out the poll interval.
+      // Returns false when the event was dropped because this producer's queue is full.
+      bool scheduleShortMsg(DWORD msg, std::chrono::steady_clock::time_point when);
+
+      // Same as scheduleShortMsg, but stamped in ASIO device frames. The worker converts the frame to a
+      // time point against the sample clock anchor of the device's latest buffer switch, so there is no
+      // drift between the host's wall clock and the interface recording the synth.
+      // Without a valid sample clock the message is sent immediately.
+      bool scheduleShortMsgAtFrame(DWORD msg, int64_t deviceFrame);
+
+      // Sample clock used to resolve this producer's frame-stamped messages (null to detach).
+      // Control thread. Returns once the worker has let go of the previous clock, which the caller may
+      // then destroy; detachProducer() detaches the clock the same way.
+      void setSampleClock(const AsioClock *clock);
+
+      // Rate of the attached sample clock, 0 without a valid anchor. For the thread that owns the
+      // producer, which keeps the clock alive.
+      double getDeviceSampleRate() const;
+
+      // Number of events rejected by this producer's queue overflow policy.
+      uint64_t getDroppedEventCount() const { return queue.overflowCount(); }
+
+      // Dispatch log: while enabled, the worker records every note-on it sends from this producer,
+      // stamped with the time it actually went out. Read by a single consumer thread; entries that
+      // find the log full are dropped. Enabling discards what an earlier consumer left behind.
+      void setDispatchLogging(bool enabled);
+      bool popDispatchedNoteOn(MIDIEventQueue::Event &event) { return dispatchLog.pop(event); }
+
+    private:
+      friend class MIDIScheduler;
+      Producer(MIDIScheduler &scheduler, uint32_t capacity)
+          : scheduler(scheduler), queue(capacity), dispatchLog(kDispatchLogCapacity, MIDIEventQueue::OverflowPolicy::kDropNewest, 0) {}
+
+      static constexpr uint32_t kDispatchLogCapacity = 1024;
+
+      MIDIScheduler &scheduler;
+      MIDIEventQueue queue;
+      MIDIEventQueue dispatchLog;
+      // Handoff of sampleClock: the worker flags each use and counts its ends, setSampleClock() waits
+      // out a use that may have loaded the previous pointer
+      std::atomic<const AsioClock *> sampleClock{nullptr};
+      std::atomic<bool> clockInUse{false};
+      std::atomic<uint32_t> clockUsesEnded{0};
+      std::atomic<bool> attached{false};
+      std::atomic<bool> logDispatches{false};
     };
 
+    // Control thread. Returns null once kMaxProducers are attached. Queues of detached producers are
+    // reused, and whatever is still in them is sent first.
+    Producer *attachProducer();
+    void detachProducer(Producer *producer);
+
+    // Number of events rejected by the producers' queues, in total.
+    uint64_t getDroppedEventCount() const;
+
+    // May be changed while running; the worker picks the new values up on its next wake-up.
+    void setDispatchOptions(const DispatchOptions &options);
+    DispatchOptions getDispatchOptions() const;
+
+    LatenessStats getLatenessStats() const;
+    void resetLatenessStats();
+
+    // Output encoding (running status, wire model). May be changed while running.
+    void setWireOptions(const MIDIWireEncoder::Options &options);
+    MIDIWireEncoder::Options getWireOptions() const;
+
+    // Bytes on the wire and chord-onset skew predicted by the wire model since the last reset.
+    MIDIWireEncoder::Stats getWireStats() const { return encoder.stats(); }
+    void resetWireStats() { encoder.resetStats(); }
+
+    static constexpr uint32_t kMaxProducers = 32;
+
+  private:
+    // Capacity of each audio thread -> scheduler handoff ring
+    static constexpr uint32_t kIncomingCapacity = 4096;
+    // Capacity of the scheduler-private timing wheel (events waiting for their deadline)
+    static constexpr uint32_t kPendingCapacity = 4 * kIncomingCapacity;
+    // How long the worker sleeps at most before polling the incoming rings again; producers wake it
+    // earlier, so this only bounds the cost of a missed wake-up
+    static constexpr std::chrono::milliseconds kPollInterval{1};
+
     std::atomic<bool> running{false};
     HMIDIOUT midiOut{nullptr};
     std::thread worker;
+
+    // Set by the worker while it waits; a producer that clears it wakes the worker
+    std::atomic<bool> sleeping{false};
+    // Hybrid mode sleeps on the timer, which producers and stop() can wake without blocking
+    std::unique_ptr<HighResolutionTimer> timer;
+    // Condition variable mode; producers notify without the mutex, so a wake-up that races the start
+    // of a wait is lost and the wait ends at the poll interval instead
     std::mutex mutex;
     std::condition_variable cv;
 
-    // min-heap by time
-    std::priority_queue<Scheduled, std::vector<Scheduled>, std::greater<Scheduled>> queue;
+    // Append-only; the worker reads producerCount without locking
+    std::unique_ptr<Producer> producers[kMaxProducers];
+    std::atomic<uint32_t> producerCount{0};
+    std::mutex producerMutex;
+
+    // Pending events ordered by (time, arrival); owned by the worker thread, preallocated
+    MIDITimingWheel pending;
+
+    uint64_t reportedDrops = 0;
+
+    // Due entries popped together, reordered by MIDIWireEncoder::prioritize; worker-owned
+    MIDITimingWheel::Entry batch[MIDIWireEncoder::kMaxBatch];
+    // The worker is the only writer to the port, so the encoder's running status is always the device's
+    MIDIWireEncoder encoder;
+
+    // Wire options, applied by the worker before each batch
+    std::atomic<bool> wireRunningStatus{true};
+    std::atomic<bool> wireNoteOffAsZeroVelocity{true};
+    std::atomic<int64_t> wireByteNanoseconds{MIDIWireEncoder::kDinByteNanoseconds};
+
+    // Dispatch options, stored individually so readers never lock
+    std::atomic<int> dispatchMode{static_cast<int>(DispatchMode::kHybrid)};
+    std::atomic<int> spinPolicy{static_cast<int>(SpinPolicy::kYield)};
+    std::atomic<int64_t> guardIntervalUs{kDefaultGuardIntervalUs};
+
+    // Lateness accumulators, written by the worker only
+    std::atomic<uint64_t> latenessCount{0};
+    std::atomic<int64_t> latenessSumNs{0};
+    std::atomic<int64_t> latenessMaxNs{0};
+    std::atomic<uint64_t> latenessBuckets[LatenessStats::kBuckets] = {};
 
+    void drainIncoming();
+    bool hasIncoming() const;
+    void wakeWorker();
     void run();
+    void waitConditionVariable(std::chrono::steady_clock::time_point wakeAt);
+    void waitHybrid(std::chrono::steady_clock::time_point now, std::chrono::steady_clock::time_point wakeAt, bool wakeIsDeadline);
+    uint32_t popDueBatch(std::chrono::steady_clock::time_point now);
+    void dispatch(const MIDITimingWheel::Entry &entry);
+    void recordLateness(std::chrono::steady_clock::duration lateness);
   };
 }
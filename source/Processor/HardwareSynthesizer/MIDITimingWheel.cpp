@@ -0,0 +1,279 @@
+#include "MIDITimingWheel.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Newkon
+{
+  static inline int countTrailingZeros(uint64_t v)
+  {
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return static_cast<int>(idx);
+#else
+    return __builtin_ctzll(v);
+#endif
+  }
+
+  MIDITimingWheel::MIDITimingWheel(uint32_t capacity)
+  {
+    nodes_.resize(capacity > 0 ? capacity : 1);
+    reset(Clock::now());
+  }
+
+  void MIDITimingWheel::reset(Clock::time_point origin)
+  {
+    clear();
+    origin_ = origin;
+    cursor_ = 0;
+    nextSeq_ = 0;
+  }
+
+  void MIDITimingWheel::clear()
+  {
+    // Rebuild the free list over the whole pool
+    const uint32_t n = static_cast<uint32_t>(nodes_.size());
+    for (uint32_t i = 0; i < n; i++)
+      nodes_[i].next = (i + 1 < n) ? i + 1 : kNil;
+    freeHead_ = 0;
+    for (uint32_t i = 0; i < kTotalSlots; i++)
+      slots_[i] = Slot{};
+    for (auto &word : l0Occupied_)
+      word = 0;
+    dueHead_ = dueTail_ = kNil;
+    count_ = 0;
+    wheelCount_ = 0;
+  }
+
+  uint64_t MIDITimingWheel::toTick(Clock::time_point when) const
+  {
+    if (when <= origin_)
+      return 0;
+    const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(when - origin_).count();
+    return static_cast<uint64_t>(ns / kTickNanoseconds);
+  }
+
+  MIDITimingWheel::Clock::time_point MIDITimingWheel::fromTick(uint64_t tick) const
+  {
+    return origin_ + std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(static_cast<int64_t>(tick) * kTickNanoseconds));
+  }
+
+  bool MIDITimingWheel::insert(Clock::time_point when, uint32_t msg, uint32_t source)
+  {
+    if (freeHead_ == kNil)
+      return false;
+    const uint32_t node = freeHead_;
+    freeHead_ = nodes_[node].next;
+
+    Node &n = nodes_[node];
+    n.entry.when = when;
+    n.entry.seq = nextSeq_++;
+    n.entry.msg = msg;
+    n.entry.source = source;
+    n.tick = toTick(when);
+    // Clamp past the horizon; the exact deadline is still honoured from the due list
+    const uint64_t horizon = cursor_ + (uint64_t(1) << (kL0Bits + (kLevels - 1) * kLnBits)) - 1;
+    if (n.tick > horizon)
+      n.tick = horizon;
+    count_++;
+    place(node);
+    return true;
+  }
+
+  void MIDITimingWheel::place(uint32_t node)
+  {
+    const uint64_t tick = nodes_[node].tick;
+    if (tick <= cursor_)
+    {
+      insertDue(node);
+      return;
+    }
+
+    const uint64_t delta = tick - cursor_;
+    uint32_t slot;
+    if (delta < kL0Slots)
+    {
+      const uint32_t idx = static_cast<uint32_t>(tick & (kL0Slots - 1));
+      l0Occupied_[idx >> 6] |= uint64_t(1) << (idx & 63);
+      slot = idx;
+    }
+    else
+    {
+      int level = 1;
+      while (level < kLevels - 1 && delta >= (uint64_t(1) << (kL0Bits + level * kLnBits)))
+        level++;
+      const int shift = kL0Bits + (level - 1) * kLnBits;
+      slot = kL0Slots + (level - 1) * kLnSlots + static_cast<uint32_t>((tick >> shift) & (kLnSlots - 1));
+    }
+    appendToSlot(slot, node);
+    wheelCount_++;
+  }
+
+  void MIDITimingWheel::appendToSlot(uint32_t slot, uint32_t node)
+  {
+    nodes_[node].next = kNil;
+    Slot &s = slots_[slot];
+    if (s.tail == kNil)
+      s.head = node;
+    else
+      nodes_[s.tail].next = node;
+    s.tail = node;
+  }
+
+  void MIDITimingWheel::insertDue(uint32_t node)
+  {
+    Node &n = nodes_[node];
+    auto before = [&](uint32_t other)
+    {
+      const Entry &o = nodes_[other].entry;
+      return n.entry.when < o.when || (n.entry.when == o.when && n.entry.seq < o.seq);
+    };
+
+    // Common case: entries arrive in order, so appending is O(1)
+    if (dueTail_ == kNil || !before(dueTail_))
+    {
+      n.next = kNil;
+      if (dueTail_ == kNil)
+        dueHead_ = node;
+      else
+        nodes_[dueTail_].next = node;
+      dueTail_ = node;
+      return;
+    }
+
+    // Within a tick entries can arrive out of order (cascades, sub-tick timestamps)
+    uint32_t prev = kNil;
+    uint32_t cur = dueHead_;
+    while (cur != kNil && !before(cur))
+    {
+      prev = cur;
+      cur = nodes_[cur].next;
+    }
+    n.next = cur;
+    if (prev == kNil)
+      dueHead_ = node;
+    else
+      nodes_[prev].next = node;
+  }
+
+  void MIDITimingWheel::cascade(int level)
+  {
+    const int shift = kL0Bits + (level - 1) * kLnBits;
+    const uint32_t slot = kL0Slots + (level - 1) * kLnSlots + static_cast<uint32_t>((cursor_ >> shift) & (kLnSlots - 1));
+    uint32_t node = slots_[slot].head;
+    slots_[slot] = Slot{};
+    while (node != kNil)
+    {
+      const uint32_t next = nodes_[node].next;
+      wheelCount_--;
+      place(node);
+      node = next;
+    }
+  }
+
+  uint64_t MIDITimingWheel::nextOccupiedL0(uint64_t from, uint64_t limit) const
+  {
+    // from and limit - 1 share one rotation of level 0
+    const uint64_t base = from & ~uint64_t(kL0Slots - 1);
+    uint32_t idx = static_cast<uint32_t>(from & (kL0Slots - 1));
+    while (idx < kL0Slots)
+    {
+      uint64_t word = l0Occupied_[idx >> 6] >> (idx & 63);
+      if (word)
+      {
+        const uint64_t tick = base + idx + countTrailingZeros(word);
+        return tick < limit ? tick : limit;
+      }
+      idx = (idx | 63) + 1;
+    }
+    return limit;
+  }
+
+  void MIDITimingWheel::advance(uint64_t target)
+  {
+    while (cursor_ < target)
+    {
+      if (wheelCount_ == 0)
+      {
+        cursor_ = target;
+        return;
+      }
+
+      // Jump straight to the next occupied level-0 slot or the next cascade boundary
+      const uint64_t boundary = (cursor_ | (kL0Slots - 1)) + 1;
+      uint64_t next = nextOccupiedL0(cursor_ + 1, boundary);
+      if (next > target)
+        next = target;
+      cursor_ = next;
+
+      if ((cursor_ & (kL0Slots - 1)) == 0)
+      {
+        // Higher levels first so their entries can fall through to lower ones in the same step
+        for (int level = kLevels - 1; level >= 1; level--)
+        {
+          const uint64_t span = uint64_t(1) << (kL0Bits + (level - 1) * kLnBits);
+          if ((cursor_ & (span - 1)) == 0)
+            cascade(level);
+        }
+      }
+
+      const uint32_t idx = static_cast<uint32_t>(cursor_ & (kL0Slots - 1));
+      const uint64_t bit = uint64_t(1) << (idx & 63);
+      if (l0Occupied_[idx >> 6] & bit)
+      {
+        l0Occupied_[idx >> 6] &= ~bit;
+        uint32_t node = slots_[idx].head;
+        slots_[idx] = Slot{};
+        while (node != kNil)
+        {
+          const uint32_t nextNode = nodes_[node].next;
+          wheelCount_--;
+          insertDue(node);
+          node = nextNode;
+        }
+      }
+    }
+  }
+
+  bool MIDITimingWheel::popDue(Clock::time_point now, Entry &out)
+  {
+    advance(toTick(now));
+    if (dueHead_ == kNil || nodes_[dueHead_].entry.when > now)
+      return false;
+
+    const uint32_t node = dueHead_;
+    out = nodes_[node].entry;
+    dueHead_ = nodes_[node].next;
+    if (dueHead_ == kNil)
+      dueTail_ = kNil;
+    nodes_[node].next = freeHead_;
+    freeHead_ = node;
+    count_--;
+    return true;
+  }
+
+  bool MIDITimingWheel::nextDeadline(Clock::time_point &deadline) const
+  {
+    if (count_ == 0)
+      return false;
+
+    bool found = false;
+    if (dueHead_ != kNil)
+    {
+      deadline = nodes_[dueHead_].entry.when;
+      found = true;
+    }
+    if (wheelCount_ > 0)
+    {
+      // Either the next occupied level-0 slot or the boundary where higher levels cascade
+      const uint64_t boundary = (cursor_ | (kL0Slots - 1)) + 1;
+      const auto wheelTime = fromTick(nextOccupiedL0(cursor_ + 1, boundary));
+      if (!found || wheelTime < deadline)
+        deadline = wheelTime;
+      found = true;
+    }
+    return found;
+  }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include <vector>
+
+namespace Newkon
+{
+  // Hierarchical timing wheel (calendar queue) holding timestamped MIDI short messages.
+  // Four levels of 256/64/64/64 slots at a 100 us tick cover ~1.8 hours ahead; later deadlines are clamped
+  // to the horizon and still leave at their exact time. Nodes come from a pool sized in the constructor,
+  // so insert() and popDue() never allocate. Entries sharing a timestamp leave in insertion order.
+  // Not thread-safe: owned by the scheduler worker.
+  class MIDITimingWheel
+  {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+      Clock::time_point when;
+      uint64_t seq;
+      uint32_t msg;
+      uint32_t source = 0; // opaque tag carried through for the owner (the scheduler's producer index)
+    };
+
+    static constexpr int64_t kTickNanoseconds = 100000;
+
+    explicit MIDITimingWheel(uint32_t capacity);
+    ~MIDITimingWheel() = default;
+
+    MIDITimingWheel(const MIDITimingWheel &) = delete;
+    MIDITimingWheel &operator=(const MIDITimingWheel &) = delete;
+
+    // Drop every entry and restart the wheel at the given time.
+    void reset(Clock::time_point origin);
+    void clear();
+
+    // O(1). Returns false when the node pool is exhausted.
+    bool insert(Clock::time_point when, uint32_t msg, uint32_t source = 0);
+
+    // Pops the earliest entry whose deadline is <= now, ordered by (when, insertion order).
+    bool popDue(Clock::time_point now, Entry &out);
+
+    // Earliest time at which popDue() may return something new. False when the wheel is empty.
+    bool nextDeadline(Clock::time_point &deadline) const;
+
+    uint32_t size() const { return count_; }
+    uint32_t capacity() const { return static_cast<uint32_t>(nodes_.size()); }
+    bool empty() const { return count_ == 0; }
+    bool full() const { return freeHead_ == kNil; }
+
+  private:
+    static constexpr uint32_t kNil = 0xFFFFFFFFu;
+    static constexpr int kLevels = 4;
+    static constexpr int kL0Bits = 8;
+    static constexpr int kLnBits = 6;
+    static constexpr uint32_t kL0Slots = 1u << kL0Bits;
+    static constexpr uint32_t kLnSlots = 1u << kLnBits;
+    static constexpr uint32_t kTotalSlots = kL0Slots + (kLevels - 1) * kLnSlots;
+
+    struct Node
+    {
+      Entry entry;
+      uint64_t tick;
+      uint32_t next;
+    };
+
+    struct Slot
+    {
+      uint32_t head = kNil;
+      uint32_t tail = kNil;
+    };
+
+    uint64_t toTick(Clock::time_point when) const;
+    Clock::time_point fromTick(uint64_t tick) const;
+
+    void place(uint32_t node);
+    void appendToSlot(uint32_t slot, uint32_t node);
+    void insertDue(uint32_t node);
+    void cascade(int level);
+    void advance(uint64_t target);
+    uint64_t nextOccupiedL0(uint64_t from, uint64_t limit) const;
+
+    std::vector<Node> nodes_;
+    Slot slots_[kTotalSlots];
+    uint64_t l0Occupied_[kL0Slots / 64] = {};
+    uint32_t freeHead_ = kNil;
+    uint32_t dueHead_ = kNil;
+    uint32_t dueTail_ = kNil;
+    uint32_t count_ = 0;
+    uint32_t wheelCount_ = 0; // entries still in slots (not yet due)
+    uint64_t cursor_ = 0;     // every tick <= cursor_ has been moved to the due list
+    uint64_t nextSeq_ = 0;
+    Clock::time_point origin_{};
+  };
+}
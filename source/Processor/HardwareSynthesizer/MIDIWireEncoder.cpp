@@ -0,0 +1,253 @@
+#include "MIDIWireEncoder.h"
+
+namespace Newkon
+{
+  namespace
+  {
+    bool isNoteOff(uint32_t msg)
+    {
+      const uint32_t type = msg & 0xF0;
+      return type == 0x80 || (type == 0x90 && ((msg >> 16) & 0x7F) == 0);
+    }
+
+    bool isNoteOn(uint32_t msg)
+    {
+      return (msg & 0xF0) == 0x90 && ((msg >> 16) & 0x7F) != 0;
+    }
+
+    // Both messages are notes on the same channel and key
+    bool sameKey(uint32_t a, uint32_t b)
+    {
+      const uint32_t typeA = a & 0xF0, typeB = b & 0xF0;
+      return (typeA == 0x80 || typeA == 0x90) && (typeB == 0x80 || typeB == 0x90) &&
+             (a & 0x0F) == (b & 0x0F) && ((a >> 8) & 0x7F) == ((b >> 8) & 0x7F);
+    }
+
+    // Messages that change what the notes around them mean: program changes, bank selects, the pedals
+    // that hold notes (sustain, sostenuto, soft), channel mode messages (120-127) and system messages
+    bool isBarrier(uint32_t msg)
+    {
+      const uint32_t status = msg & 0xFF;
+      const uint32_t type = status & 0xF0;
+      if (status >= 0xF0 || type == 0xC0)
+        return true;
+      if (type != 0xB0)
+        return false;
+      const uint32_t controller = (msg >> 8) & 0x7F;
+      return controller == 0 || controller == 32 || controller == 64 || controller == 66 || controller == 67 ||
+             controller >= 120;
+    }
+  }
+
+  uint32_t MIDIWireEncoder::messageLength(uint32_t status)
+  {
+    status &= 0xFF;
+    if (status < 0x80)
+      return 3; // not a status byte; treated as a full message
+    if (status < 0xF0)
+    {
+      const uint32_t type = status & 0xF0;
+      return (type == 0xC0 || type == 0xD0) ? 2 : 3;
+    }
+    switch (status)
+    {
+    case 0xF1: // MTC quarter frame
+    case 0xF3: // song select
+      return 2;
+    case 0xF2: // song position
+      return 3;
+    default:
+      return 1;
+    }
+  }
+
+  void MIDIWireEncoder::reset()
+  {
+    runningStatus_ = 0;
+    lineFreeAt_ = Clock::time_point{};
+    chordOpen_ = false;
+    chordNotes_ = 0;
+  }
+
+  MIDIWireEncoder::Encoded MIDIWireEncoder::encode(uint32_t msg, Clock::time_point when, Clock::time_point now)
+  {
+    uint32_t status = msg & 0xFF;
+    const uint32_t data1 = (msg >> 8) & 0x7F;
+    uint32_t data2 = (msg >> 16) & 0x7F;
+    const bool noteOn = isNoteOn(msg);
+
+    Encoded encoded;
+    encoded.msg = msg;
+    encoded.length = messageLength(status);
+
+    if (status >= 0x80 && status < 0xF0)
+    {
+      const uint32_t channelNoteOn = 0x90 | (status & 0x0F);
+      if (options_.runningStatus && options_.noteOffAsZeroVelocity && (status & 0xF0) == 0x80 && runningStatus_ == channelNoteOn)
+      {
+        status = channelNoteOn;
+        data2 = 0;
+        encoded.msg = status | (data1 << 8);
+      }
+
+      if (options_.runningStatus && status == runningStatus_)
+      {
+        // Data bytes only; midiOutShortMsg reads them from the low-order byte up
+        encoded.msg = data1 | (data2 << 8);
+        encoded.length -= 1;
+        statusBytesSaved_.fetch_add(1, std::memory_order_relaxed);
+      }
+      runningStatus_ = status;
+    }
+    else if (status >= 0xF0 && status < 0xF8)
+    {
+      // System common messages cancel running status; real-time messages (0xF8-0xFF) leave it alone
+      runningStatus_ = 0;
+    }
+
+    // Wire model: the message starts when both it and the line are ready
+    encoded.wireStart = now > lineFreeAt_ ? now : lineFreeAt_;
+    encoded.wireEnd = encoded.wireStart + std::chrono::duration_cast<Clock::duration>(
+                                              std::chrono::nanoseconds(options_.byteNanoseconds * encoded.length));
+    lineFreeAt_ = encoded.wireEnd;
+
+    messages_.fetch_add(1, std::memory_order_relaxed);
+    bytes_.fetch_add(encoded.length, std::memory_order_relaxed);
+
+    // Chord tracking: note-ons sharing a scheduled instant
+    if (chordOpen_ && when > chordWhen_)
+      closeChord();
+    if (noteOn)
+    {
+      if (chordOpen_ && when == chordWhen_)
+      {
+        chordLast_ = encoded.wireEnd;
+        chordNotes_++;
+      }
+      else
+      {
+        closeChord();
+        chordOpen_ = true;
+        chordWhen_ = when;
+        chordFirst_ = chordLast_ = encoded.wireEnd;
+        chordNotes_ = 1;
+      }
+    }
+
+    return encoded;
+  }
+
+  void MIDIWireEncoder::closeChord()
+  {
+    if (chordOpen_ && chordNotes_ >= 2)
+    {
+      const int64_t skewNs = std::chrono::duration_cast<std::chrono::nanoseconds>(chordLast_ - chordFirst_).count();
+      chords_.fetch_add(1, std::memory_order_relaxed);
+      chordSkewSumNs_.fetch_add(skewNs, std::memory_order_relaxed);
+      if (skewNs > chordSkewMaxNs_.load(std::memory_order_relaxed))
+        chordSkewMaxNs_.store(skewNs, std::memory_order_relaxed);
+    }
+    chordOpen_ = false;
+    chordNotes_ = 0;
+  }
+
+  MIDIWireEncoder::Stats MIDIWireEncoder::stats() const
+  {
+    Stats stats;
+    stats.messages = messages_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.statusBytesSaved = statusBytesSaved_.load(std::memory_order_relaxed);
+    stats.chords = chords_.load(std::memory_order_relaxed);
+    if (stats.chords > 0)
+      stats.meanChordSkewUs = static_cast<double>(chordSkewSumNs_.load(std::memory_order_relaxed)) / 1000.0 / static_cast<double>(stats.chords);
+    stats.maxChordSkewUs = static_cast<double>(chordSkewMaxNs_.load(std::memory_order_relaxed)) / 1000.0;
+    return stats;
+  }
+
+  void MIDIWireEncoder::resetStats()
+  {
+    messages_.store(0, std::memory_order_relaxed);
+    bytes_.store(0, std::memory_order_relaxed);
+    statusBytesSaved_.store(0, std::memory_order_relaxed);
+    chords_.store(0, std::memory_order_relaxed);
+    chordSkewSumNs_.store(0, std::memory_order_relaxed);
+    chordSkewMaxNs_.store(0, std::memory_order_relaxed);
+  }
+
+  void MIDIWireEncoder::prioritize(MIDITimingWheel::Entry *entries, uint32_t count)
+  {
+    struct Keyed
+    {
+      MIDITimingWheel::Entry entry;
+      uint32_t segment;
+      uint32_t rank;    // 0 notes and other voice messages, 1 control changes, 2 barrier
+      uint32_t subRank; // within rank 0 at one instant: note-off, bend/pressure, note-on
+    };
+
+    if (count > kMaxBatch)
+      count = kMaxBatch; // callers never pop more than kMaxBatch entries at once
+    if (count < 2)
+      return;
+
+    Keyed keyed[kMaxBatch];
+    uint32_t segment = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+      const uint32_t msg = entries[i].msg;
+      const uint32_t type = msg & 0xF0;
+      Keyed &k = keyed[i];
+      k.entry = entries[i];
+      k.segment = segment;
+      k.subRank = 0;
+      if (isBarrier(msg))
+      {
+        k.rank = 2;
+        segment++;
+      }
+      else if (type == 0xB0)
+        k.rank = 1;
+      else
+      {
+        k.rank = 0;
+        k.subRank = isNoteOff(msg) ? 0 : (isNoteOn(msg) ? 2 : 1);
+        // Notes on one channel and key keep their order: never rank below an earlier one at this
+        // instant, so a zero-length or retriggered note cannot lose its on or off to the other
+        for (uint32_t p = 0; p < i; p++)
+        {
+          if (keyed[p].rank == 0 && keyed[p].segment == segment && keyed[p].entry.when == entries[i].when &&
+              sameKey(keyed[p].entry.msg, msg) && keyed[p].subRank > k.subRank)
+            k.subRank = keyed[p].subRank;
+        }
+      }
+    }
+
+    auto before = [](const Keyed &a, const Keyed &b)
+    {
+      if (a.segment != b.segment)
+        return a.segment < b.segment;
+      if (a.rank != b.rank)
+        return a.rank < b.rank;
+      if (a.entry.when != b.entry.when)
+        return a.entry.when < b.entry.when;
+      if (a.subRank != b.subRank)
+        return a.subRank < b.subRank;
+      return a.entry.seq < b.entry.seq;
+    };
+
+    // Insertion sort: batches are small and usually close to sorted already
+    for (uint32_t i = 1; i < count; i++)
+    {
+      Keyed k = keyed[i];
+      uint32_t j = i;
+      while (j > 0 && before(k, keyed[j - 1]))
+      {
+        keyed[j] = keyed[j - 1];
+        j--;
+      }
+      keyed[j] = k;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+      entries[i] = keyed[i].entry;
+  }
+}
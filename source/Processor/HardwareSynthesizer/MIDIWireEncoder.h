@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include "MIDITimingWheel.h"
+
+namespace Newkon
+{
+  // Output stage between the scheduler and midiOutShortMsg.
+  // - Running status: repeated channel-voice status bytes are omitted, and note-offs may be sent as
+  //   velocity-0 note-ons so a chord's releases share the note-on status.
+  // - Wire model: predicts when the last byte of each message leaves a 31,250 baud DIN port
+  //   (10 bits per byte, 320 us), so chord-onset skew can be measured without a MIDI analyser.
+  // - Priority ordering of a batch of due messages, see prioritize().
+  // Encoding is done by one thread (the scheduler worker); statistics can be read and reset from any thread.
+  class MIDIWireEncoder
+  {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // Start bit + 8 data bits + stop bit at 31,250 baud
+    static constexpr int64_t kDinByteNanoseconds = 320000;
+    // Largest batch prioritize() accepts
+    static constexpr uint32_t kMaxBatch = 64;
+
+    struct Options
+    {
+      bool runningStatus = true;
+      // Send 0x8n as 0x9n with velocity 0 when 0x9n is the running status (our note-offs carry a fixed
+      // release velocity, so nothing is lost)
+      bool noteOffAsZeroVelocity = true;
+      // Wire time per byte; 0 for transports without a serial bottleneck (USB, network)
+      int64_t byteNanoseconds = kDinByteNanoseconds;
+    };
+
+    struct Encoded
+    {
+      uint32_t msg;    // packed for midiOutShortMsg, status byte omitted when running status applies
+      uint32_t length; // bytes on the wire
+      Clock::time_point wireStart;
+      Clock::time_point wireEnd; // predicted arrival of the last byte at the receiver
+    };
+
+    struct Stats
+    {
+      uint64_t messages = 0;
+      uint64_t bytes = 0;
+      uint64_t statusBytesSaved = 0;
+      // Chord: two or more note-ons scheduled for the same instant. Skew is the spread between the
+      // predicted arrival of its first and last note-on.
+      uint64_t chords = 0;
+      double meanChordSkewUs = 0.0;
+      double maxChordSkewUs = 0.0;
+    };
+
+    MIDIWireEncoder() = default;
+
+    MIDIWireEncoder(const MIDIWireEncoder &) = delete;
+    MIDIWireEncoder &operator=(const MIDIWireEncoder &) = delete;
+
+    void setOptions(const Options &options) { options_ = options; }
+    const Options &options() const { return options_; }
+
+    // Forget the running status and the line occupancy, e.g. when the port is (re)opened.
+    void reset();
+
+    // Someone else wrote to the port: the next message carries its status byte again.
+    void invalidateRunningStatus() { runningStatus_ = 0; }
+
+    // `when` is the scheduled time (used to group chords), `now` the send time.
+    Encoded encode(uint32_t msg, Clock::time_point when, Clock::time_point now);
+
+    // When the modelled line becomes idle.
+    Clock::time_point lineFreeAt() const { return lineFreeAt_; }
+
+    Stats stats() const;
+    void resetStats();
+
+    // Reorders a batch of due entries (already sorted by time and arrival) so that notes go ahead of
+    // controller traffic that piled up with them. The order is deterministic:
+    // - program changes, bank selects, the sustain/sostenuto/soft pedals, channel mode messages
+    //   (CC 120-127) and system messages are barriers: nothing moves across them;
+    // - between barriers, note-ons/offs, pitch bend and aftertouch go first, in time order, with
+    //   note-offs, then bend/pressure, then note-ons at a shared instant, except that notes on the same
+    //   channel and key keep their original order;
+    // - control changes follow in their original order.
+    // Notes never overtake each other across instants or on one key, so an off/on pair keeps its meaning.
+    static void prioritize(MIDITimingWheel::Entry *entries, uint32_t count);
+
+    // Bytes of a complete message with the given status byte (1 to 3).
+    static uint32_t messageLength(uint32_t status);
+
+  private:
+    void closeChord();
+
+    Options options_;
+    uint32_t runningStatus_ = 0;
+    Clock::time_point lineFreeAt_{};
+
+    // Chord currently being sent
+    bool chordOpen_ = false;
+    Clock::time_point chordWhen_{};
+    Clock::time_point chordFirst_{};
+    Clock::time_point chordLast_{};
+    uint32_t chordNotes_ = 0;
+
+    // Written by the encoding thread only
+    std::atomic<uint64_t> messages_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> statusBytesSaved_{0};
+    std::atomic<uint64_t> chords_{0};
+    std::atomic<int64_t> chordSkewSumNs_{0};
+    std::atomic<int64_t> chordSkewMaxNs_{0};
+  };
+}
@@ -0,0 +1,302 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Newkon.
+//------------------------------------------------------------------------
+
+#include "LatencyCalibrator.h"
+#include "./HardwareSynthesizer/HardwareSynthesizer.h"
+#include "./Asio/AsioInterface.h"
+#include "../Logger.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace Newkon
+{
+	namespace
+	{
+		// Largest |x| over the range, four lanes at a time
+		float peakMagnitude(const float *samples, uint32_t count)
+		{
+			const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+			__m128 peak = _mm_setzero_ps();
+			uint32_t i = 0;
+			for (; i + 4 <= count; i += 4)
+				peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(samples + i), absMask));
+			peak = _mm_max_ps(peak, _mm_movehl_ps(peak, peak));
+			peak = _mm_max_ss(peak, _mm_shuffle_ps(peak, peak, 1));
+			float result = _mm_cvtss_f32(peak);
+			for (; i < count; i++)
+				result = std::max(result, std::fabs(samples[i]));
+			return result;
+		}
+
+		// First index in [begin, end) with |x| > level, or end
+		uint32_t firstAbove(const float *samples, uint32_t begin, uint32_t end, float level)
+		{
+			const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+			const __m128 threshold = _mm_set1_ps(level);
+			uint32_t i = begin;
+			for (; i + 4 <= end; i += 4)
+			{
+				const int hits = _mm_movemask_ps(_mm_cmpgt_ps(_mm_and_ps(_mm_loadu_ps(samples + i), absMask), threshold));
+				if (hits)
+				{
+					unsigned long lane = 0;
+					while (!(hits & (1 << lane)))
+						lane++;
+					return i + static_cast<uint32_t>(lane);
+				}
+			}
+			for (; i < end; i++)
+			{
+				if (std::fabs(samples[i]) > level)
+					return i;
+			}
+			return end;
+		}
+
+		template <typename Predicate>
+		bool waitFor(Predicate done, std::chrono::milliseconds timeout)
+		{
+			const auto deadline = std::chrono::steady_clock::now() + timeout;
+			while (!done())
+			{
+				if (std::chrono::steady_clock::now() > deadline)
+					return false;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			return true;
+		}
+	}
+
+	//------------------------------------------------------------------------
+	int64_t LatencyCalibrator::findOnset(const float *samples, uint32_t count, uint32_t startIndex, const OnsetOptions &options)
+	{
+		if (!samples || startIndex == 0 || startIndex >= count)
+			return -1;
+
+		const float noisePeak = peakMagnitude(samples, startIndex);
+		const float signalPeak = peakMagnitude(samples + startIndex, count - startIndex);
+		const float gate = std::max(noisePeak * options.noiseMargin, 1e-6f);
+		if (signalPeak < gate || signalPeak < noisePeak * options.minSignalToNoise)
+			return -1;
+
+		// Cross well inside the attack, where the envelope is unambiguous...
+		const float level = std::max(gate, signalPeak * options.attackFraction);
+		const uint32_t crossing = firstAbove(samples, startIndex, count, level);
+		if (crossing == count)
+			return -1;
+
+		// ...then walk back to the first sample above the noise gate, across the attack's own zero crossings
+		uint32_t onset = crossing;
+		for (uint32_t i = crossing; i-- > startIndex;)
+		{
+			if (std::fabs(samples[i]) > gate)
+				onset = i;
+			else if (onset - i > options.maxGapFrames)
+				break;
+		}
+		return onset;
+	}
+
+	//------------------------------------------------------------------------
+	LatencyCalibrator::Result LatencyCalibrator::summarize(const std::vector<double> &measurements, double outlierThreshold)
+	{
+		Result result;
+		result.measurements = measurements;
+		result.detected = static_cast<int>(measurements.size());
+		if (measurements.empty())
+			return result;
+
+		auto medianOf = [](std::vector<double> values)
+		{
+			std::sort(values.begin(), values.end());
+			const size_t mid = values.size() / 2;
+			return (values.size() % 2) ? values[mid] : 0.5 * (values[mid - 1] + values[mid]);
+		};
+
+		const double median = medianOf(measurements);
+		std::vector<double> deviations;
+		for (double m : measurements)
+			deviations.push_back(std::fabs(m - median));
+		// 1.4826 scales the MAD to a standard deviation for normal noise; keep a 0.1 ms floor so a
+		// perfectly steady device does not reject runs that are one frame off
+		const double sigma = std::max(1.4826 * medianOf(deviations), 0.0001);
+
+		std::vector<double> kept;
+		for (double m : measurements)
+		{
+			if (std::fabs(m - median) <= outlierThreshold * sigma)
+				kept.push_back(m);
+		}
+		if (kept.empty())
+			return result;
+
+		std::sort(kept.begin(), kept.end());
+		double mean = 0.0;
+		for (double m : kept)
+			mean += m;
+		mean /= kept.size();
+		double variance = 0.0;
+		for (double m : kept)
+			variance += (m - mean) * (m - mean);
+
+		result.success = true;
+		result.accepted = static_cast<int>(kept.size());
+		result.medianSeconds = medianOf(kept);
+		result.minSeconds = kept.front();
+		result.maxSeconds = kept.back();
+		result.jitterSeconds = kept.back() - kept.front();
+		result.stdDevSeconds = std::sqrt(variance / kept.size());
+		return result;
+	}
+
+	//------------------------------------------------------------------------
+	LatencyCalibrator::Result LatencyCalibrator::run(HardwareSynthesizer &synth, AsioInterface &asio, const Settings &settings)
+	{
+		const AsioClock &clock = asio.getSampleClock();
+		const double rate = clock.sampleRate();
+		if (!asio.isConnectedAndStreaming() || !synth.isConnected() || synth.isInputDevice() || rate <= 0.0 || settings.runs <= 0)
+		{
+			Logger::getInstance() << "Latency calibration needs a running ASIO stream and a connected output synth" << std::endl;
+			return Result();
+		}
+
+		const uint32_t preRoll = static_cast<uint32_t>(std::max(1.0, settings.preRollSeconds * rate));
+		const uint32_t captureFrames = preRoll + static_cast<uint32_t>(std::max(1.0, settings.captureSeconds * rate));
+		const auto captureTimeout = std::chrono::milliseconds(static_cast<int64_t>((settings.preRollSeconds + settings.captureSeconds) * 1000.0) + 1000);
+
+		OnsetOptions onsetOptions;
+		std::vector<double> measurements;
+		std::vector<float> samples;
+		int completedRuns = 0;
+		for (int run = 0; run < settings.runs; run++)
+		{
+			if (!asio.armCaptureTap(captureFrames, settings.captureOutput) ||
+					!waitFor([&]
+									 { return asio.getCaptureTapFrames() >= preRoll; },
+									 captureTimeout))
+			{
+				Logger::getInstance() << "Latency calibration: no audio captured, stopping" << std::endl;
+				break;
+			}
+
+			// Stamp the note with the device frame being captured when the scheduler worker sent it
+			std::chrono::steady_clock::time_point sentAt;
+			int64_t sendFrame = 0;
+			const bool stamped = synth.sendMIDINote(settings.note, settings.velocity, settings.channel) &&
+													 waitFor([&]
+																	 { return synth.takeSentNoteOnTime(sentAt); },
+																	 captureTimeout) &&
+													 clock.frameAt(sentAt, sendFrame);
+
+			int64_t firstFrame = 0;
+			const bool captured = waitFor([&]
+																		{ return asio.takeCaptureTap(samples, firstFrame); },
+																		captureTimeout);
+			synth.sendMIDINoteOff(settings.note, settings.channel);
+			completedRuns++;
+
+			// A tap that restarted after the note (driver skipped frames) holds no pre-roll
+			if (captured && stamped && sendFrame > firstFrame && sendFrame < firstFrame + static_cast<int64_t>(samples.size()))
+			{
+				const int64_t onset = findOnset(samples.data(), static_cast<uint32_t>(samples.size()),
+																				static_cast<uint32_t>(sendFrame - firstFrame), onsetOptions);
+				if (onset >= 0)
+				{
+					const double seconds = static_cast<double>(firstFrame + onset - sendFrame) / rate;
+					measurements.push_back(seconds);
+					Logger::getInstance() << "Latency calibration run " << run + 1 << ": " << seconds * 1000.0 << " ms" << std::endl;
+				}
+				else
+					Logger::getInstance() << "Latency calibration run " << run + 1 << ": no onset found" << std::endl;
+			}
+			else
+				Logger::getInstance() << "Latency calibration run " << run + 1 << ": capture incomplete" << std::endl;
+
+			std::this_thread::sleep_for(std::chrono::duration<double>(settings.releaseSeconds));
+		}
+		asio.disarmCaptureTap();
+
+		Result result = summarize(measurements, settings.outlierThreshold);
+		result.runs = completedRuns;
+		return result;
+	}
+
+	//------------------------------------------------------------------------
+	LatencyCalibrator::Result LatencyCalibrator::runInsertLoop(AsioInterface &asio, const Settings &settings)
+	{
+		const AsioClock &clock = asio.getSampleClock();
+		const double rate = clock.sampleRate();
+		if (!asio.isConnectedAndStreaming() || !asio.isInsertActive() || rate <= 0.0 || settings.runs <= 0)
+		{
+			Logger::getInstance() << "Insert loop measurement needs a running ASIO stream with insert outputs" << std::endl;
+			return Result();
+		}
+
+		const uint32_t preRoll = static_cast<uint32_t>(std::max(1.0, settings.preRollSeconds * rate));
+		const uint32_t captureFrames = preRoll + static_cast<uint32_t>(std::max(1.0, settings.captureSeconds * rate));
+		const auto captureTimeout = std::chrono::milliseconds(static_cast<int64_t>((settings.preRollSeconds + settings.captureSeconds) * 1000.0) + 1000);
+
+		// Program audio on the outputs would read as the onset
+		asio.setInsertMuted(true);
+		std::this_thread::sleep_for(std::chrono::duration<double>(settings.releaseSeconds));
+
+		OnsetOptions onsetOptions;
+		std::vector<double> measurements;
+		std::vector<float> samples;
+		int completedRuns = 0;
+		for (int run = 0; run < settings.runs; run++)
+		{
+			if (!asio.armCaptureTap(captureFrames) ||
+					!waitFor([&]
+									 { return asio.getCaptureTapFrames() >= preRoll; },
+									 captureTimeout))
+			{
+				Logger::getInstance() << "Insert loop measurement: no audio captured, stopping" << std::endl;
+				break;
+			}
+
+			// The callback writes the impulse and stamps it with the frame it captures at the same moment
+			int64_t sendFrame = 0;
+			const bool sent = asio.fireInsertImpulse(settings.impulseLevel) &&
+												waitFor([&]
+																{ return asio.takeInsertImpulse(sendFrame); },
+																captureTimeout);
+
+			int64_t firstFrame = 0;
+			const bool captured = sent && waitFor([&]
+																						{ return asio.takeCaptureTap(samples, firstFrame); },
+																						captureTimeout);
+			completedRuns++;
+
+			if (captured && sendFrame > firstFrame && sendFrame < firstFrame + static_cast<int64_t>(samples.size()))
+			{
+				const int64_t onset = findOnset(samples.data(), static_cast<uint32_t>(samples.size()),
+																				static_cast<uint32_t>(sendFrame - firstFrame), onsetOptions);
+				if (onset >= 0)
+				{
+					const double seconds = static_cast<double>(firstFrame + onset - sendFrame) / rate;
+					measurements.push_back(seconds);
+					Logger::getInstance() << "Insert loop run " << run + 1 << ": " << seconds * 1000.0 << " ms" << std::endl;
+				}
+				else
+					Logger::getInstance() << "Insert loop run " << run + 1 << ": no onset found" << std::endl;
+			}
+			else
+				Logger::getInstance() << "Insert loop run " << run + 1 << ": capture incomplete" << std::endl;
+
+			std::this_thread::sleep_for(std::chrono::duration<double>(settings.releaseSeconds));
+		}
+		asio.disarmCaptureTap();
+		asio.setInsertMuted(false);
+
+		Result result = summarize(measurements, settings.outlierThreshold);
+		result.runs = completedRuns;
+		return result;
+	}
+
+	//------------------------------------------------------------------------
+} // namespace Newkon
@@ -0,0 +1,83 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Newkon.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Newkon
+{
+	class HardwareSynthesizer;
+	class AsioInterface;
+
+	//------------------------------------------------------------------------
+	//  LatencyCalibrator
+	//------------------------------------------------------------------------
+	// Measures the hardware round trip (MIDI out -> synth -> ASIO capture) that
+	// HardwareSynthProcessor::setLatency expects. For each run a test note is sent, stamped with the
+	// device frame captured at that instant, while the ASIO capture tap records the input. An onset
+	// detector finds the attack in the capture and the difference in device frames is one measurement.
+	// Outliers are rejected around the median (median absolute deviation) and the spread of what is
+	// left is reported as jitter.
+	//
+	// runInsertLoop() measures a hardware insert the same way, with an impulse on the ASIO insert outputs
+	// in place of the note: both ends are stamped by the same driver, so the result is sample exact.
+	class LatencyCalibrator
+	{
+	public:
+		struct Settings
+		{
+			int runs = 8;
+			uint32_t note = 60;
+			uint32_t velocity = 100;
+			uint32_t channel = 0;
+			double preRollSeconds = 0.05;  // noise floor captured before the note
+			double captureSeconds = 0.5;   // longest round trip that can be measured
+			double releaseSeconds = 0.25;  // silence after each note-off before the next run
+			double outlierThreshold = 3.0; // in scaled median absolute deviations
+			float impulseLevel = 0.5f;	   // insert loop: test impulse on the outputs (-6 dBFS)
+			int captureOutput = 0;		   // ASIO output channel (bus * 2 + side) whose capture carries the synth
+		};
+
+		struct OnsetOptions
+		{
+			float noiseMargin = 4.0f;	   // gate above the pre-roll peak (+12 dB)
+			float attackFraction = 0.1f; // crossing level as a fraction of the signal peak
+			float minSignalToNoise = 8.0f;
+			uint32_t maxGapFrames = 48; // zero crossings tolerated while walking back to the attack start
+		};
+
+		struct Result
+		{
+			bool success = false;
+			int runs = 0;
+			int detected = 0; // runs where an onset was found
+			int accepted = 0; // detected runs kept after outlier rejection
+			double medianSeconds = 0.0;
+			double minSeconds = 0.0;
+			double maxSeconds = 0.0;
+			double jitterSeconds = 0.0; // max - min of the accepted runs
+			double stdDevSeconds = 0.0;
+			std::vector<double> measurements; // every detected run, in order
+		};
+
+		// Blocks for about runs * (preRoll + capture + release) seconds; call it from a control thread
+		// with the ASIO stream running. Nothing else should play the synth meanwhile.
+		static Result run(HardwareSynthesizer &synth, AsioInterface &asio, const Settings &settings);
+
+		// ASIO insert output -> outboard effect -> ASIO capture, for an AsioInterface in insert mode. The
+		// insert outputs are muted for the duration; the effect should pass a click through (no gate).
+		static Result runInsertLoop(AsioInterface &asio, const Settings &settings);
+
+		// Index of the attack at or after `startIndex`, judged against the noise in [0, startIndex);
+		// -1 when nothing stands out of the noise.
+		static int64_t findOnset(const float *samples, uint32_t count, uint32_t startIndex, const OnsetOptions &options);
+
+		// Outlier rejection and statistics over a set of measurements.
+		static Result summarize(const std::vector<double> &measurements, double outlierThreshold);
+	};
+
+	//------------------------------------------------------------------------
+} // namespace Newkon
@@ -0,0 +1,48 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Newkon.
+//------------------------------------------------------------------------
+
+#include "LatencyCompensator.h"
+#include <cmath>
+
+namespace Newkon
+{
+
+	//------------------------------------------------------------------------
+	LatencyCompensator::Plan LatencyCompensator::compute(const Inputs &inputs)
+	{
+		Plan plan;
+		const double hostRate = inputs.hostSampleRate > 0.0 ? inputs.hostSampleRate : 44100.0;
+		// Without a running ASIO stream assume the device follows the host
+		const double deviceRate = inputs.deviceSampleRate > 0.0 ? inputs.deviceSampleRate : hostRate;
+		const double deviceBuffer = inputs.deviceBufferFrames > 0 ? static_cast<double>(inputs.deviceBufferFrames) : 0.0;
+		const double hostBlock = inputs.hostBlockSize > 0 ? static_cast<double>(inputs.hostBlockSize) : 0.0;
+
+		const double ringRate = inputs.ringSampleRate > 0.0 ? inputs.ringSampleRate : deviceRate;
+
+		// The ring must always hold a full host block when process() asks, even right before the next
+		// device buffer lands
+		const double ringDelay = std::ceil(hostBlock * ringRate / hostRate) + std::ceil(deviceBuffer * ringRate / deviceRate);
+		plan.ringDelayFrames = static_cast<uint32_t>(ringDelay);
+
+		if (inputs.insert)
+		{
+			// The send ring runs unconverted at the device rate, on the same rule as the capture ring
+			const double sendDelay = hostBlock + deviceBuffer;
+			const double loop = inputs.insertLoopSeconds > 0.0 ? inputs.insertLoopSeconds : 0.0;
+			plan.sendDelayFrames = static_cast<uint32_t>(sendDelay);
+			plan.reportedLatencySeconds = sendDelay / deviceRate + loop + ringDelay / ringRate;
+			plan.reportedLatencySamples = static_cast<uint32_t>(std::lround(plan.reportedLatencySeconds * hostRate));
+			return plan;
+		}
+
+		const double dispatchOffset = inputs.deviceFrameStamping ? deviceBuffer : deviceBuffer * 0.5;
+		const double hardware = inputs.hardwareLatencySeconds > 0.0 ? inputs.hardwareLatencySeconds : 0.0;
+		const double conversion = inputs.rateConversionDelaySeconds > 0.0 ? inputs.rateConversionDelaySeconds : 0.0;
+		plan.reportedLatencySeconds = hardware + dispatchOffset / deviceRate + ringDelay / ringRate + conversion;
+		plan.reportedLatencySamples = static_cast<uint32_t>(std::lround(plan.reportedLatencySeconds * hostRate));
+		return plan;
+	}
+
+	//------------------------------------------------------------------------
+} // namespace Newkon
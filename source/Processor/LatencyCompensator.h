@@ -0,0 +1,64 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Newkon.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+
+namespace Newkon
+{
+
+	//------------------------------------------------------------------------
+	//  LatencyCompensator
+	//------------------------------------------------------------------------
+	// Works out how far behind the ASIO write head the host must read, and how much latency to report,
+	// so that a note sent the moment the host hands it to us comes back exactly reportedLatency later.
+	//
+	//   reported latency = hardware round trip + dispatch offset + ring delay
+	//
+	// hardware round trip: MIDI out -> synth -> ASIO capture, as set by the user or measured.
+	// dispatch offset:     where in the device period events leave; one full period when stamped on the
+	//                      ASIO sample clock, half a period on average with host wall-clock stamps.
+	// ring delay:          frames held in RingBufferFloat so every host block can be served
+	//                      (one host block plus one device buffer), counted at the ring's rate.
+	// rate conversion:     group delay of the device-to-host resampler, when the rates differ.
+	//
+	// As a hardware insert the host's own audio makes the trip instead of a note, and the MIDI terms
+	// give way to the send side:
+	//
+	//   reported latency = send delay + insert loop + ring delay
+	//
+	// send delay:  frames held in the send ring so every device buffer can be served (one host block
+	//              plus one device buffer, as the ring delay).
+	// insert loop: ASIO output -> outboard effect -> ASIO capture, measured on the device clock.
+	class LatencyCompensator
+	{
+	public:
+		struct Inputs
+		{
+			double hardwareLatencySeconds = 0.0;
+			double hostSampleRate = 44100.0;
+			int32_t hostBlockSize = 512;
+			double deviceSampleRate = 0.0; // 0 when no ASIO stream is configured
+			int32_t deviceBufferFrames = 0;
+			bool deviceFrameStamping = false;
+			double ringSampleRate = 0.0; // rate of the frames in the ring; 0 when it follows the device
+			double rateConversionDelaySeconds = 0.0;
+			bool insert = false; // the stream drives insert outputs
+			double insertLoopSeconds = 0.0;
+		};
+
+		struct Plan
+		{
+			uint32_t ringDelayFrames = 0;			 // ring frames between ASIO write head and host read head
+			uint32_t sendDelayFrames = 0;			 // insert: send ring frames between host write head and ASIO drain head
+			uint32_t reportedLatencySamples = 0; // host samples, for getLatencySamples()
+			double reportedLatencySeconds = 0.0;
+		};
+
+		static Plan compute(const Inputs &inputs);
+	};
+
+	//------------------------------------------------------------------------
+} // namespace Newkon
@@ -0,0 +1,259 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Newkon.
+//------------------------------------------------------------------------
+
+#include "LatencyTracker.h"
+#include "./HardwareSynthesizer/HardwareSynthesizer.h"
+#include "./Asio/AsioInterface.h"
+#include "./Asio/CaptureTap.h"
+#include "../Logger.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Newkon
+{
+
+	//------------------------------------------------------------------------
+	LatencyTracker::LatencyTracker()
+	{
+		// Notes in a session rarely start from silence: accept a smaller rise than calibration does
+		onsetOptions.noiseMargin = 2.0f;
+		onsetOptions.attackFraction = 0.2f;
+		onsetOptions.minSignalToNoise = 4.0f;
+	}
+
+	//------------------------------------------------------------------------
+	LatencyTracker::~LatencyTracker()
+	{
+		stop();
+	}
+
+	//------------------------------------------------------------------------
+	void LatencyTracker::start(AsioInterface &asioInterface, const std::vector<Source> &sources, const Settings &newSettings)
+	{
+		stop();
+
+		asio = &asioInterface;
+		settings = newSettings;
+		planes.clear();
+		{
+			std::lock_guard<std::mutex> lock(statsMutex);
+			devices.clear();
+			for (const Source &source : sources)
+			{
+				// Synthesizers returning on the same plane share its tap
+				uint32_t p = 0;
+				while (p < planes.size() && planes[p].output != source.captureOutput)
+					p++;
+				if (p == planes.size())
+				{
+					Plane plane;
+					plane.output = source.captureOutput;
+					plane.capture = std::make_unique<CaptureTap>(kCaptureCapacity);
+					planes.push_back(std::move(plane));
+				}
+
+				DeviceState device;
+				device.synth = source.synth;
+				device.plane = p;
+				device.stats.deviceName = source.synth->getDeviceName();
+				devices.push_back(std::move(device));
+			}
+		}
+
+		// The logs are cleared here, before the worker becomes their consumer
+		for (DeviceState &device : devices)
+			device.synth->setDispatchLogging(true);
+		for (Plane &plane : planes)
+			asio->setAnalysisTap(plane.output, plane.capture.get());
+
+		running.store(true, std::memory_order_relaxed);
+		worker = std::thread(&LatencyTracker::run, this);
+		Logger::getInstance() << "Latency tracking started for " << devices.size() << " synthesizer(s) on " << planes.size() << " capture plane(s)" << std::endl;
+	}
+
+	//------------------------------------------------------------------------
+	void LatencyTracker::stop()
+	{
+		if (!running.exchange(false))
+			return;
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex);
+		}
+		wake.notify_all();
+		if (worker.joinable())
+			worker.join();
+
+		for (Plane &plane : planes)
+			asio->setAnalysisTap(plane.output, nullptr);
+		for (DeviceState &device : devices)
+		{
+			device.synth->setDispatchLogging(false);
+			device.synth = nullptr;
+		}
+		for (Plane &plane : planes)
+			plane.pending.clear();
+	}
+
+	//------------------------------------------------------------------------
+	std::vector<LatencyTracker::DeviceStats> LatencyTracker::getStats() const
+	{
+		std::lock_guard<std::mutex> lock(statsMutex);
+		std::vector<DeviceStats> stats;
+		for (const DeviceState &device : devices)
+			stats.push_back(device.stats);
+		return stats;
+	}
+
+	//------------------------------------------------------------------------
+	void LatencyTracker::run()
+	{
+		while (running.load(std::memory_order_relaxed))
+		{
+			collectNoteOns();
+			for (Plane &plane : planes)
+				analyzePending(plane);
+
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			wake.wait_for(lock, kAnalysisInterval, [&]
+						  { return !running.load(std::memory_order_relaxed); });
+		}
+	}
+
+	//------------------------------------------------------------------------
+	void LatencyTracker::collectNoteOns()
+	{
+		const AsioClock &clock = asio->getSampleClock();
+		const double rate = clock.sampleRate();
+
+		// Logs are per synthesizer; put the notes back in send order before judging isolation
+		std::vector<Stimulus> collected;
+		MIDIEventQueue::Event event;
+		for (uint32_t d = 0; d < devices.size(); d++)
+		{
+			while (devices[d].synth->popDispatchedNoteOn(event))
+			{
+				int64_t frame = 0;
+				if (clock.frameAt(event.when, frame))
+					collected.push_back(Stimulus{frame, d});
+			}
+		}
+		std::sort(collected.begin(), collected.end(), [](const Stimulus &a, const Stimulus &b)
+				  { return a.frame < b.frame; });
+
+		const int64_t isolationFrames = static_cast<int64_t>(settings.isolationSeconds * rate);
+		std::lock_guard<std::mutex> lock(statsMutex);
+		for (const Stimulus &stimulus : collected)
+		{
+			// Only notes heard on the same plane can be confused with each other
+			Plane &plane = planes[devices[stimulus.device].plane];
+			std::deque<Stimulus> &pending = plane.pending;
+			devices[stimulus.device].stats.noteOns++;
+			const bool crowded = plane.haveLastNote && stimulus.frame - plane.lastNoteFrame < isolationFrames;
+			if (crowded && !pending.empty() && pending.back().frame == plane.lastNoteFrame)
+			{
+				// A faster synth could sound the new note before the previous one: neither can be trusted
+				devices[pending.back().device].stats.skipped++;
+				pending.pop_back();
+			}
+			plane.lastNoteFrame = stimulus.frame;
+			plane.haveLastNote = true;
+			if (crowded)
+			{
+				devices[stimulus.device].stats.skipped++;
+				continue;
+			}
+			if (pending.size() == kMaxPending)
+			{
+				devices[pending.front().device].stats.unmatched++;
+				pending.pop_front();
+			}
+			pending.push_back(stimulus);
+		}
+	}
+
+	//------------------------------------------------------------------------
+	void LatencyTracker::analyzePending(Plane &plane)
+	{
+		const double rate = asio->getSampleClock().sampleRate();
+		CaptureTap &capture = *plane.capture;
+		std::deque<Stimulus> &pending = plane.pending;
+		const int64_t end = capture.endFrame();
+		if (rate <= 0.0 || end == CaptureTap::kNoFrame)
+			return;
+
+		const uint32_t preRoll = static_cast<uint32_t>(std::max(1.0, settings.preRollSeconds * rate));
+		const uint32_t span = static_cast<uint32_t>(std::max(1.0, settings.maxLatencySeconds * rate));
+		window.resize(preRoll + span);
+
+		while (!pending.empty() && pending.front().frame + span <= end)
+		{
+			const Stimulus stimulus = pending.front();
+			pending.pop_front();
+			DeviceState &device = devices[stimulus.device];
+
+			int64_t onset = -1;
+			if (capture.read(stimulus.frame - preRoll, window.data(), preRoll + span))
+				onset = LatencyCalibrator::findOnset(window.data(), preRoll + span, preRoll, onsetOptions);
+			if (onset < 0)
+			{
+				std::lock_guard<std::mutex> lock(statsMutex);
+				device.stats.unmatched++;
+				continue;
+			}
+			record(device, static_cast<double>(onset - preRoll) / rate);
+		}
+	}
+
+	//------------------------------------------------------------------------
+	void LatencyTracker::record(DeviceState &device, double seconds)
+	{
+		std::lock_guard<std::mutex> lock(statsMutex);
+		DeviceStats &stats = device.stats;
+
+		stats.matched++;
+		device.sum += seconds;
+		stats.meanSeconds = device.sum / static_cast<double>(stats.matched);
+		stats.minSeconds = stats.matched == 1 ? seconds : std::min(stats.minSeconds, seconds);
+		stats.maxSeconds = stats.matched == 1 ? seconds : std::max(stats.maxSeconds, seconds);
+		const int latencyBin = std::min(kLatencyBins - 1, static_cast<int>(seconds / kLatencyBinSeconds));
+		stats.latencyHistogram[latencyBin]++;
+
+		if (stats.matched == 1)
+		{
+			stats.recentSeconds = seconds;
+		}
+		else
+		{
+			const double deviation = std::fabs(seconds - stats.recentSeconds);
+			stats.jitterHistogram[std::min(kJitterBins - 1, static_cast<int>(deviation / kJitterBinSeconds))]++;
+			stats.recentSeconds += settings.recentWeight * (seconds - stats.recentSeconds);
+		}
+
+		if (static_cast<int>(device.baseline.size()) < settings.baselineMatches)
+		{
+			device.baseline.push_back(seconds);
+			if (static_cast<int>(device.baseline.size()) == settings.baselineMatches)
+			{
+				std::vector<double> sorted = device.baseline;
+				std::sort(sorted.begin(), sorted.end());
+				stats.baselineSeconds = sorted[sorted.size() / 2];
+				Logger::getInstance() << "Latency baseline for " << stats.deviceName << ": " << stats.baselineSeconds * 1000.0 << " ms" << std::endl;
+			}
+			return;
+		}
+
+		const bool drifting = std::fabs(stats.recentSeconds - stats.baselineSeconds) > settings.driftThresholdSeconds;
+		if (drifting != stats.drifting)
+		{
+			stats.drifting = drifting;
+			if (drifting)
+				Logger::getInstance() << "Latency drift on " << stats.deviceName << ": " << stats.recentSeconds * 1000.0
+									  << " ms against a baseline of " << stats.baselineSeconds * 1000.0 << " ms" << std::endl;
+			else
+				Logger::getInstance() << "Latency back to baseline on " << stats.deviceName << std::endl;
+		}
+	}
+
+	//------------------------------------------------------------------------
+} // namespace Newkon
@@ -0,0 +1,146 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Newkon.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LatencyCalibrator.h"
+
+namespace Newkon
+{
+	class HardwareSynthesizer;
+	class AsioInterface;
+	class CaptureTap;
+
+	//------------------------------------------------------------------------
+	//  LatencyTracker
+	//------------------------------------------------------------------------
+	// Keeps measuring the round trip during a session. Each synthesizer's scheduler logs the note-ons
+	// it actually sent; a background thread maps them to device frames, reads the capture around each
+	// one from an ASIO analysis tap on the plane that synthesizer returns on, and pairs it with the
+	// onset that follows (LatencyCalibrator's detector). Notes sent less than `isolationSeconds` after
+	// another one heard on the same plane are skipped, since their onset could belong to either. Per
+	// synthesizer it keeps latency and jitter histograms and flags drift once the recent average moves
+	// away from the baseline set by the first matches.
+	// Nothing here runs on the audio or ASIO threads beyond the two lock-free taps.
+	class LatencyTracker
+	{
+	public:
+		static constexpr int kLatencyBins = 128; // 0.5 ms each, the last one open-ended
+		static constexpr double kLatencyBinSeconds = 0.0005;
+		static constexpr int kJitterBins = 64; // 0.1 ms each, the last one open-ended
+		static constexpr double kJitterBinSeconds = 0.0001;
+
+		struct Settings
+		{
+			double maxLatencySeconds = 0.1;
+			double preRollSeconds = 0.02;
+			double isolationSeconds = 0.15;
+			double driftThresholdSeconds = 0.001;
+			int baselineMatches = 16;
+			double recentWeight = 0.1; // weight of each new match in the recent average
+		};
+
+		struct DeviceStats
+		{
+			std::string deviceName;
+			uint64_t noteOns = 0;	  // note-ons logged by the scheduler
+			uint64_t skipped = 0;	  // too close to another note to attribute an onset
+			uint64_t matched = 0;	  // paired with an onset
+			uint64_t unmatched = 0; // no onset found, or the capture was gone
+			double minSeconds = 0.0;
+			double maxSeconds = 0.0;
+			double meanSeconds = 0.0;
+			double baselineSeconds = 0.0; // median of the first baselineMatches matches
+			double recentSeconds = 0.0;	  // moving average of recent matches
+			bool drifting = false;
+			uint32_t latencyHistogram[kLatencyBins] = {};
+			uint32_t jitterHistogram[kJitterBins] = {}; // |match - recent average|
+		};
+
+		LatencyTracker();
+		~LatencyTracker();
+
+		LatencyTracker(const LatencyTracker &) = delete;
+		LatencyTracker &operator=(const LatencyTracker &) = delete;
+
+		// A synthesizer and the ASIO output channel (bus * 2 + side) whose capture plane carries its audio
+		struct Source
+		{
+			HardwareSynthesizer *synth = nullptr;
+			int captureOutput = 0;
+		};
+
+		// Control thread. The synthesizers and the interface must outlive stop(). Restarting clears the stats.
+		void start(AsioInterface &asio, const std::vector<Source> &sources, const Settings &settings);
+		void start(AsioInterface &asio, const std::vector<Source> &sources) { start(asio, sources, Settings()); }
+		void stop();
+		bool isRunning() const { return running.load(std::memory_order_relaxed); }
+
+		// One entry per synthesizer, in the order given to start()
+		std::vector<DeviceStats> getStats() const;
+
+	private:
+		struct Stimulus
+		{
+			int64_t frame;
+			uint32_t device;
+		};
+
+		// One analysis tap per distinct capture output; pending notes and isolation are per plane
+		struct Plane
+		{
+			int output = 0;
+			std::unique_ptr<CaptureTap> capture;
+			std::deque<Stimulus> pending;
+			int64_t lastNoteFrame = 0;
+			bool haveLastNote = false;
+		};
+
+		struct DeviceState
+		{
+			HardwareSynthesizer *synth = nullptr;
+			uint32_t plane = 0;
+			DeviceStats stats;
+			std::vector<double> baseline;
+			double sum = 0.0;
+		};
+
+		static constexpr uint32_t kCaptureCapacity = 1u << 18;
+		static constexpr std::chrono::milliseconds kAnalysisInterval{20};
+		static constexpr size_t kMaxPending = 256;
+
+		void run();
+		void collectNoteOns();
+		void analyzePending(Plane &plane);
+		void record(DeviceState &device, double seconds);
+
+		AsioInterface *asio = nullptr;
+		std::vector<Plane> planes;
+		Settings settings;
+		LatencyCalibrator::OnsetOptions onsetOptions;
+
+		std::vector<DeviceState> devices; // stats guarded by statsMutex, the rest by the tracker thread
+		mutable std::mutex statsMutex;
+
+		std::vector<float> window;
+
+		std::atomic<bool> running{false};
+		std::thread worker;
+		std::mutex wakeMutex;
+		std::condition_variable wake;
+	};
+
+	//------------------------------------------------------------------------
+} // namespace Newkon
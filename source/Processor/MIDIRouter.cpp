@@ -0,0 +1,263 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Newkon.
+//------------------------------------------------------------------------
+
+#include "MIDIRouter.h"
+#include "./HardwareSynthesizer/HardwareSynthesizer.h"
+#include <immintrin.h>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+namespace Newkon
+{
+
+	//------------------------------------------------------------------------
+	MIDIRouter::MIDIRouter() : table(std::make_unique<Table>()) {}
+
+	//------------------------------------------------------------------------
+	MIDIRouter::~MIDIRouter() = default;
+
+	//------------------------------------------------------------------------
+	uint32_t MIDIRouter::outputChannel(const Route &route, uint32_t inputChannel)
+	{
+		return route.outputChannel == kSameChannel ? inputChannel : static_cast<uint32_t>(route.outputChannel) & 0x0F;
+	}
+
+	//------------------------------------------------------------------------
+	std::unique_ptr<MIDIRouter::Table> MIDIRouter::compile(const std::vector<HardwareSynthesizer *> &synths, const std::vector<Route> &routes)
+	{
+		auto t = std::make_unique<Table>();
+		for (HardwareSynthesizer *synth : synths)
+		{
+			if (t->synthCount == kMaxSynths)
+				break;
+			t->synths[t->synthCount++] = synth;
+		}
+
+		for (Route route : routes)
+		{
+			if (t->routeCount == kMaxRoutes)
+				break;
+			if (route.synth >= t->synthCount)
+				continue;
+			if (route.inputChannel != kAnyChannel)
+				route.inputChannel &= 0x0F;
+			route.lowKey &= 0x7F;
+			route.highKey &= 0x7F;
+			if (route.lowKey > route.highKey)
+				std::swap(route.lowKey, route.highKey);
+			route.lowVelocity = static_cast<uint8_t>((route.lowVelocity & 0x7F) ? (route.lowVelocity & 0x7F) : 1);
+			route.highVelocity &= 0x7F;
+			if (route.lowVelocity > route.highVelocity)
+				std::swap(route.lowVelocity, route.highVelocity);
+			t->routes[t->routeCount++] = route;
+		}
+
+		for (uint32_t channel = 0; channel < kChannels; channel++)
+		{
+			uint32_t channelRoutes[kMaxRoutes];
+			uint32_t channelRouteCount = 0;
+			for (uint32_t r = 0; r < t->routeCount; r++)
+			{
+				const Route &route = t->routes[r];
+				if (route.inputChannel == kAnyChannel || route.inputChannel == channel)
+					channelRoutes[channelRouteCount++] = r;
+			}
+
+			// Keep one route per (synth, output channel) so layered ranges never double a message
+			auto addUnique = [&](uint32_t mask, uint32_t r)
+			{
+				for (uint32_t other = 0; other < t->routeCount; other++)
+				{
+					if ((mask & (1u << other)) && t->routes[other].synth == t->routes[r].synth &&
+							outputChannel(t->routes[other], channel) == outputChannel(t->routes[r], channel))
+						return mask;
+				}
+				return mask | (1u << r);
+			};
+
+			uint32_t controlMask = 0;
+			for (uint32_t i = 0; i < channelRouteCount; i++)
+				controlMask = addUnique(controlMask, channelRoutes[i]);
+			t->controlRoutes[channel] = controlMask;
+
+			for (uint32_t note = 0; note < kNotes; note++)
+			{
+				uint32_t keyRoutes[kMaxRoutes];
+				uint32_t keyRouteCount = 0;
+				for (uint32_t i = 0; i < channelRouteCount; i++)
+				{
+					const Route &route = t->routes[channelRoutes[i]];
+					if (note >= route.lowKey && note <= route.highKey)
+						keyRoutes[keyRouteCount++] = channelRoutes[i];
+				}
+
+				KeyZones &zones = t->keys[channel][note];
+				zones.firstZone = static_cast<uint32_t>(t->zones.size());
+				if (keyRouteCount == 0)
+					continue;
+
+				// Run-length encode the destination mask over velocities 1-127
+				for (uint32_t velocity = 1; velocity <= 127; velocity++)
+				{
+					uint32_t mask = 0;
+					for (uint32_t i = 0; i < keyRouteCount; i++)
+					{
+						const Route &route = t->routes[keyRoutes[i]];
+						if (velocity >= route.lowVelocity && velocity <= route.highVelocity)
+							mask = addUnique(mask, keyRoutes[i]);
+					}
+					if (zones.zoneCount > 0 && t->zones.back().routes == mask)
+						t->zones.back().topVelocity = static_cast<uint8_t>(velocity);
+					else
+					{
+						t->zones.push_back(Zone{static_cast<uint8_t>(velocity), mask});
+						zones.zoneCount++;
+					}
+				}
+			}
+		}
+		return t;
+	}
+
+	//------------------------------------------------------------------------
+	void MIDIRouter::configure(const std::vector<HardwareSynthesizer *> &synths, const std::vector<Route> &routes)
+	{
+		// Compile outside the lock: only the swap has to wait for the audio thread
+		std::unique_ptr<Table> compiled = compile(synths, routes);
+
+		uint32_t released[kChannels][kNotes];
+		while (blockLock.test_and_set(std::memory_order_acquire))
+			std::this_thread::yield();
+		std::memcpy(released, heldNotes, sizeof(heldNotes));
+		std::memset(heldNotes, 0, sizeof(heldNotes));
+		table.swap(compiled);
+		blockLock.clear(std::memory_order_release);
+
+		// The note-offs go out after the lock is released, so the audio thread never waits on the queue
+		// pushes. `compiled` now holds the previous table, whose synths are still alive: the caller only
+		// destroys them once configure() returns.
+		releaseNotes(*compiled, released);
+	}
+
+	//------------------------------------------------------------------------
+	void MIDIRouter::releaseNotes(const Table &previous, const uint32_t (&held)[kChannels][kNotes])
+	{
+		for (uint32_t channel = 0; channel < kChannels; channel++)
+		{
+			for (uint32_t note = 0; note < kNotes; note++)
+			{
+				uint32_t mask = held[channel][note];
+				for (uint32_t r = 0; mask; r++, mask >>= 1)
+				{
+					if (!(mask & 1u))
+						continue;
+					const Route &route = previous.routes[r];
+					// The immediate path: the scheduled one belongs to the audio thread
+					previous.synths[route.synth]->sendMIDINoteOff(note, outputChannel(route, channel));
+				}
+			}
+		}
+	}
+
+	//------------------------------------------------------------------------
+	void MIDIRouter::lockBlock()
+	{
+		// Only contended while configure() copies the held notes and swaps tables, which takes microseconds
+		while (blockLock.test_and_set(std::memory_order_acquire))
+			_mm_pause();
+	}
+
+	//------------------------------------------------------------------------
+	void MIDIRouter::unlockBlock()
+	{
+		blockLock.clear(std::memory_order_release);
+	}
+
+	//------------------------------------------------------------------------
+	void MIDIRouter::noteOn(uint32_t channel, uint32_t note, uint32_t velocity, const EventTime &time)
+	{
+		channel &= 0x0F;
+		note &= 0x7F;
+		velocity = velocity < 1 ? 1 : (velocity > 127 ? 127 : velocity);
+
+		const KeyZones &zones = table->keys[channel][note];
+		uint32_t mask = 0;
+		for (uint32_t i = 0; i < zones.zoneCount; i++)
+		{
+			const Zone &zone = table->zones[zones.firstZone + i];
+			if (velocity <= zone.topVelocity)
+			{
+				mask = zone.routes;
+				break;
+			}
+		}
+		heldNotes[channel][note] |= mask;
+
+		for (uint32_t r = 0; mask; r++, mask >>= 1)
+		{
+			if (!(mask & 1u))
+				continue;
+			const Route &route = table->routes[r];
+			HardwareSynthesizer *synth = table->synths[route.synth];
+			const UINT out = outputChannel(route, channel);
+			if (time.useDeviceFrame)
+				synth->scheduleMIDINoteAtFrame(note, velocity, out, time.deviceFrame);
+			else
+				synth->scheduleMIDINoteAt(note, velocity, out, time.when);
+		}
+	}
+
+	//------------------------------------------------------------------------
+	void MIDIRouter::noteOff(uint32_t channel, uint32_t note, const EventTime &time)
+	{
+		channel &= 0x0F;
+		note &= 0x7F;
+
+		// Wherever the note-on went, whatever the routing says now
+		uint32_t mask = heldNotes[channel][note];
+		heldNotes[channel][note] = 0;
+
+		for (uint32_t r = 0; mask; r++, mask >>= 1)
+		{
+			if (!(mask & 1u))
+				continue;
+			const Route &route = table->routes[r];
+			HardwareSynthesizer *synth = table->synths[route.synth];
+			const UINT out = outputChannel(route, channel);
+			if (time.useDeviceFrame)
+				synth->scheduleMIDINoteOffAtFrame(note, out, time.deviceFrame);
+			else
+				synth->scheduleMIDINoteOffAt(note, out, time.when);
+		}
+	}
+
+	//------------------------------------------------------------------------
+	void MIDIRouter::controlChange(uint32_t channel, uint32_t controller, uint32_t value, const EventTime &time)
+	{
+		channel &= 0x0F;
+		uint32_t mask = table->controlRoutes[channel];
+		for (uint32_t r = 0; mask; r++, mask >>= 1)
+		{
+			if (!(mask & 1u))
+				continue;
+			const Route &route = table->routes[r];
+			HardwareSynthesizer *synth = table->synths[route.synth];
+			const UINT out = outputChannel(route, channel);
+			if (time.useDeviceFrame)
+				synth->scheduleMIDIControlChangeAtFrame(controller, value, out, time.deviceFrame);
+			else
+				synth->scheduleMIDIControlChangeAt(controller, value, out, time.when);
+		}
+	}
+
+	//------------------------------------------------------------------------
+	void MIDIRouter::flushControlChanges()
+	{
+		for (uint32_t i = 0; i < table->synthCount; i++)
+			table->synths[i]->flushControlChanges();
+	}
+
+	//------------------------------------------------------------------------
+} // namespace Newkon
@@ -0,0 +1,124 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Newkon.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace Newkon
+{
+	class HardwareSynthesizer;
+
+	//------------------------------------------------------------------------
+	//  MIDIRouter
+	//------------------------------------------------------------------------
+	// Splits and layers incoming MIDI across several hardware synthesizers.
+	// Routes (input channel, key range, velocity range -> synth, output channel) are compiled on the
+	// control thread into a per-channel, per-note table of velocity zones, so the audio thread does a
+	// bounded lookup per event whatever the number of routes. Note-offs follow the destinations their
+	// note-on went to, even if the key or velocity ranges would now route them elsewhere.
+	class MIDIRouter
+	{
+	public:
+		static constexpr uint32_t kMaxSynths = 16;
+		static constexpr uint32_t kMaxRoutes = 32;
+		static constexpr uint8_t kAnyChannel = 0xFF;
+		static constexpr int8_t kSameChannel = -1;
+
+		struct Route
+		{
+			uint8_t inputChannel = kAnyChannel; // 0-15, or kAnyChannel
+			uint8_t lowKey = 0;
+			uint8_t highKey = 127;
+			uint8_t lowVelocity = 1;
+			uint8_t highVelocity = 127;
+			uint8_t synth = 0;						 // index into the synthesizer set
+			int8_t outputChannel = kSameChannel; // 0-15, or kSameChannel
+		};
+
+		// When an event is due: on the host wall clock or on the ASIO sample clock
+		struct EventTime
+		{
+			std::chrono::steady_clock::time_point when;
+			int64_t deviceFrame = 0;
+			bool useDeviceFrame = false;
+		};
+
+		// Held by the audio thread for the duration of one block's events; configure() waits for it
+		class BlockLock
+		{
+		public:
+			explicit BlockLock(MIDIRouter &router) : router(router) { router.lockBlock(); }
+			~BlockLock() { router.unlockBlock(); }
+
+		private:
+			MIDIRouter &router;
+		};
+
+		MIDIRouter();
+		~MIDIRouter();
+
+		MIDIRouter(const MIDIRouter &) = delete;
+		MIDIRouter &operator=(const MIDIRouter &) = delete;
+
+		// Control thread. Compiles the routes, then swaps them in between two audio blocks, releasing
+		// every note held under the previous routing. Routes to a synth index outside `synths` are ignored,
+		// as are routes past kMaxRoutes and synths past kMaxSynths.
+		void configure(const std::vector<HardwareSynthesizer *> &synths, const std::vector<Route> &routes);
+
+		// Audio thread, inside a BlockLock.
+		bool hasSynthesizers() const { return table->synthCount > 0; }
+		void noteOn(uint32_t channel, uint32_t note, uint32_t velocity, const EventTime &time);
+		void noteOff(uint32_t channel, uint32_t note, const EventTime &time);
+		void controlChange(uint32_t channel, uint32_t controller, uint32_t value, const EventTime &time);
+		void flushControlChanges();
+
+	private:
+		static constexpr uint32_t kChannels = 16;
+		static constexpr uint32_t kNotes = 128;
+
+		struct Zone
+		{
+			uint8_t topVelocity; // zone covers velocities above the previous zone's top, up to this one
+			uint32_t routes;		 // bit per route, one route per destination
+		};
+
+		struct KeyZones
+		{
+			uint32_t firstZone = 0;
+			uint32_t zoneCount = 0;
+		};
+
+		struct Table
+		{
+			HardwareSynthesizer *synths[kMaxSynths] = {};
+			uint32_t synthCount = 0;
+			Route routes[kMaxRoutes];
+			uint32_t routeCount = 0;
+			KeyZones keys[kChannels][kNotes];
+			std::vector<Zone> zones;
+			uint32_t controlRoutes[kChannels] = {}; // one route per destination listening on the channel
+		};
+
+		static std::unique_ptr<Table> compile(const std::vector<HardwareSynthesizer *> &synths, const std::vector<Route> &routes);
+		static uint32_t outputChannel(const Route &route, uint32_t inputChannel);
+
+		// Control thread, outside the lock: note-offs for the notes `held` under the `previous` table
+		static void releaseNotes(const Table &previous, const uint32_t (&held)[kChannels][kNotes]);
+		void lockBlock();
+		void unlockBlock();
+
+		std::unique_ptr<Table> table;
+		// Routes each sounding note was sent to, per input channel and key; audio thread (or configure()
+		// under the lock)
+		uint32_t heldNotes[kChannels][kNotes] = {};
+		std::atomic_flag blockLock = ATOMIC_FLAG_INIT;
+	};
+
+	//------------------------------------------------------------------------
+} // namespace Newkon
@@ -9,16 +9,48 @@
 #include "public.sdk/source/vst/vstparameters.h"
 
 #include "../Logger.h"
+#include "../TraceLogger.h"
 #include "./HardwareSynthesizer/MIDIDevices.h"
 
 #include "Processor.h"
 #include "../cids.h"
 #include <immintrin.h>
+#include <cmath>
 
 using namespace Steinberg;
 
 namespace Newkon
 {
+	namespace
+	{
+		inline float **busChannelBuffers(Vst::AudioBusBuffers &bus, float *) { return bus.channelBuffers32; }
+		inline double **busChannelBuffers(Vst::AudioBusBuffers &bus, double *) { return bus.channelBuffers64; }
+
+		// Bus b channel c becomes ASIO output b * kChannelsPerBus + c; `discard` stands in for channels the
+		// host passes without a buffer. Stops at the first bus it cannot fill and returns the channel count.
+		template <typename Sample>
+		int gatherOutputChannels(Vst::ProcessData &data, int32 buses, std::vector<Sample> &discard, Sample **channels)
+		{
+			constexpr int kChannelsPerBus = HardwareSynthProcessor::kChannelsPerBus;
+			Sample *const discardData = discard.size() >= static_cast<size_t>(data.numSamples) ? discard.data() : nullptr;
+			int outputs = 0;
+			for (int32 b = 0; b < buses; b++)
+			{
+				Vst::AudioBusBuffers &bus = data.outputs[b];
+				Sample **buffers = busChannelBuffers(bus, static_cast<Sample *>(nullptr));
+				for (int32 c = 0; c < kChannelsPerBus; c++)
+				{
+					Sample *buffer = (c < bus.numChannels && buffers) ? buffers[c] : nullptr;
+					channels[b * kChannelsPerBus + c] = buffer ? buffer : discardData;
+				}
+				if (!channels[b * kChannelsPerBus] || !channels[b * kChannelsPerBus + 1])
+					break;
+				outputs = (b + 1) * kChannelsPerBus;
+			}
+			return outputs;
+		}
+	}
+
 	// Static member initialization
 	HardwareSynthProcessor *HardwareSynthProcessor::currentInstance = nullptr;
 	//------------------------------------------------------------------------
@@ -36,6 +68,12 @@ namespace Newkon
 	//------------------------------------------------------------------------
 	HardwareSynthProcessor::~HardwareSynthProcessor()
 	{
+		// The tracker reads the synthesizers and the ASIO tap, and the schedulers read asioInterface's
+		// sample clock: stop both first
+		latencyTracking = false;
+		latencyTracker.stop();
+		disconnectSynthesizer();
+
 		// Clear static instance reference
 		if (currentInstance == this)
 		{
@@ -60,15 +98,30 @@ namespace Newkon
 		// Add audio input bus for ASIO interface audio
 		addAudioInput(STR16("ASIO Input"), Steinberg::Vst::SpeakerArr::kStereo);
 		addAudioOutput(STR16("Stereo Out"), Steinberg::Vst::SpeakerArr::kStereo);
+		// One auxiliary bus per further hardware unit, inactive until the host enables it
+		static const Vst::TChar *const auxOutputNames[kOutputBuses - 1] = {
+			STR16("Synth 2 Out"), STR16("Synth 3 Out"), STR16("Synth 4 Out"), STR16("Synth 5 Out"),
+			STR16("Synth 6 Out"), STR16("Synth 7 Out"), STR16("Synth 8 Out")};
+		for (const Vst::TChar *name : auxOutputNames)
+			addAudioOutput(name, Steinberg::Vst::SpeakerArr::kStereo, Vst::kAux, 0);
 
 		/* If you don't need an event bus, you can remove the next line */
 		addEventInput(STR16("Event In"), 1);
+
+		// Shared by every instance; off in release builds unless HARDWARE_SYNTH_TRACE_PATH is set
+		traceStarted = TraceLogger::getInstance().start(TraceLogger::defaultPath());
 		return kResultOk;
 	}
 
 	//------------------------------------------------------------------------
 	tresult PLUGIN_API HardwareSynthProcessor::terminate()
 	{
+		if (traceStarted)
+		{
+			TraceLogger::getInstance().stop();
+			traceStarted = false;
+		}
+
 		//---do not forget to call parent ------
 		return AudioEffect::terminate();
 	}
@@ -103,45 +156,64 @@ namespace Newkon
 			}
 		}
 
-		// Process MIDI events and forward to connected synthesizer (time-aware via scheduler)
-		if (data.inputEvents && connectedSynthesizer)
+		// Process MIDI events and forward them through the router (time-aware via each synth's scheduler)
+		if (data.inputEvents)
 		{
-			auto baseNow = std::chrono::steady_clock::now();
-			int32 numEvents = data.inputEvents->getEventCount();
-			for (int32 i = 0; i < numEvents; i++)
+			MIDIRouter::BlockLock routingLock(router);
+			if (router.hasSynthesizers())
 			{
-				Vst::Event event;
-				if (data.inputEvents->getEvent(i, event) == kResultOk)
+				auto baseNow = std::chrono::steady_clock::now();
+
+				// On the ASIO sample clock, stamp the block one device period after the last buffer switch:
+				// events are then released on the interface's own period boundaries, independent of where
+				// the host's callback happens to fall within that period
+				AsioClock::Anchor anchor;
+				const bool useDeviceFrames = midiClockSource.load(std::memory_order_relaxed) == MIDIClockSource::kAsioSampleClock &&
+																		 asioInterface.getSampleClock().snapshot(anchor) && sampleRate > 0.0;
+				const int64 baseFrame = useDeviceFrames ? anchor.samplePosition + anchor.bufferFrames : 0;
+				const double deviceFramesPerSample = useDeviceFrames ? anchor.sampleRate / sampleRate : 1.0;
+
+				int32 numEvents = data.inputEvents->getEventCount();
+				for (int32 i = 0; i < numEvents; i++)
 				{
-					double offsetSeconds = 0.0;
-					if (event.sampleOffset > 0 && sampleRate > 0.0)
-						offsetSeconds = static_cast<double>(event.sampleOffset) / sampleRate;
-					auto when = baseNow + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(offsetSeconds));
-
-					if (event.type == Vst::Event::kNoteOnEvent)
+					Vst::Event event;
+					if (data.inputEvents->getEvent(i, event) == kResultOk)
 					{
-						UINT note = static_cast<UINT>(event.noteOn.pitch);
-						UINT velocity = static_cast<UINT>(event.noteOn.velocity * 127.0f);
-						UINT channel = static_cast<UINT>(event.noteOn.channel);
-						connectedSynthesizer->scheduleMIDINoteAt(note, velocity, channel, when);
-					}
-					else if (event.type == Vst::Event::kNoteOffEvent)
-					{
-						UINT note = static_cast<UINT>(event.noteOff.pitch);
-						UINT channel = static_cast<UINT>(event.noteOff.channel);
-						connectedSynthesizer->scheduleMIDINoteOffAt(note, channel, when);
-					}
-					else if (event.type == Vst::Event::kDataEvent)
-					{
-						if (event.data.size >= 3)
+						double offsetSeconds = 0.0;
+						if (event.sampleOffset > 0 && sampleRate > 0.0)
+							offsetSeconds = static_cast<double>(event.sampleOffset) / sampleRate;
+						MIDIRouter::EventTime time;
+						time.when = baseNow + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(offsetSeconds));
+						time.useDeviceFrame = useDeviceFrames;
+						time.deviceFrame = baseFrame;
+						if (useDeviceFrames && event.sampleOffset > 0)
+							time.deviceFrame += static_cast<int64>(std::llround(event.sampleOffset * deviceFramesPerSample));
+
+						if (event.type == Vst::Event::kNoteOnEvent)
+						{
+							UINT note = static_cast<UINT>(event.noteOn.pitch);
+							UINT velocity = static_cast<UINT>(event.noteOn.velocity * 127.0f);
+							UINT channel = static_cast<UINT>(event.noteOn.channel);
+							router.noteOn(channel, note, velocity, time);
+						}
+						else if (event.type == Vst::Event::kNoteOffEvent)
+						{
+							UINT note = static_cast<UINT>(event.noteOff.pitch);
+							UINT channel = static_cast<UINT>(event.noteOff.channel);
+							router.noteOff(channel, note, time);
+						}
+						else if (event.type == Vst::Event::kDataEvent)
 						{
-							UINT status = event.data.bytes[0];
-							UINT data1 = event.data.bytes[1];
-							UINT data2 = event.data.bytes[2];
-							if ((status & 0xF0) == 0xB0)
+							if (event.data.size >= 3)
 							{
-								UINT channel = status & 0x0F;
-								connectedSynthesizer->scheduleMIDIControlChangeAt(data1, data2, channel, when);
+								UINT status = event.data.bytes[0];
+								UINT data1 = event.data.bytes[1];
+								UINT data2 = event.data.bytes[2];
+								if ((status & 0xF0) == 0xB0)
+								{
+									UINT channel = status & 0x0F;
+									router.controlChange(channel, data1, data2, time);
+								}
 							}
 						}
 					}
@@ -149,13 +221,48 @@ namespace Newkon
 			}
 		}
 
-		//--- Audio processing: Forward ASIO input to DAW output
-		if (data.numSamples > 0 && data.outputs && data.outputs[0].numChannels >= 2)
+		// Final values of controller sweeps thinned out in this block or an earlier one. Every block, not
+		// only those carrying events, so a held value still leaves when the host goes quiet
+		{
+			MIDIRouter::BlockLock routingLock(router);
+			router.flushControlChanges();
+		}
+
+		//--- Hardware insert: the input bus leaves on the ASIO insert outputs and returns through the capture below
+		if (data.numSamples > 0 && data.inputs && data.numInputs > 0 && data.inputs[0].numChannels > 0 && asioInterface.isInsertActive())
+		{
+			Vst::AudioBusBuffers &input = data.inputs[0];
+			if (data.symbolicSampleSize == Vst::kSample64)
+			{
+				if (input.channelBuffers64)
+					asioInterface.sendAudioPlanar(input.channelBuffers64, input.numChannels, data.numSamples);
+			}
+			else if (input.channelBuffers32)
+				asioInterface.sendAudioPlanar(input.channelBuffers32, input.numChannels, data.numSamples);
+		}
+
+		//--- Audio processing: Forward ASIO input to DAW output, bus b channel c reading output channel
+		// b * kChannelsPerBus + c of the ASIO channel map
+		if (data.numSamples > 0 && data.outputs && data.numOutputs > 0 && data.outputs[0].numChannels >= 1)
 		{
 			// Simple policy: if enough samples are available now, copy; otherwise leave buffers as-is
 			if (asioInterface.availableFrames() >= data.numSamples)
 			{
-				asioInterface.getAudioDataStereo(data.outputs[0].channelBuffers32[0], data.outputs[0].channelBuffers32[1], data.numSamples);
+				// All buses in one read: every ring plane is read once per block whatever the bus count.
+				// Double-precision hosts get the planes widened straight into their buffers.
+				const int32 buses = data.numOutputs < kOutputBuses ? data.numOutputs : kOutputBuses;
+				if (data.symbolicSampleSize == Vst::kSample64)
+				{
+					const int outputs = gatherOutputChannels(data, buses, discardBuffer64, outputChannels64);
+					if (outputs > 0)
+						asioInterface.getAudioDataPlanar(outputChannels64, outputs, data.numSamples);
+				}
+				else
+				{
+					const int outputs = gatherOutputChannels(data, buses, discardBuffer, outputChannels);
+					if (outputs > 0)
+						asioInterface.getAudioDataPlanar(outputChannels, outputs, data.numSamples);
+				}
 			}
 			else
 			{
@@ -172,23 +279,28 @@ namespace Newkon
 		//--- called before any processing ----
 		sampleRate = newSetup.sampleRate;
 		bufferSize = newSetup.maxSamplesPerBlock;
+		const size_t discardFrames = static_cast<size_t>(bufferSize > 0 ? bufferSize : 0);
+		discardBuffer.assign(newSetup.symbolicSampleSize == Vst::kSample64 ? 0 : discardFrames, 0.0f);
+		discardBuffer64.assign(newSetup.symbolicSampleSize == Vst::kSample64 ? discardFrames : 0, 0.0);
 		Logger::getInstance() << "Buffer size: " << bufferSize << " samples" << std::endl;
 		Logger::getInstance() << "Sample rate: " << sampleRate << " Hz" << std::endl;
 
+		// Captured audio is resampled to this rate if the interface runs at another one
+		asioInterface.setHostSampleRate(sampleRate);
+
+		// The host queries getLatencySamples() after setupProcessing, no restart needed
+		updateLatencyCompensation(false);
+
 		return AudioEffect::setupProcessing(newSetup);
 	}
 
 	//------------------------------------------------------------------------
 	tresult PLUGIN_API HardwareSynthProcessor::canProcessSampleSize(int32 symbolicSampleSize)
 	{
-		// by default kSample32 is supported
-		if (symbolicSampleSize == Vst::kSample32)
+		// Both: the capture ring is float, and double-precision buffers are filled straight from it
+		if (symbolicSampleSize == Vst::kSample32 || symbolicSampleSize == Vst::kSample64)
 			return kResultTrue;
 
-		// disable the following comment if your processing support kSample64
-		/* if (symbolicSampleSize == Vst::kSample64)
-			return kResultTrue; */
-
 		return kResultFalse;
 	}
 
@@ -198,21 +310,87 @@ namespace Newkon
 		// called when we load a preset, the model has to be reloaded
 		IBStreamer streamer(state, kLittleEndian);
 
-		// Restore hardware synthesizer connection state
-		int32 connected = 0;
-		if (streamer.readInt32(connected) == kResultOk)
+		// Layout: synth count, one device index per synth, then (optionally) the routes, the output bus
+		// inputs and the insert outputs. A single synth reads exactly like the former "connected flag +
+		// device index" state.
+		int32 synthCount = 0;
+		if (!streamer.readInt32(synthCount) || synthCount < 0)
+			return kResultOk;
+
+		if (synthCount > 0)
+			disconnectSynthesizer();
+
+		// Saved slot -> slot after reconnecting, -1 when the device is gone
+		std::vector<int> slotMap;
+		for (int32 i = 0; i < synthCount; i++)
 		{
-			if (connected == 1)
-			{
-				// Restore device index
-				int32 deviceIndex = 0;
-				if (streamer.readInt32(deviceIndex) == kResultOk)
-				{
-					// Reconnect to the saved device
-					connectToSynthesizer(static_cast<size_t>(deviceIndex));
-				}
-			}
+			int32 deviceIndex = -1;
+			if (!streamer.readInt32(deviceIndex))
+				break;
+			slotMap.push_back(deviceIndex >= 0 ? addSynthesizer(static_cast<size_t>(deviceIndex)) : -1);
+		}
+
+		int32 routeCount = 0;
+		if (!streamer.readInt32(routeCount) || routeCount < 0)
+			return kResultOk; // older state: default routing
+
+		std::vector<MIDIRouter::Route> restored;
+		for (int32 i = 0; i < routeCount; i++)
+		{
+			int32 fields[7];
+			bool complete = true;
+			for (int32 &field : fields)
+				complete = complete && streamer.readInt32(field);
+			if (!complete)
+				break;
+
+			const int32 savedSlot = fields[5];
+			if (savedSlot < 0 || savedSlot >= static_cast<int32>(slotMap.size()) || slotMap[savedSlot] < 0)
+				continue;
+
+			MIDIRouter::Route route;
+			route.inputChannel = static_cast<uint8_t>(fields[0]);
+			route.lowKey = static_cast<uint8_t>(fields[1]);
+			route.highKey = static_cast<uint8_t>(fields[2]);
+			route.lowVelocity = static_cast<uint8_t>(fields[3]);
+			route.highVelocity = static_cast<uint8_t>(fields[4]);
+			route.synth = static_cast<uint8_t>(slotMap[savedSlot]);
+			route.outputChannel = static_cast<int8_t>(fields[6]);
+			restored.push_back(route);
+		}
+		if (synthCount > 0)
+			setRoutes(restored);
+
+		int32 busCount = 0;
+		if (!streamer.readInt32(busCount) || busCount < 0)
+			return kResultOk; // older state: main bus follows the selected input
+
+		BusInputs restoredBuses[kOutputBuses];
+		for (int32 b = 0; b < busCount; b++)
+		{
+			int32 left = -1, right = -1;
+			if (!streamer.readInt32(left) || !streamer.readInt32(right))
+				break;
+			if (b < kOutputBuses)
+				restoredBuses[b] = {left, right};
 		}
+		for (int b = 0; b < kOutputBuses; b++)
+			busInputs[b] = restoredBuses[b];
+		applyOutputBusMap();
+
+		int32 insertCount = 0;
+		if (!streamer.readInt32(insertCount) || insertCount < 0)
+			return kResultOk; // older state: synth mode
+
+		std::vector<int> restoredInserts;
+		for (int32 i = 0; i < insertCount; i++)
+		{
+			int32 output = -1;
+			if (!streamer.readInt32(output))
+				break;
+			restoredInserts.push_back(output);
+		}
+		setInsertOutputs(restoredInserts);
 
 		return kResultOk;
 	}
@@ -223,18 +401,17 @@ namespace Newkon
 		// here we need to save the model
 		IBStreamer streamer(state, kLittleEndian);
 
-		// Save hardware synthesizer connection state
-		if (connectedSynthesizer)
-		{
-			// Save that we have a connection
-			streamer.writeInt32(1);
+		// Save the synthesizer set
+		streamer.writeInt32(static_cast<int32>(synthesizers.size()));
 
-			// Find the device index by comparing device names
-			auto devices = MIDIDevices::listMIDIdevices();
+		// Find each device index by comparing device names
+		auto devices = MIDIDevices::listMIDIdevices();
+		for (const auto &synthesizer : synthesizers)
+		{
 			int32 deviceIndex = -1;
 			for (size_t i = 0; i < devices.size(); i++)
 			{
-				if (devices[i] == connectedSynthesizer->getDeviceName())
+				if (devices[i] == synthesizer->getDeviceName())
 				{
 					deviceIndex = static_cast<int32>(i);
 					break;
@@ -242,19 +419,41 @@ namespace Newkon
 			}
 			streamer.writeInt32(deviceIndex);
 		}
-		else
+
+		// Save the routes
+		streamer.writeInt32(static_cast<int32>(routes.size()));
+		for (const auto &route : routes)
+		{
+			streamer.writeInt32(route.inputChannel);
+			streamer.writeInt32(route.lowKey);
+			streamer.writeInt32(route.highKey);
+			streamer.writeInt32(route.lowVelocity);
+			streamer.writeInt32(route.highVelocity);
+			streamer.writeInt32(route.synth);
+			streamer.writeInt32(route.outputChannel);
+		}
+
+		// Save the output bus inputs
+		streamer.writeInt32(kOutputBuses);
+		for (const BusInputs &bus : busInputs)
 		{
-			// Save that we have no connection
-			streamer.writeInt32(0);
+			streamer.writeInt32(bus.left);
+			streamer.writeInt32(bus.right);
 		}
 
+		// Save the hardware insert outputs
+		const std::vector<int> &inserts = asioInterface.getInsertOutputs();
+		streamer.writeInt32(static_cast<int32>(inserts.size()));
+		for (int output : inserts)
+			streamer.writeInt32(output);
+
 		return kResultOk;
 	}
 
 	//------------------------------------------------------------------------
 	uint32 PLUGIN_API HardwareSynthProcessor::getLatencySamples()
 	{
-		return static_cast<uint32>(sampleRate * currentLatencySeconds);
+		return latencyPlan.reportedLatencySamples;
 	}
 
 	//------------------------------------------------------------------------
@@ -263,10 +462,104 @@ namespace Newkon
 		if (currentLatencySeconds != latencySeconds)
 		{
 			currentLatencySeconds = latencySeconds;
-			Logger::getInstance() << "Latency changed to: " << latencySeconds << " seconds" << std::endl;
+			Logger::getInstance() << "Hardware latency changed to: " << latencySeconds << " seconds" << std::endl;
+			updateLatencyCompensation(true);
+		}
+	}
+
+	//------------------------------------------------------------------------
+	LatencyCalibrator::Result HardwareSynthProcessor::calibrateLatency(size_t slot, const LatencyCalibrator::Settings &settings)
+	{
+		if (slot >= synthesizers.size())
+			return LatencyCalibrator::Result();
+
+		LatencyCalibrator::Settings busSettings = settings;
+		busSettings.captureOutput = captureOutputForSlot(slot);
+		LatencyCalibrator::Result result = LatencyCalibrator::run(*synthesizers[slot], asioInterface, busSettings);
+		if (!result.success)
+		{
+			Logger::getInstance() << "Latency calibration failed: " << result.detected << " of " << result.runs << " runs detected" << std::endl;
+			return result;
+		}
+
+		Logger::getInstance() << "Latency calibration: median " << result.medianSeconds * 1000.0 << " ms over "
+							  << result.accepted << "/" << result.runs << " runs, jitter " << result.jitterSeconds * 1000.0
+							  << " ms (min " << result.minSeconds * 1000.0 << ", max " << result.maxSeconds * 1000.0
+							  << ", std dev " << result.stdDevSeconds * 1000.0 << ")" << std::endl;
+		setLatency(result.medianSeconds);
+		return result;
+	}
 
-			// Notify host that latency has changed
-			// This forces FL Studio to restart audio processing
+	//------------------------------------------------------------------------
+	bool HardwareSynthProcessor::setInsertOutputs(const std::vector<int> &outputs)
+	{
+		if (outputs == asioInterface.getInsertOutputs())
+			return true;
+		const bool ok = asioInterface.setInsertOutputs(outputs);
+		Logger::getInstance() << "Hardware insert outputs: " << outputs.size() << (outputs.empty() ? " (synth mode)" : "") << std::endl;
+		updateLatencyCompensation(true);
+		return ok;
+	}
+
+	//------------------------------------------------------------------------
+	LatencyCalibrator::Result HardwareSynthProcessor::measureInsertLoop(const LatencyCalibrator::Settings &settings)
+	{
+		LatencyCalibrator::Result result = LatencyCalibrator::runInsertLoop(asioInterface, settings);
+		if (!result.success)
+		{
+			Logger::getInstance() << "Insert loop measurement failed: " << result.detected << " of " << result.runs << " runs detected" << std::endl;
+			return result;
+		}
+
+		Logger::getInstance() << "Insert loop: median " << result.medianSeconds * 1000.0 << " ms over "
+							  << result.accepted << "/" << result.runs << " runs, jitter " << result.jitterSeconds * 1000.0 << " ms" << std::endl;
+		insertLoopSeconds = result.medianSeconds;
+		updateLatencyCompensation(true);
+		return result;
+	}
+
+	//------------------------------------------------------------------------
+	void HardwareSynthProcessor::setMIDIClockSource(MIDIClockSource source)
+	{
+		if (midiClockSource.exchange(source, std::memory_order_relaxed) != source)
+			updateLatencyCompensation(true);
+	}
+
+	//------------------------------------------------------------------------
+	void HardwareSynthProcessor::updateLatencyCompensation(bool notifyHost)
+	{
+		// MIDI leaves as soon as the host hands it to us; the host already feeds events early by the
+		// latency we report. The captured audio is held back in the ring so that its total delay,
+		// hardware round trip included, matches that report exactly.
+		LatencyCompensator::Inputs inputs;
+		inputs.hardwareLatencySeconds = currentLatencySeconds;
+		inputs.hostSampleRate = sampleRate;
+		inputs.hostBlockSize = bufferSize;
+		inputs.deviceSampleRate = asioInterface.getDeviceSampleRate();
+		inputs.deviceBufferFrames = static_cast<int32_t>(asioInterface.getDeviceBufferFrames());
+		inputs.deviceFrameStamping = midiClockSource.load(std::memory_order_relaxed) == MIDIClockSource::kAsioSampleClock;
+		inputs.ringSampleRate = asioInterface.getRingSampleRate();
+		inputs.rateConversionDelaySeconds = asioInterface.getRateConversionDelaySeconds();
+		inputs.insert = asioInterface.isInsertActive();
+		inputs.insertLoopSeconds = insertLoopSeconds;
+
+		const LatencyCompensator::Plan plan = LatencyCompensator::compute(inputs);
+		asioInterface.setReadDelayFrames(plan.ringDelayFrames);
+		asioInterface.setSendDelayFrames(plan.sendDelayFrames);
+
+		const bool reportChanged = plan.reportedLatencySamples != latencyPlan.reportedLatencySamples;
+		latencyPlan = plan;
+		if (!reportChanged)
+			return;
+
+		Logger::getInstance() << "Reported latency: " << plan.reportedLatencySamples << " samples ("
+							  << plan.reportedLatencySeconds * 1000.0 << " ms), ring delay " << plan.ringDelayFrames << " frames, send delay "
+							  << plan.sendDelayFrames << " frames" << std::endl;
+
+		// Notify host that latency has changed
+		// This forces FL Studio to restart audio processing
+		if (notifyHost)
+		{
 			if (auto *host = getHostContext())
 			{
 				Steinberg::FUnknownPtr<Steinberg::Vst::IComponentHandler> componentHandler(host);
@@ -281,43 +574,187 @@ namespace Newkon
 	//------------------------------------------------------------------------
 	bool HardwareSynthProcessor::connectToSynthesizer(size_t deviceIndex)
 	{
-		// Disconnect current synthesizer if any
+		// Disconnect current synthesizers if any
 		disconnectSynthesizer();
 
 		// Connect to new synthesizer
-		connectedSynthesizer = std::move(MIDIDevices::connectToDevice(deviceIndex));
-		if (connectedSynthesizer)
-		{
-			return true;
-		}
-		return false;
+		return addSynthesizer(deviceIndex) >= 0;
 	}
 
 	//------------------------------------------------------------------------
 	void HardwareSynthProcessor::disconnectSynthesizer()
 	{
-		if (connectedSynthesizer)
-		{
-			connectedSynthesizer.reset();
-		}
+		if (synthesizers.empty() && routes.empty())
+			return;
+
+		// Take the set out of the router before destroying it
+		routes.clear();
+		std::vector<std::unique_ptr<HardwareSynthesizer>> disconnected;
+		disconnected.swap(synthesizers);
+		applyRouting();
 	}
 
 	//------------------------------------------------------------------------
 	bool HardwareSynthProcessor::isSynthesizerConnected() const
 	{
-		return connectedSynthesizer != nullptr;
+		return !synthesizers.empty();
 	}
 
 	//------------------------------------------------------------------------
 	std::string HardwareSynthProcessor::getConnectedSynthesizerName() const
 	{
-		if (connectedSynthesizer)
+		if (!synthesizers.empty())
 		{
-			return connectedSynthesizer->getDeviceName();
+			return synthesizers.front()->getDeviceName();
 		}
 		return "";
 	}
 
+	//------------------------------------------------------------------------
+	int HardwareSynthProcessor::addSynthesizer(size_t deviceIndex)
+	{
+		if (synthesizers.size() >= MIDIRouter::kMaxSynths)
+		{
+			Logger::getInstance() << "Cannot add synthesizer: " << MIDIRouter::kMaxSynths << " already connected" << std::endl;
+			return -1;
+		}
+
+		auto synthesizer = MIDIDevices::connectToDevice(deviceIndex);
+		if (!synthesizer)
+			return -1;
+
+		// Frame-stamped events are resolved against the capture interface's clock
+		synthesizer->setSampleClock(&asioInterface.getSampleClock());
+		synthesizers.push_back(std::move(synthesizer));
+		applyRouting();
+		return static_cast<int>(synthesizers.size() - 1);
+	}
+
+	//------------------------------------------------------------------------
+	void HardwareSynthProcessor::removeSynthesizer(size_t slot)
+	{
+		if (slot >= synthesizers.size())
+			return;
+
+		std::vector<MIDIRouter::Route> remaining;
+		for (MIDIRouter::Route route : routes)
+		{
+			if (route.synth == slot)
+				continue;
+			if (route.synth > slot)
+				route.synth--;
+			remaining.push_back(route);
+		}
+		routes.swap(remaining);
+
+		// The router must stop using the synth before it is destroyed
+		std::unique_ptr<HardwareSynthesizer> removed = std::move(synthesizers[slot]);
+		synthesizers.erase(synthesizers.begin() + slot);
+		applyRouting();
+	}
+
+	//------------------------------------------------------------------------
+	void HardwareSynthProcessor::setRoutes(const std::vector<MIDIRouter::Route> &newRoutes)
+	{
+		routes = newRoutes;
+		applyRouting();
+	}
+
+	//------------------------------------------------------------------------
+	bool HardwareSynthProcessor::setOutputBusInputs(int bus, int32_t leftInput, int32_t rightInput)
+	{
+		if (bus < 0 || bus >= kOutputBuses)
+			return false;
+		busInputs[bus] = {leftInput < 0 ? -1 : leftInput, rightInput < 0 ? -1 : rightInput};
+		Logger::getInstance() << "Output bus " << bus << " <- ASIO inputs " << busInputs[bus].left << "/" << busInputs[bus].right << std::endl;
+		applyOutputBusMap();
+		// The tracker listens to each synthesizer on its bus
+		restartLatencyTracker();
+		return true;
+	}
+
+	//------------------------------------------------------------------------
+	HardwareSynthProcessor::BusInputs HardwareSynthProcessor::getOutputBusInputs(int bus) const
+	{
+		return (bus >= 0 && bus < kOutputBuses) ? busInputs[bus] : BusInputs();
+	}
+
+	//------------------------------------------------------------------------
+	void HardwareSynthProcessor::applyOutputBusMap()
+	{
+		// Flatten to one ASIO channel map up to the last assigned bus; none assigned keeps the default
+		int lastBus = -1;
+		for (int b = 0; b < kOutputBuses; b++)
+			if (busInputs[b].left >= 0 || busInputs[b].right >= 0)
+				lastBus = b;
+
+		std::vector<int> map;
+		for (int b = 0; b <= lastBus; b++)
+		{
+			map.push_back(busInputs[b].left);
+			map.push_back(busInputs[b].right);
+		}
+		if (map != asioInterface.getChannelMap())
+			asioInterface.setChannelMap(map);
+	}
+
+	//------------------------------------------------------------------------
+	int HardwareSynthProcessor::captureOutputForSlot(size_t slot) const
+	{
+		if (slot >= static_cast<size_t>(kOutputBuses))
+			return 0;
+		const BusInputs &inputs = busInputs[slot];
+		if (inputs.left >= 0)
+			return static_cast<int>(slot) * kChannelsPerBus;
+		if (inputs.right >= 0)
+			return static_cast<int>(slot) * kChannelsPerBus + 1;
+		return 0; // unassigned: the main bus' left side
+	}
+
+	//------------------------------------------------------------------------
+	void HardwareSynthProcessor::applyRouting()
+	{
+		std::vector<HardwareSynthesizer *> synths;
+		for (auto &synthesizer : synthesizers)
+			synths.push_back(synthesizer.get());
+
+		if (routes.empty() && !synths.empty())
+		{
+			// Default: everything to the first synthesizer, as with a single connection
+			std::vector<MIDIRouter::Route> defaultRoutes(1);
+			router.configure(synths, defaultRoutes);
+		}
+		else
+		{
+			router.configure(synths, routes);
+		}
+
+		// Callers keep removed synthesizers alive until this returns, so the tracker can let go of them
+		restartLatencyTracker();
+	}
+
+	//------------------------------------------------------------------------
+	void HardwareSynthProcessor::setLatencyTracking(bool enabled)
+	{
+		if (latencyTracking == enabled)
+			return;
+		latencyTracking = enabled;
+		restartLatencyTracker();
+	}
+
+	//------------------------------------------------------------------------
+	void HardwareSynthProcessor::restartLatencyTracker()
+	{
+		latencyTracker.stop();
+		if (!latencyTracking || synthesizers.empty())
+			return;
+
+		std::vector<LatencyTracker::Source> sources;
+		for (size_t slot = 0; slot < synthesizers.size(); slot++)
+			sources.push_back({synthesizers[slot].get(), captureOutputForSlot(slot)});
+		latencyTracker.start(asioInterface, sources);
+	}
+
 	//------------------------------------------------------------------------
 	HardwareSynthProcessor *HardwareSynthProcessor::getCurrentInstance()
 	{
@@ -5,13 +5,19 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include <chrono>
+#include <atomic>
 
 #include "public.sdk/source/vst/vstaudioeffect.h"
 
 #include "../params.h"
 #include "./HardwareSynthesizer/HardwareSynthesizer.h"
 #include "./Asio/AsioInterface.h"
+#include "LatencyCompensator.h"
+#include "LatencyCalibrator.h"
+#include "LatencyTracker.h"
+#include "MIDIRouter.h"
 
 namespace Newkon
 {
@@ -59,21 +65,85 @@ namespace Newkon
 		/** Returns latency in samples */
 		Steinberg::uint32 PLUGIN_API getLatencySamples() SMTG_OVERRIDE;
 
-		/** Change latency dynamically */
+		/** Set the hardware round trip (MIDI out -> synth -> ASIO capture) in seconds.
+		 *  The latency reported to the host is this plus the plugin's own dispatch and buffering delay. */
 		void setLatency(double latencySeconds);
 
-		/** Connect to a hardware synthesizer by device index */
+		/** Measure the hardware round trip through the synthesizer in `slot` with test notes, listening on
+		 *  that slot's output bus, and, when enough runs agree, apply the median with setLatency().
+		 *  Blocking; call from a control thread. */
+		LatencyCalibrator::Result calibrateLatency(size_t slot, const LatencyCalibrator::Settings &settings = LatencyCalibrator::Settings());
+
+		/** Hardware insert: the "ASIO Input" bus goes out on these ASIO outputs (in channel order) and the
+		 *  outboard effect's return comes back through the output buses' ASIO inputs, the main bus' first.
+		 *  Empty returns to synth mode. The reported latency then covers the insert loop. */
+		bool setInsertOutputs(const std::vector<int> &outputs);
+		const std::vector<int> &getInsertOutputs() const { return asioInterface.getInsertOutputs(); }
+
+		/** Measure the insert loop (ASIO output -> effect -> ASIO capture) with test impulses and, when
+		 *  enough runs agree, report the median. Blocking; call from a control thread. */
+		LatencyCalibrator::Result measureInsertLoop(const LatencyCalibrator::Settings &settings = LatencyCalibrator::Settings());
+
+		/** Background tracking of latency and jitter over every note-on the synthesizers play (off by default).
+		 *  Follows changes to the synthesizer set; the statistics restart with it. */
+		void setLatencyTracking(bool enabled);
+		bool isLatencyTracking() const { return latencyTracking; }
+		std::vector<LatencyTracker::DeviceStats> getLatencyTrackerStats() const { return latencyTracker.getStats(); }
+
+		/** Recompute the ring read delay and reported latency from the current host and ASIO settings.
+		 *  Call after the ASIO stream (re)starts; notifies the host when the reported latency changes. */
+		void updateLatencyCompensation(bool notifyHost);
+
+		/** Connect to a hardware synthesizer by device index, replacing the whole set with it */
 		bool connectToSynthesizer(size_t deviceIndex);
 
-		/** Disconnect from current synthesizer */
+		/** Disconnect every synthesizer */
 		void disconnectSynthesizer();
 
-		/** Check if a synthesizer is connected */
+		/** Check if at least one synthesizer is connected */
 		bool isSynthesizerConnected() const;
 
-		/** Get connected synthesizer device name */
+		/** Get the first connected synthesizer's device name */
 		std::string getConnectedSynthesizerName() const;
 
+		/** Add a synthesizer to the set; returns its slot (the index routes refer to) or -1 */
+		int addSynthesizer(size_t deviceIndex);
+
+		/** Remove the synthesizer in a slot; routes to it are dropped and later slots move down */
+		void removeSynthesizer(size_t slot);
+
+		size_t getSynthesizerCount() const { return synthesizers.size(); }
+
+		/** Split/layer routing across the synthesizer set. With no routes everything goes to slot 0 */
+		void setRoutes(const std::vector<MIDIRouter::Route> &newRoutes);
+		const std::vector<MIDIRouter::Route> &getRoutes() const { return routes; }
+
+		/** Clock used to stamp outgoing MIDI */
+		enum class MIDIClockSource
+		{
+			kHostWallClock,	 // steady_clock time derived from the host's process() call
+			kAsioSampleClock // ASIO device frames, released on the capture interface's own period
+		};
+		void setMIDIClockSource(MIDIClockSource source);
+		MIDIClockSource getMIDIClockSource() const { return midiClockSource.load(std::memory_order_relaxed); }
+
+		/** Output buses: the main "Stereo Out" plus auxiliary stereo buses, one per hardware unit. The
+		 *  synthesizer in slot n returns on bus n when that bus is assigned, on the main bus otherwise. */
+		static constexpr int kOutputBuses = 8;
+		static constexpr int kChannelsPerBus = 2;
+
+		/** ASIO inputs feeding one output bus; -1 leaves that side silent */
+		struct BusInputs
+		{
+			int32_t left = -1;
+			int32_t right = -1;
+		};
+
+		/** Feed an output bus from a pair of ASIO inputs (the same input twice for a mono unit, -1/-1 to
+		 * clear). While no bus is assigned, the main bus follows the input selected in the UI. */
+		bool setOutputBusInputs(int bus, int32_t leftInput, int32_t rightInput);
+		BusInputs getOutputBusInputs(int bus) const;
+
 		/** Get the current processor instance (for UI access) */
 		static HardwareSynthProcessor *getCurrentInstance();
 
@@ -84,15 +154,40 @@ namespace Newkon
 	protected:
 		double sampleRate = 44100.0;
 		Steinberg::int32 bufferSize = 512;
-		double currentLatencySeconds = 0.0;
+		double currentLatencySeconds = 0.0; // hardware round trip
+		double insertLoopSeconds = 0.0;		// hardware insert: ASIO output -> effect -> ASIO capture
+		LatencyCompensator::Plan latencyPlan;
 
 		// Latency debounce state
 		bool latencyChangePending = false;
 		double pendingLatencySeconds = 0.0;
 		std::chrono::steady_clock::time_point lastLatencyChangeRequest;
 
-		// Hardware synthesizer management
-		std::unique_ptr<HardwareSynthesizer> connectedSynthesizer;
+		// Hardware synthesizer management: the set is owned here, process() only sees it through the router
+		std::vector<std::unique_ptr<HardwareSynthesizer>> synthesizers;
+		std::vector<MIDIRouter::Route> routes;
+		MIDIRouter router;
+		std::atomic<MIDIClockSource> midiClockSource{MIDIClockSource::kHostWallClock};
+
+		void applyRouting();
+
+		// Output buses -> ASIO channel map; process() gathers every bus into one planar read
+		BusInputs busInputs[kOutputBuses];
+		void applyOutputBusMap();
+		// ASIO output channel (bus * 2 + side) carrying the synthesizer in `slot`, for the capture taps
+		int captureOutputForSlot(size_t slot) const;
+		std::vector<float> discardBuffer; // stands in for channels the host passes without a buffer
+		std::vector<double> discardBuffer64;
+		float *outputChannels[kOutputBuses * kChannelsPerBus] = {};
+		double *outputChannels64[kOutputBuses * kChannelsPerBus] = {};
+
+		// Declared after the synthesizers and the router; stopped explicitly before either changes
+		LatencyTracker latencyTracker;
+		bool latencyTracking = false;
+		void restartLatencyTracker();
+
+		// This instance holds a reference on the shared trace writer
+		bool traceStarted = false;
 
 		// Static reference for UI access
 		static HardwareSynthProcessor *currentInstance;
@@ -0,0 +1,317 @@
+#include "TraceLogger.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+namespace Newkon
+{
+  // Marks the calling thread's ring as free for adoption when the thread exits
+  struct TraceThreadHandle
+  {
+    TraceLogger::ThreadRing *ring = nullptr;
+    char name[16] = {}; // registered before the thread had a ring
+    ~TraceThreadHandle()
+    {
+      if (ring)
+        ring->orphaned.store(true, std::memory_order_release);
+    }
+  };
+
+  namespace
+  {
+    thread_local TraceThreadHandle t_traceThread;
+
+    void formatMidiSent(char *buf, size_t size, const int64_t *args)
+    {
+      const uint32_t msg = static_cast<uint32_t>(args[0]);
+      const long long lateUs = static_cast<long long>(args[1] / 1000);
+      const char *kind = "MIDI";
+      switch (msg & 0xF0)
+      {
+      case 0x90:
+        kind = ((msg >> 16) & 0x7F) ? "MIDI Note On" : "MIDI Note Off";
+        break;
+      case 0x80:
+        kind = "MIDI Note Off";
+        break;
+      case 0xB0:
+        kind = "MIDI CC";
+        break;
+      }
+      std::snprintf(buf, size, "%s sent: msg=0x%x, late %lld us, %lld byte(s) on the wire", kind, msg, lateUs,
+                    static_cast<long long>(args[2]));
+    }
+  }
+
+  TraceLogger &TraceLogger::getInstance()
+  {
+    static TraceLogger instance;
+    return instance;
+  }
+
+  TraceLogger::~TraceLogger()
+  {
+    // Still running at static destruction: stop the writer whatever the user count
+    {
+      std::lock_guard<std::mutex> lock(lifecycleMutex);
+      if (users == 0)
+        return;
+      users = 1;
+    }
+    stop();
+  }
+
+  std::string TraceLogger::defaultPath()
+  {
+    if (const char *env = std::getenv("HARDWARE_SYNTH_TRACE_PATH"))
+      return env;
+#ifdef HARDWARE_SYNTH_RELEASE
+    return std::string();
+#else
+    std::error_code ec;
+    const auto dir = std::filesystem::temp_directory_path(ec);
+    if (ec)
+      return std::string();
+    return (dir / "hardware-synth-trace.txt").string();
+#endif
+  }
+
+  bool TraceLogger::start(const std::string &path)
+  {
+    std::lock_guard<std::mutex> lock(lifecycleMutex);
+    if (users > 0)
+    {
+      users++;
+      return true;
+    }
+    if (path.empty())
+      return false;
+
+    file.open(path, std::ios::app);
+    if (!file.is_open())
+      return false;
+
+    if (!ringStorage)
+    {
+      // Once for the process: tracing threads only ever claim from these
+      ringStorage.reset(new ThreadRing[kMaxThreads]);
+      for (uint32_t i = 0; i < kMaxThreads; i++)
+        ringStorage[i].index = i;
+      rings.store(ringStorage.get(), std::memory_order_release);
+    }
+
+    users = 1;
+    outputPath = path;
+    origin = std::chrono::steady_clock::now();
+    reportedDrops = getDroppedCount();
+    file << "---- trace started ----\n";
+    {
+      std::lock_guard<std::mutex> wakeLock(wakeMutex);
+      writerRunning = true;
+    }
+    writer = std::thread(&TraceLogger::writerLoop, this);
+    enabled.store(true, std::memory_order_release);
+    return true;
+  }
+
+  void TraceLogger::stop()
+  {
+    std::lock_guard<std::mutex> lock(lifecycleMutex);
+    if (users == 0 || --users > 0)
+      return;
+
+    enabled.store(false, std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> wakeLock(wakeMutex);
+      writerRunning = false;
+    }
+    wake.notify_all();
+    if (writer.joinable())
+      writer.join();
+    file.close();
+  }
+
+  void TraceLogger::registerCurrentThread(const char *name)
+  {
+    if (!name)
+      return;
+    std::strncpy(t_traceThread.name, name, sizeof(t_traceThread.name) - 1);
+    if (ThreadRing *ring = ringForCurrentThread())
+    {
+      // Read by the writer while formatting; a torn name during a rename is harmless
+      std::strncpy(ring->name, name, sizeof(ring->name) - 1);
+    }
+  }
+
+  TraceLogger::ThreadRing *TraceLogger::ringForCurrentThread()
+  {
+    if (!t_traceThread.ring)
+    {
+      // Null until the first start()
+      if (ThreadRing *storage = rings.load(std::memory_order_acquire))
+        t_traceThread.ring = claimRing(storage);
+    }
+    return t_traceThread.ring;
+  }
+
+  TraceLogger::ThreadRing *TraceLogger::claimRing(ThreadRing *storage)
+  {
+    ThreadRing *claimed = nullptr;
+    const uint32_t slot = nextRing.fetch_add(1, std::memory_order_relaxed);
+    if (slot < kMaxThreads)
+      claimed = &storage[slot];
+    else
+    {
+      // All claimed once: adopt a ring the writer has emptied since its thread exited, so the new
+      // thread starts with full capacity
+      for (uint32_t i = 0; i < kMaxThreads && !claimed; i++)
+      {
+        ThreadRing &ring = storage[i];
+        bool orphaned = true;
+        if (ring.orphaned.load(std::memory_order_acquire) &&
+            ring.readCount.load(std::memory_order_acquire) == ring.writeCount.load(std::memory_order_relaxed) &&
+            ring.orphaned.compare_exchange_strong(orphaned, false, std::memory_order_acquire))
+          claimed = &ring;
+      }
+      if (!claimed)
+        return nullptr;
+    }
+    std::memcpy(claimed->name, t_traceThread.name, sizeof(claimed->name));
+    return claimed;
+  }
+
+  void TraceLogger::trace(TraceEvent event, int64_t a0, int64_t a1, int64_t a2)
+  {
+    if (!enabled.load(std::memory_order_relaxed))
+      return;
+    ThreadRing *ring = ringForCurrentThread();
+    if (!ring)
+    {
+      if (ThreadRing *storage = rings.load(std::memory_order_relaxed))
+        storage[0].dropped.fetch_add(1, std::memory_order_relaxed); // no ring left for this thread
+      return;
+    }
+
+    const uint32_t w = ring->writeCount.load(std::memory_order_relaxed);
+    if (w - ring->readCount.load(std::memory_order_acquire) >= kRingCapacity)
+    {
+      ring->dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    Record &r = ring->records[w & (kRingCapacity - 1)];
+    r.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    r.thread = ring->index;
+    r.event = event;
+    r.args[0] = a0;
+    r.args[1] = a1;
+    r.args[2] = a2;
+    ring->writeCount.store(w + 1, std::memory_order_release);
+  }
+
+  uint64_t TraceLogger::getDroppedCount() const
+  {
+    uint64_t total = 0;
+    if (const ThreadRing *storage = rings.load(std::memory_order_acquire))
+    {
+      for (uint32_t i = 0; i < kMaxThreads; i++)
+        total += storage[i].dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  void TraceLogger::drain(std::vector<Record> &batch)
+  {
+    // Unclaimed rings are simply empty
+    ThreadRing *storage = rings.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < kMaxThreads; i++)
+    {
+      ThreadRing &ring = storage[i];
+      uint32_t r = ring.readCount.load(std::memory_order_relaxed);
+      const uint32_t w = ring.writeCount.load(std::memory_order_acquire);
+      for (; r != w; r++)
+        batch.push_back(ring.records[r & (kRingCapacity - 1)]);
+      ring.readCount.store(r, std::memory_order_release);
+    }
+  }
+
+  void TraceLogger::writeBatch(std::vector<Record> &batch)
+  {
+    const uint64_t drops = getDroppedCount();
+    if (batch.empty() && drops == reportedDrops)
+      return;
+
+    // Rings are ordered individually; interleave threads by time
+    std::stable_sort(batch.begin(), batch.end(), [](const Record &a, const Record &b)
+                     { return a.timeNs < b.timeNs; });
+
+    const int64_t originNs = std::chrono::duration_cast<std::chrono::nanoseconds>(origin.time_since_epoch()).count();
+    char line[256];
+    char text[192];
+    for (const Record &r : batch)
+    {
+      switch (r.event)
+      {
+      case TraceEvent::kMidiSent:
+        formatMidiSent(text, sizeof(text), r.args);
+        break;
+      case TraceEvent::kMidiDropped:
+        std::snprintf(text, sizeof(text), "MIDI scheduler dropped %lld event(s), incoming queue full (total %lld)",
+                      static_cast<long long>(r.args[0]), static_cast<long long>(r.args[1]));
+        break;
+      case TraceEvent::kAudioUnderrun:
+        std::snprintf(text, sizeof(text), "Underrun: requested %lld, available %lld",
+                      static_cast<long long>(r.args[0]), static_cast<long long>(r.args[1]));
+        break;
+      case TraceEvent::kSendUnderrun:
+        std::snprintf(text, sizeof(text), "Insert send underrun: requested %lld, queued %lld",
+                      static_cast<long long>(r.args[0]), static_cast<long long>(r.args[1]));
+        break;
+      case TraceEvent::kSendOverrun:
+        std::snprintf(text, sizeof(text), "Insert send overrun: offered %lld, queued %lld",
+                      static_cast<long long>(r.args[0]), static_cast<long long>(r.args[1]));
+        break;
+      default:
+        std::snprintf(text, sizeof(text), "event %u", static_cast<unsigned>(r.event));
+        break;
+      }
+      char name[20];
+      const ThreadRing &ring = ringStorage[r.thread];
+      if (ring.name[0])
+        std::snprintf(name, sizeof(name), "%s", ring.name);
+      else
+        std::snprintf(name, sizeof(name), "thread %u", r.thread);
+      std::snprintf(line, sizeof(line), "[%12.6f] [%s] %s\n", static_cast<double>(r.timeNs - originNs) / 1e9, name, text);
+      file << line;
+    }
+    if (drops != reportedDrops)
+    {
+      file << "trace: " << (drops - reportedDrops) << " record(s) dropped, ring full\n";
+      reportedDrops = drops;
+    }
+    file.flush();
+    batch.clear();
+  }
+
+  void TraceLogger::writerLoop()
+  {
+    std::vector<Record> batch;
+    batch.reserve(kRingCapacity);
+    for (;;)
+    {
+      bool running;
+      {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait_for(lock, kFlushInterval, [&]
+                      { return !writerRunning; });
+        running = writerRunning;
+      }
+      drain(batch);
+      writeBatch(batch);
+      if (!running)
+        break;
+    }
+  }
+}
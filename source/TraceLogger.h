@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Newkon
+{
+  // Events recorded from timing-critical threads. Arguments are formatted by the writer thread.
+  enum class TraceEvent : uint16_t
+  {
+    kMidiSent,      // a0 = short message as scheduled, a1 = lateness in ns, a2 = bytes on the wire
+    kMidiDropped,   // a0 = events dropped since the last report, a1 = total dropped
+    kAudioUnderrun, // a0 = samples requested, a1 = samples available
+    kSendUnderrun,  // insert outputs: a0 = frames requested, a1 = frames queued
+    kSendOverrun,   // insert send ring full: a0 = frames offered, a1 = frames queued
+  };
+
+  // Asynchronous binary trace log for the MIDI scheduler and audio threads.
+  // Each producing thread owns a single-producer ring of fixed-size records; trace() copies one record
+  // into it without locking, allocating or touching the file. A background writer drains every ring
+  // in batches, formats the records as text ordered by time and flushes once per batch.
+  // The first start() allocates every ring; a thread's first trace() claims one with a single atomic
+  // increment (or adopts the drained ring of a thread that exited), so tracing never locks or allocates
+  // on the calling thread. When no ring is left, or a ring is full, the record is dropped and counted.
+  //
+  // Unlike Logger, tracing is available in release builds: it is off until start() gets a path.
+  class TraceLogger
+  {
+  public:
+    static TraceLogger &getInstance();
+
+    // HARDWARE_SYNTH_TRACE_PATH if set; otherwise a file in the temp directory for debug builds,
+    // and an empty path (tracing off) for release builds.
+    static std::string defaultPath();
+
+    // Reference counted: every plugin instance starts and stops the shared writer. The first start()
+    // decides the path. Returns false when the path is empty or cannot be opened.
+    bool start(const std::string &path);
+    void stop();
+
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // Name shown for records of the calling thread; claims its ring if needed. May be called before
+    // start(): the name is kept until the thread gets a ring.
+    void registerCurrentThread(const char *name);
+
+    void trace(TraceEvent event, int64_t a0 = 0, int64_t a1 = 0, int64_t a2 = 0);
+
+    // Records dropped because a thread's ring was full
+    uint64_t getDroppedCount() const;
+
+  private:
+    static constexpr uint32_t kRingCapacity = 4096; // records per thread, power of two
+    static constexpr uint32_t kMaxThreads = 32;
+    static constexpr std::chrono::milliseconds kFlushInterval{50};
+
+    struct Record
+    {
+      int64_t timeNs;
+      uint32_t thread;
+      TraceEvent event;
+      int64_t args[3];
+    };
+
+    struct ThreadRing
+    {
+      Record records[kRingCapacity];
+      alignas(64) std::atomic<uint32_t> writeCount{0};
+      alignas(64) std::atomic<uint32_t> readCount{0};
+      std::atomic<uint64_t> dropped{0};
+      std::atomic<bool> orphaned{false}; // owning thread exited; the next new thread may adopt it
+      uint32_t index = 0;
+      char name[16] = {};
+    };
+
+    friend struct TraceThreadHandle;
+
+    TraceLogger() = default;
+    ~TraceLogger();
+
+    TraceLogger(const TraceLogger &) = delete;
+    TraceLogger &operator=(const TraceLogger &) = delete;
+
+    ThreadRing *ringForCurrentThread();
+    ThreadRing *claimRing(ThreadRing *storage);
+    void writerLoop();
+    void drain(std::vector<Record> &batch);
+    void writeBatch(std::vector<Record> &batch);
+
+    std::atomic<bool> enabled{false};
+    std::chrono::steady_clock::time_point origin{};
+
+    // kMaxThreads rings, allocated by the first start() and kept until exit; nextRing counts claims
+    // and may run past kMaxThreads
+    std::unique_ptr<ThreadRing[]> ringStorage;
+    std::atomic<ThreadRing *> rings{nullptr};
+    std::atomic<uint32_t> nextRing{0};
+
+    // Writer state, guarded by lifecycleMutex
+    std::mutex lifecycleMutex;
+    int users = 0;
+    std::string outputPath;
+    std::ofstream file; // writer thread only while running
+    std::thread writer;
+    bool writerRunning = false;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    uint64_t reportedDrops = 0;
+  };
+}
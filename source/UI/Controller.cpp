@@ -29,6 +29,8 @@
 // UI colors
 #include "constants/colors.h"
 
+#include "LevelMeterView.h"
+
 #include <functional>
 
 using namespace Steinberg;
@@ -365,6 +367,12 @@ namespace Newkon
 					{
 						Logger::getInstance() << "Failed to start audio streaming" << std::endl;
 					}
+					else
+					{
+						// Device buffer size and rate are known now
+						processor2->updateLatencyCompensation(true);
+						showInputMeter();
+					}
 				}
 				else
 				{
@@ -618,5 +626,37 @@ namespace Newkon
 		container->setDirty(true);
 	}
 
+	//------------------------------------------------------------------------
+	void HardwareSynthController::showInputMeter()
+	{
+		if (!editor || !editor->getFrame() || editor->getFrame()->getNbViews() < 1)
+			return;
+		auto *container = dynamic_cast<VSTGUI::CViewContainer *>(editor->getFrame()->getView(0));
+		if (!container)
+			return;
+
+		// One meter per editor; it follows stream restarts and channel count changes by itself
+		for (uint32_t i = 0; i < container->getNbViews(); i++)
+		{
+			if (dynamic_cast<LevelMeterView *>(container->getView(i)))
+				return;
+		}
+
+		// Bottom-right corner, over the scroll views
+		VSTGUI::CRect containerSize = container->getViewSize();
+		const int meterWidth = 220;
+		const int meterHeight = 120;
+		VSTGUI::CRect meterRect(containerSize.getWidth() - 10 - meterWidth, containerSize.getHeight() - 10 - meterHeight,
+														containerSize.getWidth() - 10, containerSize.getHeight() - 10);
+
+		// Reads the processor's level snapshot only; the meter itself stays on the UI thread
+		auto *meter = new LevelMeterView(meterRect, [](InputLevelMeter::Snapshot &levels)
+																		 {
+																			 auto *processor = HardwareSynthProcessor::getCurrentInstance();
+																			 return processor && processor->getAsioInterface().getInputLevelMeter().snapshot(levels); });
+		container->addView(meter);
+		meter->invalid();
+	}
+
 	//------------------------------------------------------------------------
 } // namespace Newkon
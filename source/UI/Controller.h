@@ -85,6 +85,7 @@ namespace Newkon
 		void createAsioInterfaceButtons();
 		void showAsioInputs();
 		void createAsioInputButtons();
+		void showInputMeter();
 
 		//------------------------------------------------------------------------
 	private:
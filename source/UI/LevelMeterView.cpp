@@ -0,0 +1,166 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Newkon.
+//------------------------------------------------------------------------
+
+#include "LevelMeterView.h"
+
+#include "vstgui4/vstgui/lib/cdrawcontext.h"
+#include "vstgui4/vstgui/lib/ccolor.h"
+
+// UI colors
+#include "constants/colors.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Newkon
+{
+
+	namespace
+	{
+		constexpr double kFloorDb = -60.0;
+		constexpr int kBarGap = 2;
+	}
+
+	//------------------------------------------------------------------------
+	LevelMeterView::LevelMeterView(const VSTGUI::CRect &size, LevelSource source, uint32_t maxFramesPerSecond)
+			: CView(size), source(std::move(source)), frameIntervalMs(1000 / std::max<uint32_t>(maxFramesPerSecond, 1))
+	{
+	}
+
+	//------------------------------------------------------------------------
+	bool LevelMeterView::attached(VSTGUI::CView *parent)
+	{
+		if (!CView::attached(parent))
+			return false;
+		// Polls only while on screen
+		timer = VSTGUI::makeOwned<VSTGUI::CVSTGUITimer>([this](VSTGUI::CVSTGUITimer *)
+																										{ poll(); },
+																										frameIntervalMs);
+		return true;
+	}
+
+	//------------------------------------------------------------------------
+	bool LevelMeterView::removed(VSTGUI::CView *parent)
+	{
+		if (timer)
+		{
+			timer->stop();
+			timer = nullptr;
+		}
+		return CView::removed(parent);
+	}
+
+	//------------------------------------------------------------------------
+	int LevelMeterView::levelToPixels(float level) const
+	{
+		if (level <= 0.0f)
+			return 0;
+		const double db = 20.0 * std::log10(static_cast<double>(level));
+		const double fraction = std::min(std::max((db - kFloorDb) / -kFloorDb, 0.0), 1.0);
+		return static_cast<int>(std::lround(fraction * getViewSize().getWidth()));
+	}
+
+	//------------------------------------------------------------------------
+	VSTGUI::CRect LevelMeterView::barRect(int channel) const
+	{
+		const VSTGUI::CRect size = getViewSize();
+		const VSTGUI::CCoord pitch = (size.getHeight() + kBarGap) / std::max(channels, 1);
+		const VSTGUI::CCoord top = size.top + channel * pitch;
+		return VSTGUI::CRect(size.left, top, size.right, top + std::max<VSTGUI::CCoord>(pitch - kBarGap, 1));
+	}
+
+	//------------------------------------------------------------------------
+	void LevelMeterView::poll()
+	{
+		if (!source || !source(levels))
+			levels.channels = 0;
+
+		// A stream started, stopped or changed width: lay the bars out again
+		if (levels.channels != channels)
+		{
+			channels = levels.channels;
+			lastBlocks = levels.blocks;
+			for (int ch = 0; ch < InputLevelMeter::kMaxChannels; ch++)
+				bars[ch] = Bar();
+			invalid();
+		}
+		if (channels == 0 || levels.blocks == lastBlocks)
+			return; // nothing new since the last frame
+		lastBlocks = levels.blocks;
+
+		for (int ch = 0; ch < channels; ch++)
+		{
+			Bar bar;
+			bar.rms = levelToPixels(levels.rms[ch]);
+			bar.peak = levelToPixels(levels.peak[ch]);
+			bar.hold = levelToPixels(levels.peakHold[ch]);
+			bar.clipped = levels.peakHold[ch] >= 1.0f;
+			const Bar &old = bars[ch];
+			if (bar.rms == old.rms && bar.peak == old.peak && bar.hold == old.hold && bar.clipped == old.clipped)
+				continue;
+
+			// Only the spans between the old and new extents of what moved need repainting
+			int from = std::numeric_limits<int>::max(), to = 0;
+			const auto moved = [&](int before, int after, int lineWidth)
+			{
+				if (before == after)
+					return;
+				from = std::min(from, std::min(before, after) - lineWidth);
+				to = std::max(to, std::max(before, after));
+			};
+			moved(old.rms, bar.rms, 0);
+			moved(old.peak, bar.peak, 0);
+			moved(old.hold, bar.hold, 2);
+			if (bar.clipped != old.clipped)
+			{
+				from = 0;
+				to = static_cast<int>(getViewSize().getWidth());
+			}
+			from = std::max(from, 0);
+			bars[ch] = bar;
+			const VSTGUI::CRect rect = barRect(ch);
+			invalidRect(VSTGUI::CRect(rect.left + from, rect.top, std::min(rect.left + to + 1, rect.right), rect.bottom));
+		}
+	}
+
+	//------------------------------------------------------------------------
+	void LevelMeterView::draw(VSTGUI::CDrawContext *context)
+	{
+		const VSTGUI::CColor track = UIColors::toVstGuiCColor(UIColors::gray);
+		const VSTGUI::CColor rmsColor = UIColors::toVstGuiCColor(UIColors::knobColors[3]);
+		const VSTGUI::CColor peakColor = UIColors::toVstGuiCColor(UIColors::knobColors[2]);
+		const VSTGUI::CColor clipColor = UIColors::toVstGuiCColor(UIColors::knobColors[0]);
+
+		context->setDrawMode(VSTGUI::kAliasing);
+		context->setFillColor(UIColors::toVstGuiCColor(UIColors::background));
+		context->drawRect(getViewSize(), VSTGUI::kDrawFilled);
+		for (int ch = 0; ch < channels; ch++)
+		{
+			const VSTGUI::CRect rect = barRect(ch);
+			const Bar &bar = bars[ch];
+
+			context->setFillColor(bar.clipped ? clipColor : track);
+			context->drawRect(rect, VSTGUI::kDrawFilled);
+			if (bar.peak > bar.rms)
+			{
+				context->setFillColor(peakColor);
+				context->drawRect(VSTGUI::CRect(rect.left + bar.rms, rect.top, rect.left + bar.peak, rect.bottom), VSTGUI::kDrawFilled);
+			}
+			if (bar.rms > 0)
+			{
+				context->setFillColor(rmsColor);
+				context->drawRect(VSTGUI::CRect(rect.left, rect.top, rect.left + bar.rms, rect.bottom), VSTGUI::kDrawFilled);
+			}
+			if (bar.hold > 0)
+			{
+				context->setFillColor(bar.clipped ? VSTGUI::CColor(255, 255, 255) : clipColor);
+				context->drawRect(VSTGUI::CRect(rect.left + bar.hold - 2, rect.top, rect.left + bar.hold, rect.bottom), VSTGUI::kDrawFilled);
+			}
+		}
+		setDirty(false);
+	}
+
+	//------------------------------------------------------------------------
+} // namespace Newkon
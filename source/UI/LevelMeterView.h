@@ -0,0 +1,58 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Newkon.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include "vstgui4/vstgui/lib/cview.h"
+#include "vstgui4/vstgui/lib/cvstguitimer.h"
+#include "vstgui4/vstgui/lib/crect.h"
+
+#include <functional>
+
+#include "../Processor/Asio/InputLevelMeter.h"
+
+namespace Newkon
+{
+
+	//------------------------------------------------------------------------
+	//  LevelMeterView: one horizontal bar per captured channel (RMS, peak and a falling peak hold,
+	//  -60 to 0 dBFS). Polls a level snapshot from a UI timer, at most `maxFramesPerSecond` times a
+	//  second, and invalidates only the part of each bar that moved; the audio thread never sees it.
+	//------------------------------------------------------------------------
+	class LevelMeterView : public VSTGUI::CView
+	{
+	public:
+		using LevelSource = std::function<bool(InputLevelMeter::Snapshot &)>;
+
+		LevelMeterView(const VSTGUI::CRect &size, LevelSource source, uint32_t maxFramesPerSecond = 30);
+
+		void draw(VSTGUI::CDrawContext *context) override;
+		bool attached(VSTGUI::CView *parent) override;
+		bool removed(VSTGUI::CView *parent) override;
+
+	private:
+		// Drawn extents of a bar, in pixels from its left edge
+		struct Bar
+		{
+			int rms = 0;
+			int peak = 0;
+			int hold = 0;
+			bool clipped = false;
+		};
+
+		void poll();
+		VSTGUI::CRect barRect(int channel) const;
+		int levelToPixels(float level) const;
+
+		LevelSource source;
+		uint32_t frameIntervalMs;
+		VSTGUI::SharedPointer<VSTGUI::CVSTGUITimer> timer;
+		InputLevelMeter::Snapshot levels;
+		uint64_t lastBlocks = 0;
+		int channels = 0;
+		Bar bars[InputLevelMeter::kMaxChannels];
+	};
+
+	//------------------------------------------------------------------------
+} // namespace Newkon